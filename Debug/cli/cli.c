@@ -81,8 +81,27 @@ CLIDict_Def( basicCLIDict, "General Commands" ) = {
 	{ 0, 0, 0 } // Null entry for dictionary end
 };
 
+// Line Buffer
+Instance char    CLILineBuffer[CLILineBufferMaxSize+1]; // +1 for an additional NULL
+Instance uint8_t CLILineBufferCurrent;
+
+// Main command dictionary
+Instance CLIDictItem *CLIDict     [CLIMaxDictionaries];
+Instance char*        CLIDictNames[CLIMaxDictionaries];
+Instance uint8_t      CLIDictionariesUsed;
+
+// History
+Instance char CLIHistoryBuffer[CLIMaxHistorySize][CLILineBufferMaxSize];
+Instance uint8_t CLIHistoryHead;
+Instance uint8_t CLIHistoryTail;
+Instance int8_t CLIHistoryCurrent;
+
+// Debug
+Instance uint8_t CLILEDState;
+Instance uint8_t CLIHexDebugMode;
+
 #if defined(_host_)
-int CLI_exit = 0; // When 1, cli signals library to exit (Host-side KLL only)
+Instance int CLI_exit = 0; // When 1, cli signals library to exit (Host-side KLL only)
 #endif
 
 
@@ -84,23 +84,23 @@ typedef struct CLIDictItem {
 
 // ----- Variables -----
 
-char    CLILineBuffer[CLILineBufferMaxSize+1]; // +1 for an additional NULL
-uint8_t CLILineBufferCurrent;
+extern Instance char    CLILineBuffer[CLILineBufferMaxSize+1]; // +1 for an additional NULL
+extern Instance uint8_t CLILineBufferCurrent;
 
 // Main command dictionary
-CLIDictItem *CLIDict     [CLIMaxDictionaries];
-char*        CLIDictNames[CLIMaxDictionaries];
-uint8_t      CLIDictionariesUsed;
+extern Instance CLIDictItem *CLIDict     [CLIMaxDictionaries];
+extern Instance char*        CLIDictNames[CLIMaxDictionaries];
+extern Instance uint8_t      CLIDictionariesUsed;
 
 // History
-char CLIHistoryBuffer[CLIMaxHistorySize][CLILineBufferMaxSize];
-uint8_t CLIHistoryHead;
-uint8_t CLIHistoryTail;
-int8_t CLIHistoryCurrent;
+extern Instance char CLIHistoryBuffer[CLIMaxHistorySize][CLILineBufferMaxSize];
+extern Instance uint8_t CLIHistoryHead;
+extern Instance uint8_t CLIHistoryTail;
+extern Instance int8_t CLIHistoryCurrent;
 
 // Debug
-uint8_t CLILEDState;
-uint8_t CLIHexDebugMode;
+extern Instance uint8_t CLILEDState;
+extern Instance uint8_t CLIHexDebugMode;
 
 
 
@@ -34,8 +34,8 @@
 
 // ----- Variables -----
 
-static LatencyMeasurement latency_measurements[LatencyMeasurementCount_define];
-static uint8_t latency_resources;
+static Instance LatencyMeasurement latency_measurements[LatencyMeasurementCount_define];
+static Instance uint8_t latency_resources;
 
 
 
@@ -85,6 +85,17 @@ uint8_t Latency_add_resource( const char* name, LatencyOption option )
 	return index;
 }
 
+// Reset measurements, keeps the resource name and option
+// resource: index of resource
+void Latency_reset( uint8_t resource )
+{
+	latency_measurements[resource].min_latency = 0xFFFFFFFF;
+	latency_measurements[resource].max_latency = 0;
+	latency_measurements[resource].average_latency = 0;
+	latency_measurements[resource].last_latency = 0;
+	latency_measurements[resource].count = 0;
+}
+
 // Query latency
 // type:     type of query
 // resource: index of resource
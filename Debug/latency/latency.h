@@ -74,6 +74,7 @@ const char* Latency_query_name( uint8_t resource );
 
 uint8_t Latency_add_resource( const char* name, LatencyOption option );
 uint8_t Latency_resources();
+void Latency_reset( uint8_t resource );
 
 uint32_t  Latency_query( LatencyQuery type, uint8_t resource );
 
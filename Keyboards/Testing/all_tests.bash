@@ -28,6 +28,10 @@ source "../common.bash"
 
 # Run builds
 cmd ./macrotest.bash
+cmd ./matrixtest.bash
+cmd ./matrixtest_edge.bash
+cmd ./matrixtest_ghost.bash
+cmd ./matrixtest_vertical.bash
 cmd ./mk20test.bash
 cmd ./mk22test.bash
 cmd ./mk64test.bash
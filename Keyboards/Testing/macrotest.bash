@@ -83,6 +83,17 @@ cd "${BuildPath}"
 
 #cmd python3 Tests/test.py # XXX (HaaTa) Disabling for now, need to implement general-case macro testing
 cmd python3 Tests/animation.py
+cmd python3 Tests/layer_resolve.py
+cmd python3 Tests/tap_hold.py
+cmd python3 Tests/chord.py
+cmd python3 Tests/report_diff.py
+cmd python3 Tests/report_queue.py
+cmd python3 Tests/report_ring.py
+cmd python3 Tests/inject_events.py
+cmd python3 Tests/clock.py
+cmd python3 Tests/timer_wheel.py
+cmd python3 Tests/long_trigger.py
+cmd python3 Tests/result_ops.py
 
 # Tally results
 result
@@ -57,6 +57,15 @@ else ()
 	set_target_properties ( ${TARGET} PROPERTIES
 		LINK_FLAGS ${LINKER_FLAGS}
 	)
+
+	# Per instance state is released when its thread ends (e.g. Pixel_releaseBuffers)
+	find_package ( Threads REQUIRED )
+	target_link_libraries ( ${TARGET} ${CMAKE_THREAD_LIBS_INIT} )
+
+	# Native Benchmark, see Lib/host_bench.c
+	# Each benchmark instance runs on its own thread
+	add_executable ( ${TARGET}_bench Lib/host_bench.c generatedKeymap.h )
+	target_link_libraries ( ${TARGET}_bench ${TARGET} ${CMAKE_THREAD_LIBS_INIT} )
 endif ()
 
 #| llvm-clang does not have an objcopy equivalent
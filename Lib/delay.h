@@ -35,6 +35,9 @@
 
 #include <stdint.h>
 
+// Local Includes
+#include "mcu_compat.h"
+
 
 
 // ----- Macros -----
@@ -48,7 +51,7 @@
 // ----- Functions -----
 
 // the systick interrupt is supposed to increment this at 1 kHz rate
-extern volatile uint32_t systick_millis_count;
+extern Instance volatile uint32_t systick_millis_count;
 
 static inline uint32_t millis(void) __attribute__((always_inline, unused));
 static inline uint32_t millis(void)
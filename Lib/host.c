@@ -24,6 +24,7 @@
 
 // Compiler Includes
 #include <stddef.h>
+#include <time.h>
 
 // Debug Includes
 #include <print.h>
@@ -31,12 +32,142 @@
 // Local Includes
 #include "delay.h"
 #include "host.h"
+#include "kinetis.h"
 
 
 
 // ----- Variables -----
 
-// ----- Function Declarations -----
+// Current time, read by Time_now()
+Instance volatile uint32_t systick_millis_count;
+Instance volatile uint32_t ns_since_systick_count; // Ticks, free running ns counter (see Host_ticksPer_ms)
+
+// Clock source
+Instance HostClock Host_clock = HostClock_Manual;
+
+// Time added after each Host_process with HostClock_Virtual
+Instance uint32_t Host_clockStep_ns;
+
+// Virtual clock (ns)
+static Instance uint64_t Host_clockVirtual_ns;
+
+// CLOCK_MONOTONIC when HostClock_Monotonic was selected (ns)
+static Instance uint64_t Host_clockStart_ns;
+
+// GPIO and PORT registers
+Instance HostGPIO Host_gpio[ HostGPIO_Ports ];
+Instance uint32_t Host_port[ HostGPIO_Ports ][ HostPORT_Registers ];
+
+// Input model of the GPIO ports
+Instance uint32_t (*Host_gpioModel)( uint8_t port );
+
+// Module setup failed during Host_init
+Instance uint8_t Host_initFailed;
+
+
 
 // ----- Functions -----
 
+static uint64_t Host_clockMonotonic()
+{
+	struct timespec now;
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// Select the clock source
+// step_ns is only used by HostClock_Virtual
+void Host_clockSelect( HostClock clock, uint32_t step_ns )
+{
+	// Continue from the current time
+	if ( Host_clock == HostClock_Monotonic )
+	{
+		Host_clockVirtual_ns = Host_clockMonotonic() - Host_clockStart_ns;
+	}
+	Host_clockStart_ns = Host_clockMonotonic() - Host_clockVirtual_ns;
+
+	Host_clock = clock;
+	Host_clockStep_ns = step_ns;
+
+	// Update systick and ticks, unless HostClock_Monotonic
+	Host_clockAdvance( 0 );
+}
+
+// Current time (ns)
+uint64_t Host_clockNow_ns()
+{
+	if ( Host_clock == HostClock_Monotonic )
+	{
+		return Host_clockMonotonic() - Host_clockStart_ns;
+	}
+
+	return Host_clockVirtual_ns;
+}
+
+// Set the current time, ignored with HostClock_Monotonic
+// ns - Since the start of the ms
+void Host_clockSet( uint32_t ms, uint32_t ns )
+{
+	if ( Host_clock == HostClock_Monotonic )
+		return;
+
+	Host_clockVirtual_ns = (uint64_t)ms * Host_ticksPer_ms + ns;
+	Host_clockAdvance( 0 );
+}
+
+// Advance the current time, ignored with HostClock_Monotonic
+void Host_clockAdvance( uint64_t ns )
+{
+	if ( Host_clock == HostClock_Monotonic )
+		return;
+
+	Host_clockVirtual_ns += ns;
+	systick_millis_count = Host_clockVirtual_ns / Host_ticksPer_ms;
+	ns_since_systick_count = Host_clockVirtual_ns;
+}
+
+// Read CLOCK_MONOTONIC, only used with HostClock_Monotonic
+void Host_clockUpdate()
+{
+	uint64_t now = Host_clockNow_ns();
+	systick_millis_count = now / Host_ticksPer_ms;
+	ns_since_systick_count = now;
+}
+
+
+// Input of a port with nothing connected
+// Outputs read back, inputs read the pull resistor (low if there is none)
+uint32_t Host_gpioIdle( uint8_t port )
+{
+	HostGPIO *gpio = &Host_gpio[ port ];
+	uint32_t input = gpio->PDOR & gpio->PDDR;
+
+	for ( uint8_t pin = 0; pin < 32; pin++ )
+	{
+		uint32_t pcr = Host_port[ port ][ pin ];
+		if ( !( gpio->PDDR & ( (uint32_t)1 << pin ) ) && ( pcr & PORT_PCR_PE ) && ( pcr & PORT_PCR_PS ) )
+		{
+			input |= (uint32_t)1 << pin;
+		}
+	}
+
+	return input;
+}
+
+// Read the input register of a port
+// Writes to the set, clear and toggle registers of every port are applied first
+uint32_t Host_gpioInput( uint8_t port )
+{
+	for ( uint8_t item = 0; item < HostGPIO_Ports; item++ )
+	{
+		HostGPIO *gpio = &Host_gpio[ item ];
+		gpio->PDOR = ( ( gpio->PDOR | gpio->PSOR ) & ~gpio->PCOR ) ^ gpio->PTOR;
+		gpio->PSOR = 0;
+		gpio->PCOR = 0;
+		gpio->PTOR = 0;
+	}
+
+	Host_gpio[ port ].PDIR = Host_gpioModel ? Host_gpioModel( port ) : Host_gpioIdle( port );
+	return Host_gpio[ port ].PDIR;
+}
+
@@ -27,6 +27,15 @@
 #define NULL ((void *)0)
 #endif
 
+// GPIO ports A...E, as on Freescale MK20s
+#define HostGPIO_Ports 5
+
+// 0x1000 between PORT pin registers
+#define HostPORT_Registers ( 0x1000 / sizeof(uint32_t) )
+
+// Host ticks are ns, free running like the ARM cycle counter
+#define Host_ticksPer_ms 1000000
+
 
 
 // ----- Includes -----
@@ -34,12 +43,67 @@
 // System Includes
 #include <stdint.h>
 
+// Local Includes
+#include "mcu_compat.h"
+
+
+
+// ----- Enumerations -----
+
+// Host clock source, see Host_set_clock in main.c
+typedef enum HostClock {
+	HostClock_Manual    = 0, // Only changed by Host_set_systick or Host_advance_time
+	HostClock_Virtual   = 1, // Advanced by a fixed step after each Host_process
+	HostClock_Monotonic = 2, // CLOCK_MONOTONIC, since the clock was selected
+} HostClock;
+
+
+
+// ----- Structs -----
+
+// Kinetis GPIO register layout, so register arithmetic also works on the host
+// GPIOA_* and PORTA_PCR0 in kinetis.h refer to Host_gpio and Host_port on the host
+// Inputs (PDIR) are only updated by Host_gpioInput
+typedef struct HostGPIO {
+	uint32_t PDOR; // Port Data Output Register
+	uint32_t PSOR; // Port Set Output Register
+	uint32_t PCOR; // Port Clear Output Register
+	uint32_t PTOR; // Port Toggle Output Register
+	uint32_t PDIR; // Port Data Input Register
+	uint32_t PDDR; // Port Data Direction Register
+	uint32_t reserved[10]; // 0x40 between GPIO Port registers
+} HostGPIO;
+
 
 
 // ----- Variables -----
 
-// ----- Function Declarations -----
+extern Instance volatile uint32_t systick_millis_count;
+extern Instance volatile uint32_t ns_since_systick_count;
+
+extern Instance HostClock Host_clock;
+extern Instance uint32_t  Host_clockStep_ns;
+
+extern Instance HostGPIO Host_gpio[ HostGPIO_Ports ];
+extern Instance uint32_t Host_port[ HostGPIO_Ports ][ HostPORT_Registers ];
+
+// Computes the input register of a port, Host_gpioIdle if not set
+extern Instance uint32_t (*Host_gpioModel)( uint8_t port );
+
+// Set by a module that could not be set up (e.g. out of memory), Host_init then fails
+extern Instance uint8_t Host_initFailed;
+
+
 
 // ----- Functions -----
 
+void Host_clockSelect( HostClock clock, uint32_t step_ns );
+void Host_clockSet( uint32_t ms, uint32_t ns );
+void Host_clockAdvance( uint64_t ns );
+void Host_clockUpdate();
+uint64_t Host_clockNow_ns();
+
+uint32_t Host_gpioIdle( uint8_t port );
+uint32_t Host_gpioInput( uint8_t port );
+
 
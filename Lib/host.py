@@ -29,7 +29,7 @@ import pty
 import sys
 import termios
 
-from ctypes import CFUNCTYPE, POINTER, cast, c_int, c_char_p, c_uint8, c_uint16, c_uint32, Structure
+from ctypes import CFUNCTYPE, POINTER, cast, c_int, c_char_p, c_uint8, c_uint16, c_uint32, c_uint64, Structure
 
 
 
@@ -73,17 +73,58 @@ class TriggerGuide( Structure ):
 		( 'scanCode', c_uint8 ),
 	]
 
+class TriggerEvent( Structure ):
+	'''
+	TriggerEvent struct
+	See Macro/PartialMap/kll.h
+	'''
+	_fields_ = [
+		( 'type',  c_uint8 ),
+		( 'state', c_uint8 ),
+		( 'index', c_uint8 ),
+		( 'time',  c_uint16 ),
+	]
+
 class TriggerMacro( Structure ):
 	'''
 	TriggerMacro struct
 	See Macro/PartialMap/kll.h
 	'''
-	# TODO result is a var_uint_t, needs to be dynamic
+	# Fields are set once libkiibohd is loaded, result is an index_uint_t (see Control.index_uint)
+
+
+class HostReport( Structure ):
+	'''
+	HostReport struct
+	See Output/TestOut/output_com.h
+	'''
 	_fields_ = [
-		( 'guide',  POINTER( c_uint8 ) ),
-		( 'result', c_uint8 ),
+		( 'ms',        c_uint32 ),
+		( 'ticks',     c_uint32 ),
+		( 'protocol',  c_uint8 ),
+		( 'modifiers', c_uint8 ),
+		( 'sys_ctrl',  c_uint8 ),
+		( 'keys',      c_uint8 * 27 ), # USB_NKRO_BITFIELD_SIZE_KEYS
+		( 'cons_ctrl', c_uint16 ),
 	]
 
+def host_report_ring( size ):
+	'''
+	HostReportRing struct, with room for size reports
+	See Output/TestOut/output_com.h
+	'''
+	class HostReportRing( Structure ):
+		_fields_ = [
+			( 'head',    c_uint32 ),
+			( 'tail',    c_uint32 ),
+			( 'size',    c_uint32 ),
+			( 'dropped', c_uint32 ),
+			( 'reports', HostReport * size ),
+		]
+	ring = HostReportRing()
+	ring.size = size
+	return ring
+
 
 class ResultsPendingElem( Structure ):
 	'''
@@ -118,6 +159,13 @@ class Data:
 	def __init__( self ):
 		self.usb_keyboard_data = None
 
+		# Every keyboard report sent, oldest first (cleared by the test case)
+		self.usb_keyboard_reports = []
+
+		# Keyboard report ring records drained, oldest first (cleared by the test case)
+		# See Control.report_ring_setup()
+		self.usb_keyboard_records = []
+
 	def usb_keyboard( self ):
 		'''
 		Returns a tuple of USB Keyboard output
@@ -126,6 +174,20 @@ class Data:
 			return self.usb_keyboard_data.protocol, self.usb_keyboard_data.codes(), self.usb_keyboard_data.consumer_ctrl, self.usb_keyboard_data.system_ctrl
 		return None
 
+	def usb_keyboard_record( self, record ):
+		'''
+		Returns the USB Keyboard packet of a keyboard report ring record
+		'''
+		bitfield_size = cast( control.kiibohd.USBKeys_BitfieldSize, POINTER( c_uint8 ) )[0]
+		return output.USBKeyboard(
+			bitfield_size,
+			record.protocol,
+			record.modifiers,
+			list( record.keys ),
+			record.cons_ctrl,
+			record.sys_ctrl,
+		)
+
 	def trigger_list_buffer( self ):
 		'''
 		Returns trigger list buffer
@@ -142,8 +204,7 @@ class Data:
 		'''
 		Returns list of pending triggers
 		'''
-		# TODO Dynamically select index_uint_t size
-		size_width = c_uint16
+		size_width = control.index_uint
 		triggers_len = cast( control.kiibohd.macroTriggerMacroPendingListSize, POINTER( size_width ) )[0]
 		triggers = cast( control.kiibohd.macroTriggerMacroPendingList, POINTER( size_width * triggers_len ) )[0]
 		output = []
@@ -189,6 +250,7 @@ class Control:
 		self.CTYPE_callback_ref = None
 		self.serial = None
 		self.serial_buf = ""
+		self.report_ring = None
 
 		# Provide reference to this class when running callback
 		# Due to memory schemes, we have to use a standard Python function and not a method
@@ -226,6 +288,17 @@ class Control:
 			sys.exit( 1 )
 		self.kiibohd = kiibohd
 
+		# Structures sized by the libkiibohd build
+		# index_uint_t width, see IndexWordSize in Macro/PartialMap/kll.h
+		index_word_size = cast( kiibohd.Macro_IndexWordSize_Host, POINTER( c_uint8 ) )[0]
+		self.index_uint = { 8 : c_uint8, 16 : c_uint16, 32 : c_uint32 }[ index_word_size ]
+		TriggerMacro._fields_ = [
+			( 'guide',  POINTER( c_uint8 ) ),
+			( 'result', self.index_uint ),
+		]
+		if hasattr( scan, 'library_setup' ):
+			scan.library_setup()
+
 		# Register Callback
 		self.callback_setup()
 
@@ -316,7 +389,9 @@ class Control:
 		'''
 		# Initialize kiibohd
 		print(">Host_init")
-		self.kiibohd.Host_init()
+		if not self.kiibohd.Host_init():
+			print( "{0} Could not set up libkiibohd".format( ERROR ) )
+			sys.exit( 1 )
 		print("")
 
 		# Run cli if enabled
@@ -337,6 +412,57 @@ class Control:
 			self.kiibohd.Host_process()
 			loop += 1
 
+	def set_clock( self, clock, step_ns=0 ):
+		'''
+		Selects the libkiibohd clock source
+		See Lib/host.h HostClock
+
+		@param clock:   0 - Manual (Host_set_systick), 1 - Virtual, 2 - Monotonic (CLOCK_MONOTONIC)
+		@param step_ns: Virtual clock, time added after each Host_process
+		'''
+		self.kiibohd.Host_set_clock( clock, step_ns )
+
+	def advance_time( self, ns ):
+		'''
+		Advances the clock by ns
+		With the Virtual clock, Host_process is run each step until ns has elapsed
+
+		@param ns: Nanoseconds to advance
+		@return: 0 if the clock cannot be advanced (Monotonic)
+		'''
+		refresh_callback()
+		return self.kiibohd.Host_advance_time( c_uint64( ns ) )
+
+	def step( self, number_of_loops=1 ):
+		'''
+		Run N full processing loops (Scan, Macro and Output periodic stages)
+		Unlike loop(), Host_step is called once, without any debug output
+
+		@param number_of_loops: Number of processing loops to run
+		'''
+		refresh_callback()
+		self.kiibohd.Host_step( number_of_loops )
+
+	def inject_events( self, events, time ):
+		'''
+		Adds TriggerEvents directly to the macro module, bypassing the scan module and cli
+		Processing loops are run as needed when there is no room left for more events
+
+		@param events: List of (type, state, index, time) tuples, time is the lower 16 bits of ms
+		@param time:   Systick (ms) to set when injecting
+		'''
+		buf = ( TriggerEvent * len( events ) )( *events )
+		added = 0
+		while True:
+			added += self.kiibohd.Host_inject_events(
+				ctypes.byref( buf, added * ctypes.sizeof( TriggerEvent ) ),
+				len( events ) - added,
+				time
+			)
+			if added >= len( events ):
+				break
+			self.step()
+
 	def refresh_callback( self ):
 		'''
 		Convenience function for refreshing callback
@@ -344,6 +470,49 @@ class Control:
 		'''
 		return refresh_callback()
 
+	def report_ring_setup( self, size ):
+		'''
+		Sends keyboard reports to a ring buffer instead of the keyboard_send callback
+		Reports are drained in bulk to data.usb_keyboard_records, see report_ring_drain()
+		The keyboard_drain callback is used when the ring is full
+
+		@param size: Number of reports the ring holds, 0 to use the keyboard_send callback again
+		'''
+		if size == 0:
+			self.kiibohd.Host_register_report_ring( None )
+			self.report_ring = None
+			return
+
+		self.report_ring = host_report_ring( size )
+		self.kiibohd.Host_register_report_ring( ctypes.byref( self.report_ring ) )
+
+	def report_ring_drain( self ):
+		'''
+		Moves all the reports in the ring to data.usb_keyboard_records
+
+		@return: Number of reports drained
+		'''
+		ring = self.report_ring
+		if ring is None:
+			return 0
+
+		# Copy out at most two contiguous segments (before and after wrapping)
+		tail = ring.tail
+		count = ( ring.head - tail ) & 0xFFFFFFFF
+		remaining = count
+		while remaining > 0:
+			start = tail % ring.size
+			length = min( remaining, ring.size - start )
+			self.data.usb_keyboard_records.extend(
+				( HostReport * length ).from_buffer_copy( ring.reports, start * ctypes.sizeof( HostReport ) )
+			)
+			tail = ( tail + length ) & 0xFFFFFFFF
+			remaining -= length
+
+		# Release the drained reports back to the firmware
+		ring.tail = tail
+		return count
+
 	def cmd( self, command_name ):
 		'''
 		Run given command from Host-side KLL
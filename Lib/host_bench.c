@@ -0,0 +1,431 @@
+/* Copyright (C) 2017 by Jacob Alexander
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Native host benchmark
+// Drives libkiibohd through the Host_* API (see main.c), without Python
+//
+// Usage: kiibohd_bench [loops] [instances]
+//
+// Each instance is an independent keyboard, stepped on its own thread
+//
+// Output is CSV, lines starting with # are comments
+//   bench,<workload>,<loops>,<events>,<reports>,<ns>,<events_per_s>,<ns_per_loop>,<instance>
+//   latency,<workload>,<resource>,<min>,<max>,<average>,<count>,<instance>
+//   pending,<held>,<pending>,<calls>,<min_cycles>,<average_cycles>,<instance>
+//
+// pending lines are the cycles per Macro_process call, against the number of held keys (and pending TriggerMacros)
+// Cycles are counted with the CPU timestamp counter, ns where there is none (see bench_cycles)
+
+
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Project Includes
+#include <kll.h>
+#include <latency.h>
+
+
+
+// ----- Defines -----
+
+// Default number of processing loops per workload
+#define BENCH_LOOPS 100000
+
+// Keyboard report ring size
+#define BENCH_RING 1024
+
+// Number of keys held down during the layer thrash workload
+#define BENCH_HELD_KEYS 16
+
+// Maximum number of instances
+#define BENCH_INSTANCES 64
+
+// Most held keys measured by the pending workload
+#define BENCH_PENDING_KEYS 128
+
+
+
+// ----- Host API -----
+
+// See main.c
+int Host_init();
+int Host_step( uint32_t loops );
+int Host_inject_events( const TriggerEvent* events, uint16_t count, uint32_t time );
+int Host_register_callback( void* func );
+int Host_register_report_ring( void* ring );
+int Host_set_clock( uint8_t clock, uint32_t step_ns );
+
+// See Macro/PartialMap/macro.c
+extern uint16_t Macro_MaxScanCode_Host;
+extern uint16_t Macro_LayerNum_Host;
+void Macro_layerState( TriggerMacro *trigger, uint8_t state, uint8_t stateType, uint16_t layer, uint8_t layerState );
+void Macro_process();
+extern Instance index_uint_t macroTriggerMacroPendingListSize;
+
+// See Macro/PixelMap/pixel.c, only available with PixelMap
+uint8_t Pixel_addDefaultAnimation( uint32_t index ) __attribute__((weak));
+
+
+
+// ----- Variables -----
+
+// Loops per workload
+static uint32_t bench_loops;
+
+// Keyboard report ring, drained by the benchmark (report contents are not checked)
+static Instance struct {
+	HostReportRing ring;
+	HostReport     reports[ BENCH_RING ];
+} bench_ring;
+
+// Reports drained from the ring
+static Instance uint64_t bench_reports;
+
+// Events injected during the current workload
+static Instance uint64_t bench_events;
+
+// Instance number of the current thread
+static Instance uintptr_t bench_instance;
+
+
+
+// ----- Functions -----
+
+// Host callback, all output is dropped
+int bench_callback( char* command, char* args )
+{
+	if ( strcmp( command, "keyboard_drain" ) == 0 )
+	{
+		bench_reports += bench_ring.ring.head - bench_ring.ring.tail;
+		bench_ring.ring.tail = bench_ring.ring.head;
+	}
+
+	return 1;
+}
+
+uint64_t bench_now()
+{
+	struct timespec now;
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// CPU cycles (timestamp counter), ns if not available
+uint64_t bench_cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	return bench_now();
+#endif
+}
+
+// Run a processing loop, injecting the given events first
+void bench_loop( TriggerEvent *events, uint16_t count )
+{
+	uint32_t now = Time_now().ms;
+
+	for ( uint16_t event = 0; event < count; event++ )
+	{
+		events[ event ].time = now;
+	}
+
+	// Events that do not fit are injected after each processing loop
+	uint16_t added = 0;
+	do {
+		added += Host_inject_events( events + added, count - added, now );
+		Host_step( 1 );
+	} while ( added < count );
+
+	bench_events += count;
+}
+
+TriggerEvent bench_event( uint8_t index, uint8_t state )
+{
+	TriggerEvent event = {
+		.type  = TriggerType_Switch1,
+		.state = state,
+		.index = index,
+	};
+	return event;
+}
+
+// Number of switch scan codes to use
+uint8_t bench_keys()
+{
+	return Macro_MaxScanCode_Host < 0xFF ? Macro_MaxScanCode_Host : 0xFF;
+}
+
+
+// -- Workloads --
+
+// One key at a time
+void bench_typing( uint32_t loops )
+{
+	uint8_t keys = bench_keys();
+	for ( uint32_t loop = 0; loop < loops; loop += 2 )
+	{
+		uint8_t key = 1 + ( loop / 2 ) % keys;
+
+		TriggerEvent press = bench_event( key, ScheduleType_P );
+		bench_loop( &press, 1 );
+
+		TriggerEvent release = bench_event( key, ScheduleType_R );
+		bench_loop( &release, 1 );
+	}
+}
+
+// Next key pressed before the previous one is released
+void bench_rollover( uint32_t loops )
+{
+	uint8_t keys = bench_keys();
+	uint8_t previous = 0;
+	for ( uint32_t loop = 0; loop < loops; loop++ )
+	{
+		uint8_t key = 1 + loop % keys;
+
+		TriggerEvent events[2] = {
+			bench_event( key, ScheduleType_P ),
+			bench_event( previous, ScheduleType_R ),
+		};
+		bench_loop( events, previous ? 2 : 1 );
+		previous = key;
+	}
+
+	TriggerEvent release = bench_event( previous, ScheduleType_R );
+	bench_loop( &release, 1 );
+}
+
+// Layer lock toggled while keys are held, then all keys released
+void bench_layer_thrash( uint32_t loops )
+{
+	uint8_t keys = bench_keys() < BENCH_HELD_KEYS ? bench_keys() : BENCH_HELD_KEYS;
+	TriggerEvent events[ BENCH_HELD_KEYS ];
+
+	for ( uint32_t loop = 0; loop < loops; loop += 2 )
+	{
+		for ( uint8_t key = 0; key < keys; key++ )
+		{
+			events[ key ] = bench_event( key + 1, ScheduleType_P );
+		}
+		Macro_layerState( 0, 0, 0, 1, 0x04 ); // Toggle layer 1 lock
+		bench_loop( events, keys );
+
+		for ( uint8_t key = 0; key < keys; key++ )
+		{
+			events[ key ] = bench_event( key + 1, ScheduleType_R );
+		}
+		Macro_layerState( 0, 0, 0, 1, 0x04 ); // Toggle layer 1 lock
+		bench_loop( events, keys );
+	}
+}
+
+// Default animations running, no keys
+void bench_animation( uint32_t loops )
+{
+	for ( uint32_t index = 0; Pixel_addDefaultAnimation( index ); index++ );
+
+	for ( uint32_t loop = 0; loop < loops; loop++ )
+	{
+		bench_loop( 0, 0 );
+	}
+}
+
+
+// Held keys against Macro_process cycles
+// Each Macro_process call is timed on its own, the Scan and Output stages are not counted
+void bench_pending( uint32_t loops )
+{
+	uint8_t keys = bench_keys() < BENCH_PENDING_KEYS ? bench_keys() : BENCH_PENDING_KEYS;
+	TriggerEvent events[ BENCH_PENDING_KEYS ];
+
+	for ( uint16_t held = 0; held <= keys; held = held ? held * 2 : 1 )
+	{
+		// Press, then process until the keys are in the hold state
+		for ( uint8_t key = 0; key < held; key++ )
+		{
+			events[ key ] = bench_event( key + 1, ScheduleType_P );
+		}
+		bench_loop( events, held );
+		Host_step( 1 );
+		uint16_t pending = macroTriggerMacroPendingListSize;
+
+		uint64_t min = ~0ULL;
+		uint64_t total = 0;
+		for ( uint32_t loop = 0; loop < loops; loop++ )
+		{
+			Scan_periodic();
+
+			uint64_t start = bench_cycles();
+			Macro_process();
+			uint64_t cycles = bench_cycles() - start;
+
+			Output_periodic();
+
+			total += cycles;
+			min = cycles < min ? cycles : min;
+		}
+
+		printf( "pending,%u,%u,%u,%llu,%llu,%u\n",
+			held,
+			pending,
+			loops,
+			(unsigned long long)( loops ? min : 0 ),
+			(unsigned long long)( loops ? total / loops : 0 ),
+			(unsigned)bench_instance
+		);
+
+		// Release, and process until idle
+		for ( uint8_t key = 0; key < held; key++ )
+		{
+			events[ key ] = bench_event( key + 1, ScheduleType_R );
+		}
+		bench_loop( events, held );
+		Host_step( 2 );
+	}
+}
+
+
+// Run a workload and print the results
+void bench_run( const char *name, void (*workload)( uint32_t ), uint32_t loops )
+{
+	for ( uint8_t resource = 0; resource < Latency_resources(); resource++ )
+	{
+		Latency_reset( resource );
+	}
+	bench_events = 0;
+	bench_reports = 0;
+	bench_ring.ring.tail = bench_ring.ring.head;
+
+	uint64_t start = bench_now();
+	workload( loops );
+	uint64_t elapsed = bench_now() - start;
+
+	bench_reports += bench_ring.ring.head - bench_ring.ring.tail;
+	bench_ring.ring.tail = bench_ring.ring.head;
+
+	printf( "bench,%s,%u,%llu,%llu,%llu,%.0f,%.1f,%u\n",
+		name,
+		loops,
+		(unsigned long long)bench_events,
+		(unsigned long long)bench_reports,
+		(unsigned long long)elapsed,
+		elapsed ? bench_events * 1e9 / elapsed : 0,
+		(double)elapsed / loops,
+		(unsigned)bench_instance
+	);
+
+	for ( uint8_t resource = 0; resource < Latency_resources(); resource++ )
+	{
+		printf( "latency,%s,%s,%u,%u,%u,%u,%u\n",
+			name,
+			Latency_query_name( resource ),
+			Latency_query( LatencyQuery_Count, resource ) ? Latency_query( LatencyQuery_Min, resource ) : 0,
+			Latency_query( LatencyQuery_Max, resource ),
+			Latency_query( LatencyQuery_Average, resource ),
+			Latency_query( LatencyQuery_Count, resource ),
+			(unsigned)bench_instance
+		);
+	}
+}
+
+
+// Set up a keyboard instance on the current thread and run each workload
+void *bench_thread( void *instance )
+{
+	bench_instance = (uintptr_t)instance;
+
+	Host_register_callback( bench_callback );
+	bench_ring.ring.size = BENCH_RING;
+	Host_register_report_ring( &bench_ring.ring );
+
+	// Real time, so the Latency resources measure ns
+	Host_set_clock( HostClock_Monotonic, 0 );
+	if ( !Host_init() )
+	{
+		fprintf( stderr, "instance %u could not be set up\n", (unsigned)bench_instance );
+		return 0;
+	}
+
+	// NKRO, so every key is reported
+	USBKeys_Protocol = 1;
+
+	bench_run( "typing", bench_typing, bench_loops );
+	bench_run( "rollover", bench_rollover, bench_loops );
+
+	if ( Macro_LayerNum_Host > 1 )
+	{
+		bench_run( "layer_thrash", bench_layer_thrash, bench_loops );
+	}
+
+	if ( Pixel_addDefaultAnimation )
+	{
+		bench_run( "animation", bench_animation, bench_loops );
+	}
+
+	// Each held key count is measured separately, so fewer calls per measurement
+	bench_pending( bench_loops / 100 ? bench_loops / 100 : 1 );
+
+	return 0;
+}
+
+
+int main( int argc, char **argv )
+{
+	bench_loops = argc > 1 ? strtoul( argv[1], 0, 0 ) : BENCH_LOOPS;
+	uint32_t instances = argc > 2 ? strtoul( argv[2], 0, 0 ) : 1;
+
+	if ( instances < 1 || instances > BENCH_INSTANCES )
+	{
+		fprintf( stderr, "instances must be between 1 and %u\n", BENCH_INSTANCES );
+		return 1;
+	}
+
+	printf("# bench,workload,loops,events,reports,ns,events_per_s,ns_per_loop,instance\n");
+	printf("# latency,workload,resource,min,max,average,count,instance\n");
+	printf("# pending,held,pending,calls,min_cycles,average_cycles,instance\n");
+
+	// Single instance runs on the main thread
+	if ( instances == 1 )
+	{
+		bench_thread( 0 );
+		return 0;
+	}
+
+	pthread_t threads[ BENCH_INSTANCES ];
+	for ( uintptr_t instance = 0; instance < instances; instance++ )
+	{
+		pthread_create( &threads[ instance ], 0, bench_thread, (void*)instance );
+	}
+	for ( uint32_t instance = 0; instance < instances; instance++ )
+	{
+		pthread_join( threads[ instance ], 0 );
+	}
+
+	return 0;
+}
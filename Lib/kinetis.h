@@ -77,7 +77,11 @@
 #define PORT_PCR_SRE                    (uint32_t)0x00000004            // Slew Rate Enable
 #define PORT_PCR_PE                     (uint32_t)0x00000002            // Pull Enable
 #define PORT_PCR_PS                     (uint32_t)0x00000001            // Pull Select
+#if defined(_host_)
+#define PORTA_PCR0              Host_port[0][0]                  // Host GPIO model, see Lib/host.h
+#else
 #define PORTA_PCR0              *(volatile uint32_t *)0x40049000 // Pin Control Register n
+#endif
 #define PORTA_PCR1              *(volatile uint32_t *)0x40049004 // Pin Control Register n
 #define PORTA_PCR2              *(volatile uint32_t *)0x40049008 // Pin Control Register n
 #define PORTA_PCR3              *(volatile uint32_t *)0x4004900C // Pin Control Register n
@@ -3571,12 +3575,22 @@ typedef struct __attribute__((packed)) {
 #define I2S_MDR_DIVIDE(n)               ((uint32_t)(n & 0xfff))       // MCLK Divide
 
 // Chapter 47: General-Purpose Input/Output (GPIO)
+#if defined(_host_)
+// Host GPIO model, see Lib/host.h
+#define GPIOA_PDOR              Host_gpio[0].PDOR
+#define GPIOA_PSOR              Host_gpio[0].PSOR
+#define GPIOA_PCOR              Host_gpio[0].PCOR
+#define GPIOA_PTOR              Host_gpio[0].PTOR
+#define GPIOA_PDIR              Host_gpio[0].PDIR
+#define GPIOA_PDDR              Host_gpio[0].PDDR
+#else
 #define GPIOA_PDOR              *(volatile uint32_t *)0x400FF000 // Port Data Output Register
 #define GPIOA_PSOR              *(volatile uint32_t *)0x400FF004 // Port Set Output Register
 #define GPIOA_PCOR              *(volatile uint32_t *)0x400FF008 // Port Clear Output Register
 #define GPIOA_PTOR              *(volatile uint32_t *)0x400FF00C // Port Toggle Output Register
 #define GPIOA_PDIR              *(volatile uint32_t *)0x400FF010 // Port Data Input Register
 #define GPIOA_PDDR              *(volatile uint32_t *)0x400FF014 // Port Data Direction Register
+#endif
 #define GPIOB_PDOR              *(volatile uint32_t *)0x400FF040 // Port Data Output Register
 #define GPIOB_PSOR              *(volatile uint32_t *)0x400FF044 // Port Set Output Register
 #define GPIOB_PCOR              *(volatile uint32_t *)0x400FF048 // Port Clear Output Register
@@ -4439,9 +4453,12 @@ extern const uint8_t sys_reset_to_loader_magic[22];
 
 // ----- Functions -----
 
+// Host builds use the C library declarations (string.h)
+#if !defined(_host_)
 void *memset( void *addr, int val, unsigned int len );
 void *memcpy( void *dst, const void *src, unsigned int len );
 int memcmp( const void *a, const void *b, unsigned int len );
+#endif
 
 extern int nvic_execution_priority(void);
 
@@ -170,3 +170,15 @@
 	#define _teensy_3_5__3_6_ 1
 #endif
 
+
+
+// ----- Instance State -----
+
+// Module state that belongs to a single keyboard instance
+// Firmware has a single static instance
+// Host-side KLL keeps one instance per thread, so independent keyboards can be simulated in parallel
+#if defined(_host_)
+	#define Instance __thread
+#else
+	#define Instance
+#endif
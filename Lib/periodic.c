@@ -29,7 +29,7 @@
 
 // ----- Variables -----
 
-static void (*periodic_func)(void);
+static Instance void (*periodic_func)(void);
 
 
 
@@ -40,23 +40,22 @@
 #include "delay.h"
 #include "time.h"
 
+#if defined(_host_)
+#include "host.h"
+#endif
 
 
-// ----- Variables -----
 
-#if defined(_host_)
-extern volatile uint32_t systick_millis_count;
-extern volatile uint32_t ns_since_systick_count;
-#endif
+// ----- Variables -----
 
 #if defined(F_CPU)
 // Ticks per ms
 const uint32_t Time_maxTicks = F_CPU / 1000;
 const uint32_t Time_maxTicks_ms = 0xFFFFFFFF / ( F_CPU / 1000 );
 #elif defined(_host_)
-// TODO (HaaTa) This is variable, should be set in KLL?
-const uint32_t Time_maxTicks = 1;
-const uint32_t Time_maxTicks_ms = 1;
+// Ticks per ms, ticks are ns (see Lib/host.h)
+const uint32_t Time_maxTicks = Host_ticksPer_ms;
+const uint32_t Time_maxTicks_ms = 0xFFFFFFFF / Host_ticksPer_ms;
 #endif
 
 #if F_CPU == 72000000
@@ -64,7 +63,7 @@ const char* Time_ticksPer_ns_str = "13.889 ns";
 #elif F_CPU == 48000000
 const char* Time_ticksPer_ns_str = "20.833 ns";
 #elif defined(_host_)
-const char* Time_ticksPer_ns_str = "<USERDEFINED>";
+const char* Time_ticksPer_ns_str = "1 ns";
 #else
 const char* Time_ticksPer_ns_str = "<UNKNOWN>";
 #endif
@@ -84,6 +83,9 @@ Time Time_now()
 		.ticks = ARM_DWT_CYCCNT,
 	};
 #elif defined(_host_)
+	if ( Host_clock == HostClock_Monotonic )
+		Host_clockUpdate();
+
 	Time time = {
 		.ms    = systick_millis_count,
 		.ticks = ns_since_systick_count,
@@ -340,9 +342,15 @@ uint32_t Time_duration_ns( Time since )
 }
 
 // Number of ticks since
+// Ticks are a free running counter (ARM cycle counter, ns on the host), which wraps every Time_maxTicks_ms
 uint32_t Time_duration_ticks( Time since )
 {
-	Time duration = Time_duration_rollover( since );
-	return Time_ticks( duration );
+	Time now = Time_now();
+	if ( now.ms - since.ms >= Time_maxTicks_ms )
+	{
+		return 0xFFFFFFFF;
+	}
+
+	return now.ticks - since.ticks;
 }
 
@@ -169,7 +169,7 @@ typedef struct ScheduleLookup {
 //
 // ResultMacro.guide -> [<combo length>|<capability index>|<arg1>|<argn>|<capability index>|...|<combo length>|...|0]
 //
-// ResultMacroRecord.pos       -> <current combo position>
+// ResultMacroRecord.pos       -> <current combo position> (op offset from ResultMacroInfo.firstOp, if decoded)
 // ResultMacroRecord.state     -> <last key state>
 // ResultMacroRecord.stateType -> <last key state type>
 
@@ -184,6 +184,12 @@ typedef struct ResultMacroRecord {
 	uint8_t  stateType;
 } ResultMacroRecord;
 
+// ResultMacro metadata, decoded once from the guide during Result_setup
+typedef struct ResultMacroInfo {
+	uint8_t  comboCount; // Number of combos in the sequence, more than 1 is a long macro
+	uint16_t firstOp;    // First ResultOp of the sequence, ResultOpNone if the guide is interpreted directly
+} ResultMacroInfo;
+
 // Guide, key element
 #define ResultGuideSize( guidePtr ) sizeof( ResultGuide ) - 1 + CapabilitiesList[ (guidePtr)->index ].argCount
 typedef struct ResultGuide {
@@ -263,7 +269,7 @@ typedef enum TriggerMacroState {
 // TriggerMacro struct, one is created per TriggerMacro, no duplicates
 typedef struct TriggerMacro {
 	const uint8_t *guide;
-	const var_uint_t result;
+	const index_uint_t result;
 } TriggerMacro;
 
 typedef struct TriggerMacroRecord {
@@ -271,6 +277,21 @@ typedef struct TriggerMacroRecord {
 	TriggerMacroState state;
 } TriggerMacroRecord;
 
+// TriggerMacro metadata, decoded once from the guide during Trigger_setup
+typedef struct TriggerMacroInfo {
+	var_uint_t lastComboPos; // Guide position of the final combo (combo length byte)
+	var_uint_t lastGuidePos; // Guide position of the final TriggerGuide in the final combo
+	uint8_t    comboCount;   // Number of combos in the sequence, more than 1 is a long macro
+} TriggerMacroInfo;
+
+// Pending long TriggerMacro cursor, a node of the long TriggerMacro prefix trie
+// Range of the sorted long TriggerMacro list, all sharing the guide up to the end of the current combo
+// Position and state are kept in the TriggerMacroRecord of the first TriggerMacro in the range
+typedef struct TriggerCursor {
+	index_uint_t first; // Sorted long TriggerMacro list position
+	index_uint_t count; // Number of TriggerMacros in the range
+} TriggerCursor;
+
 // Guide, key element
 // Used for storing Trigger elements
 #define TriggerGuideSize sizeof( TriggerGuide )
@@ -281,10 +302,12 @@ typedef struct TriggerGuide {
 } TriggerGuide;
 
 // Used for incoming Trigger events
+// The first 3 bytes match TriggerGuide (type, state, index), only those are sent over the interconnect
 typedef struct TriggerEvent {
 	TriggerType   type;
 	ScheduleState state;
 	uint8_t       index;
+	uint16_t      time;  // Lower 16 bits of Time_now().ms, when the event was reported by the scan module
 } TriggerEvent;
 
 
@@ -303,6 +326,26 @@ typedef struct ResultsPending {
 	index_uint_t      size;
 } ResultsPending;
 
+// Decoded ResultGuide element, built once during Result_setup
+//  * Capability function is looked up ahead of time
+//  * Arguments are copied to 32 bit aligned storage, only the first argument is aligned by this
+//  * Later arguments keep their packed guide offsets, a wider argument is aligned only if its offset is a multiple of its size
+#define ResultOpNone      0xFFFF
+#define ResultOpComboEnd  0x01 // Last op of the combo
+#define ResultOpMacroEnd  0x02 // Last op of the sequence
+typedef struct ResultOp {
+	void   (*func)( TriggerMacro*, uint8_t, uint8_t, uint8_t* );
+	uint16_t args;  // Word index into macroResultOpArgs
+	uint8_t  flags;
+} ResultOp;
+
+// Pending list membership bitmaps
+// One bit per trigger/result macro index, set while the index is in the pending list
+#define IndexBitmapSize( num )               ( ( (num) + 7 ) / 8 )
+#define IndexBitmap_test( bitmap, index )    ( (bitmap)[ (index) >> 3 ] & ( 1 << ( (index) & 0x7 ) ) )
+#define IndexBitmap_set( bitmap, index )     ( (bitmap)[ (index) >> 3 ] |= ( 1 << ( (index) & 0x7 ) ) )
+#define IndexBitmap_clear( bitmap, index )   ( (bitmap)[ (index) >> 3 ] &= ~( 1 << ( (index) & 0x7 ) ) )
+
 
 
 // ----- Capabilities -----
@@ -380,7 +423,7 @@ typedef struct Capability {
 //   * Shift - 0x01
 //   * Latch - 0x02
 //   * Lock  - 0x04
-// Layer states are stored in the LayerState array
+// Layer states are stored in the macroLayerState array (see macro.c)
 //
 // Except for Off, all states an exist simultaneously for each layer
 // For example:
@@ -411,6 +454,23 @@ typedef struct Layer {
 
 
 
+// ----- Macro State -----
+
+// kll emits LayerState and the macro record lists, but without a storage qualifier (Instance)
+// Host builds keep their own per instance copies (see macro.c, result.c and trigger.c)
+// Firmware has a single instance, the module names are aliases of the generated arrays
+#if !defined(_host_)
+extern uint8_t LayerState[];
+extern ResultMacroRecord ResultMacroRecordList[];
+extern TriggerMacroRecord TriggerMacroRecordList[];
+
+#define macroLayerState             LayerState
+#define macroResultMacroRecordList  ResultMacroRecordList
+#define macroTriggerMacroRecordList TriggerMacroRecordList
+#endif
+
+
+
 // ----- Key Positions -----
 
 // Each positions has 6 dimensions
@@ -41,12 +41,57 @@
 #endif
 
 // Local Includes
+#include "timer.h"
 #include "trigger.h"
 #include "result.h"
 #include "macro.h"
 
 
 
+// ----- Defines -----
+
+// Maximum number of tap/hold keys that can be pressed at the same time
+#define MacroTapHoldMax 8
+
+// Maximum number of key presses held back by the chord window
+#define MacroChordMax 8
+
+// Chord window disabled by default
+#if !defined(ChordWindow_define)
+#define ChordWindow_define 0
+#endif
+
+// Multi-key combos kept for the chord window, see Macro_chordSetup
+#if !defined(ChordComboMax_define)
+#define ChordComboMax_define 16
+#endif
+
+
+
+// ----- Enums -----
+
+typedef enum MacroTapHoldState {
+	MacroTapHold_Undecided, // Pressed, waiting on the hold timeout, another key press or the release
+	MacroTapHold_Hold,      // Hold code is pressed until the key is released
+	MacroTapHold_Tap,       // Tap code was pressed, released on the next processing loop
+} MacroTapHoldState;
+
+
+
+// ----- Structs -----
+
+typedef struct MacroTapHold {
+	const TriggerMacro *trigger;
+	Time                start;
+	uint16_t            timeout;  // Hold timeout (ms)
+	uint16_t            scanCode; // ScanCode of the tap/hold key
+	uint8_t             tapCode;
+	uint8_t             holdCode;
+	MacroTapHoldState   state;
+} MacroTapHold;
+
+
+
 // ----- Function Declarations -----
 
 void cliFunc_capList   ( char* args );
@@ -58,6 +103,7 @@ void cliFunc_layerDebug( char* args );
 void cliFunc_layerList ( char* args );
 void cliFunc_layerState( char* args );
 void cliFunc_macroDebug( char* args );
+void cliFunc_macroIdle ( char* args );
 void cliFunc_macroList ( char* args );
 void cliFunc_macroProc ( char* args );
 void cliFunc_macroShow ( char* args );
@@ -65,6 +111,11 @@ void cliFunc_macroStep ( char* args );
 void cliFunc_posList   ( char* args );
 void cliFunc_voteDebug ( char* args );
 
+void Macro_layerResolve();
+void Macro_tapHoldProcess();
+void Macro_chordProcess();
+void Macro_chordRelease();
+
 
 
 // ----- Variables -----
@@ -79,6 +130,7 @@ CLIDict_Entry( layerDebug,  "Layer debug mode. Shows layer stack and any changes
 CLIDict_Entry( layerList,   "List available layers." );
 CLIDict_Entry( layerState,  "Modify specified indexed layer state <layer> <state byte>." NL "\t\t\033[35mL2\033[0m Indexed Layer 0x02" NL "\t\t0 Off, 1 Shift, 2 Latch, 4 Lock States" );
 CLIDict_Entry( macroDebug,  "Disables/Enables sending USB keycodes to the Output Module and prints U/K codes." );
+CLIDict_Entry( macroIdle,   "Show idle/active macro processing loop counts and outstanding work. Any argument resets the counts." );
 CLIDict_Entry( macroList,   "List the defined trigger and result macros." );
 CLIDict_Entry( macroProc,   "Pause/Resume macro processing." );
 CLIDict_Entry( macroShow,   "Show the macro corresponding to the given index." NL "\t\t\033[35mT16\033[0m Indexed Trigger Macro 0x10, \033[35mR12\033[0m Indexed Result Macro 0x0C" );
@@ -96,6 +148,7 @@ CLIDict_Def( macroCLIDict, "Macro Module Commands" ) = {
 	CLIDict_Item( layerList ),
 	CLIDict_Item( layerState ),
 	CLIDict_Item( macroDebug ),
+	CLIDict_Item( macroIdle ),
 	CLIDict_Item( macroList ),
 	CLIDict_Item( macroProc ),
 	CLIDict_Item( macroShow ),
@@ -107,48 +160,113 @@ CLIDict_Def( macroCLIDict, "Macro Module Commands" ) = {
 
 
 // Layer debug flag - If set, displays any changes to layers and the full layer stack on change
-uint8_t layerDebugMode;
+Instance uint8_t layerDebugMode;
 
 // Macro debug flag - If set, clears the USB Buffers after signalling processing completion
 // 1 - Disable USB output, show debug
 // 2 - Enabled USB output, show debug
 // 3 - Disable USB output
-uint8_t macroDebugMode;
+Instance uint8_t macroDebugMode;
 
 // Vote debug flag - If set show the result of each
-uint8_t voteDebugMode;
+Instance uint8_t voteDebugMode;
 
 // Macro pause flag - If set, the macro module pauses processing, unless unset, or the step counter is non-zero
-uint8_t macroPauseMode;
+Instance uint8_t macroPauseMode;
 
 // Macro step counter - If non-zero, the step counter counts down every time the macro module does one processing loop
-uint16_t macroStepCounter;
+Instance uint16_t macroStepCounter;
 
 
 // Latency resource
-static uint8_t macroLatencyResource;
+static Instance uint8_t macroLatencyResource;
 
 
 // Incoming Trigger Event Buffer
-TriggerEvent macroTriggerEventBuffer[ MaxScanCode ];
-var_uint_t macroTriggerEventBufferSize;
-var_uint_t macroTriggerEventLayerCache[ MaxScanCode ];
+Instance TriggerEvent macroTriggerEventBuffer[ MaxScanCode ];
+Instance var_uint_t macroTriggerEventBufferSize;
+Instance var_uint_t macroTriggerEventLayerCache[ MaxScanCode + 1 ];
+
+// Layer States, see kll.h
+//  * Per instance copy of the kll generated LayerState on the host, an alias of it otherwise (see kll.h)
+#if defined(_host_)
+Instance uint8_t macroLayerState[ LayerNum ];
+#endif
 
 // Layer Index Stack
 //  * When modifying layer state and the state is non-0x0, the stack must be adjusted
-index_uint_t macroLayerIndexStack[ LayerNum + 1 ] = { 0 };
-index_uint_t macroLayerIndexStackSize = 0;
+//  * Activation ordered, doubly linked list of layer indices
+//  * Layer 0 (default layer) is never in the stack, and is used as the list head
+//    macroLayerIndexStackNext[ 0 ] is the bottom of the stack, macroLayerIndexStackPrev[ 0 ] is the top
+//  * macroLayerIndexStackBits has a bit set for each layer in the stack
+Instance index_uint_t macroLayerIndexStackNext[ LayerNum ] = { 0 };
+Instance index_uint_t macroLayerIndexStackPrev[ LayerNum ] = { 0 };
+Instance uint8_t      macroLayerIndexStackBits[ IndexBitmapSize( LayerNum ) ] = { 0 };
+Instance index_uint_t macroLayerIndexStackSize = 0;
+
+// Resolved Layer Lookup
+//  * Per ScanCode, the trigger list (and layer) a press resolves to with the current layer stack
+//  * Rebuilt by Macro_layerResolve whenever the layer state changes, so a press lookup is a single read
+//  * Trigger list is 0 if the ScanCode is not defined on any active layer (including the default layer)
+Instance nat_ptr_t   *macroLayerResolvedTriggerList[ MaxScanCode + 1 ];
+Instance index_uint_t macroLayerResolvedLayer[ MaxScanCode + 1 ];
+
+#if defined(_host_)
+uint16_t Macro_LayerNum_Host = LayerNum;
+uint16_t Macro_MaxScanCode_Host = MaxScanCode;
+uint8_t  Macro_IndexWordSize_Host = IndexWordSize_define;
+#endif
 
 // TODO REMOVE when dependency no longer exists
-extern ResultsPending macroResultMacroPendingList;
-extern index_uint_t macroTriggerMacroPendingList[];
-extern index_uint_t macroTriggerMacroPendingListSize;
+extern Instance ResultsPending macroResultMacroPendingList;
+extern Instance ResultMacroRecord macroResultMacroRecordList[];
+extern Instance TriggerMacroRecord macroTriggerMacroRecordList[];
+extern Instance uint8_t macroResultMacroPendingListBits[];
+extern Instance index_uint_t macroTriggerMacroPendingList[];
+extern Instance index_uint_t macroTriggerMacroPendingListSize;
+extern Instance TriggerCursor macroTriggerCursorList[];
+extern Instance index_uint_t macroTriggerCursorListSize;
+extern Instance index_uint_t macroTriggerLongList[];
+extern Instance uint8_t macroTriggerMacroDeadlineFired;
+
+// Processing loop counters
+//  * Idle loops have nothing outstanding, and skip Trigger_process and Result_process entirely
+Instance uint32_t macroIdleLoops;
+Instance uint32_t macroActiveLoops;
+
+// Tap/Hold Keys
+//  * An entry is kept from the press of a tap/hold key until its resolved USB code is released
+Instance MacroTapHold macroTapHoldList[ MacroTapHoldMax ];
+Instance uint8_t macroTapHoldListSize = 0;
+
+// Chord Window
+//  * Presses of keys used in multi-key combos are held back for up to macroChordWindow ms (0 disables)
+//  * The keys of a chord are then evaluated together, even if they were pressed over several processing loops
+//  * If the held back keys are the keys of a combo, they only trigger TriggerMacros starting with the whole chord
+//    until they are released (see Macro_chordAllows)
+//  * Otherwise they are replayed unchanged, including their original timestamps
+//  * While a chord is held, no further presses are held back
+Instance uint16_t     macroChordWindow;
+Instance uint8_t      macroChordKeyBits[ IndexBitmapSize( MaxScanCode + 1 ) ];
+Instance TriggerEvent macroChordBuffer[ MacroChordMax ];
+Instance uint8_t      macroChordBufferSize;
+Instance uint8_t      macroChordBufferBits[ IndexBitmapSize( MaxScanCode + 1 ) ];
+Instance TriggerEvent macroChordDeferred[ MacroChordMax ]; // Releases of held back keys, sent after their press
+Instance uint8_t      macroChordDeferredSize;
+Instance uint8_t      macroChordActiveBits[ IndexBitmapSize( MaxScanCode + 1 ) ];
+Instance uint8_t      macroChordActiveSize;
+
+// Multi-key combos (length byte of the combo in its TriggerMacro guide), found by Macro_chordSetup
+// The combos of the TriggerMacros from macroChordComboResume on did not fit, and are found by walking the guides
+Instance const uint8_t *macroChordComboList[ ChordComboMax_define ];
+Instance index_uint_t   macroChordComboSize;
+Instance index_uint_t   macroChordComboResume;
 
 // Interconnect ScanCode Cache
 #if defined(ConnectEnabled_define) || defined(PressReleaseCache_define)
 // TODO This can be shrunk by the size of the max node 0 ScanCode
-TriggerEvent macroInterconnectCache[ MaxScanCode ];
-uint8_t macroInterconnectCacheSize = 0;
+Instance TriggerEvent macroInterconnectCache[ MaxScanCode ];
+Instance uint8_t macroInterconnectCacheSize = 0;
 #endif
 
 
@@ -163,54 +281,49 @@ void Macro_layerState( TriggerMacro *trigger, uint8_t state, uint8_t stateType,
 		return;
 
 	// Is layer in the LayerIndexStack?
-	uint8_t inLayerIndexStack = 0;
-	uint16_t stackItem = 0;
-	while ( stackItem < macroLayerIndexStackSize )
-	{
-		// Flag if layer is already in the LayerIndexStack
-		if ( macroLayerIndexStack[ stackItem ] == layer )
-		{
-			inLayerIndexStack = 1;
-			break;
-		}
-
-		// Increment to next item
-		stackItem++;
-	}
+	uint8_t inLayerIndexStack = IndexBitmap_test( macroLayerIndexStackBits, layer ) ? 1 : 0;
 
 	// Toggle Layer State Byte
-	if ( LayerState[ layer ] & layerState )
+	if ( macroLayerState[ layer ] & layerState )
 	{
 		// Unset
-		LayerState[ layer ] &= ~layerState;
+		macroLayerState[ layer ] &= ~layerState;
 	}
 	else
 	{
 		// Set
-		LayerState[ layer ] |= layerState;
+		macroLayerState[ layer ] |= layerState;
 	}
 
-	// If the layer was not in the LayerIndexStack add it
+	// If the layer was not in the LayerIndexStack add it to the top
 	if ( !inLayerIndexStack )
 	{
-		macroLayerIndexStack[ macroLayerIndexStackSize++ ] = layer;
+		index_uint_t top = macroLayerIndexStackPrev[ 0 ];
+		macroLayerIndexStackPrev[ layer ] = top;
+		macroLayerIndexStackNext[ layer ] = 0;
+		macroLayerIndexStackNext[ top ] = layer;
+		macroLayerIndexStackPrev[ 0 ] = layer;
+
+		IndexBitmap_set( macroLayerIndexStackBits, layer );
+		macroLayerIndexStackSize++;
 	}
 
 	// If the layer is in the LayerIndexStack and the state is 0x00, remove
-	if ( LayerState[ layer ] == 0x00 && inLayerIndexStack )
+	if ( macroLayerState[ layer ] == 0x00 && inLayerIndexStack )
 	{
-		// Remove the layer from the LayerIndexStack
-		// Using the already positioned stackItem variable from the loop above
-		while ( stackItem < macroLayerIndexStackSize )
-		{
-			macroLayerIndexStack[ stackItem ] = macroLayerIndexStack[ stackItem + 1 ];
-			stackItem++;
-		}
+		// Unlink the layer from the LayerIndexStack
+		index_uint_t prev = macroLayerIndexStackPrev[ layer ];
+		index_uint_t next = macroLayerIndexStackNext[ layer ];
+		macroLayerIndexStackNext[ prev ] = next;
+		macroLayerIndexStackPrev[ next ] = prev;
 
-		// Reduce LayerIndexStack size
+		IndexBitmap_clear( macroLayerIndexStackBits, layer );
 		macroLayerIndexStackSize--;
 	}
 
+	// Update resolved layer lookup
+	Macro_layerResolve();
+
 	// Layer Debug Mode
 	if ( layerDebugMode )
 	{
@@ -219,17 +332,17 @@ void Macro_layerState( TriggerMacro *trigger, uint8_t state, uint8_t stateType,
 		// Iterate over each of the layers displaying the state as a hex value
 		for ( index_uint_t index = 0; index < LayerNum; index++ )
 		{
-			printHex_op( LayerState[ index ], 0 );
+			printHex_op( macroLayerState[ index ], 0 );
 		}
 
 		// Always show the default layer (it's always 0)
 		print(" 0");
 
-		// Iterate over the layer stack starting from the bottom of the stack
-		for ( index_uint_t index = macroLayerIndexStackSize; index > 0; index-- )
+		// Iterate over the layer stack starting from the top of the stack
+		for ( index_uint_t index = macroLayerIndexStackPrev[ 0 ]; index != 0; index = macroLayerIndexStackPrev[ index ] )
 		{
 			print(":");
-			printHex_op( macroLayerIndexStack[ index - 1 ], 0 );
+			printHex_op( index, 0 );
 		}
 
 		print( NL );
@@ -335,11 +448,11 @@ void Macro_layerShift_capability( TriggerMacro *trigger, uint8_t state, uint8_t
 	uint16_t layer = *(uint16_t*)(&args[0]);
 
 	// Only set the layer if it is disabled
-	if ( LayerState[ layer ] != 0x00 && state == 0x01 )
+	if ( macroLayerState[ layer ] != 0x00 && state == 0x01 )
 		return;
 
 	// Only unset the layer if it is enabled
-	if ( LayerState[ layer ] == 0x00 && state == 0x03 )
+	if ( macroLayerState[ layer ] == 0x00 && state == 0x03 )
 		return;
 
 	Macro_layerState( trigger, state, stateType, layer, 0x01 );
@@ -349,7 +462,7 @@ void Macro_layerShift_capability( TriggerMacro *trigger, uint8_t state, uint8_t
 // Rotate layer to next/previous
 // Uses state variable to keep track of the current layer position
 // Layers are still evaluated using the layer stack
-uint16_t Macro_rotationLayer;
+Instance uint16_t Macro_rotationLayer;
 void Macro_layerRotate_capability( TriggerMacro *trigger, uint8_t state, uint8_t stateType, uint8_t *args )
 {
 	// Display capability name
@@ -398,6 +511,114 @@ void Macro_layerRotate_capability( TriggerMacro *trigger, uint8_t state, uint8_t
 }
 
 
+// Tap/Hold (dual-role) key
+// Resolved by whichever comes first
+//  * Hold timeout expires -> Hold
+//  * Another key is pressed -> Hold
+//  * Key is released -> Tap
+// The resolved USB code is sent in the same processing loop as the deciding event (see Macro_tapHoldProcess)
+// Argument #1: Tap USB Code -> uint8_t
+// Argument #2: Hold USB Code -> uint8_t
+// Argument #3: Hold Timeout (ms) -> uint16_t
+void Macro_tapHold_capability( TriggerMacro *trigger, uint8_t state, uint8_t stateType, uint8_t *args )
+{
+	// Display capability name
+	if ( stateType == 0xFF && state == 0xFF )
+	{
+		print("Macro_tapHold(tapCode,holdCode,timeout)");
+		return;
+	}
+
+	// Only use capability on press or release
+	// TODO Analog
+	if ( stateType != 0x00 || state == 0x02 ) // Hold condition
+		return;
+
+	// Without a TriggerMacro (e.g. capSelect) there is nothing to time, just tap
+	const TriggerMacroInfo *info = Trigger_triggerMacroInfo( trigger );
+	if ( info == 0 )
+	{
+		Output_usbCodeSend_capability( trigger, state, stateType, &args[0] );
+		return;
+	}
+
+	// Lookup tap/hold entry
+	MacroTapHold *entry = 0;
+	for ( uint8_t pos = 0; pos < macroTapHoldListSize; pos++ )
+	{
+		if ( macroTapHoldList[ pos ].trigger == trigger )
+		{
+			entry = &macroTapHoldList[ pos ];
+			break;
+		}
+	}
+
+	switch ( state )
+	{
+	case 0x01: // Press
+		// Ignore if already pressed
+		if ( entry != 0 )
+			break;
+
+		if ( macroTapHoldListSize >= MacroTapHoldMax )
+		{
+			warn_print("Tap/Hold key limit reached");
+			break;
+		}
+
+		entry = &macroTapHoldList[ macroTapHoldListSize++ ];
+		entry->trigger  = trigger;
+		entry->start    = Time_now();
+		entry->tapCode  = args[0];
+		entry->holdCode = args[1];
+		entry->timeout  = *(uint16_t*)(&args[2]);
+		entry->state    = MacroTapHold_Undecided;
+
+		// ScanCode of the last key in the trigger, used to detect other key presses
+		TriggerGuide *guide = (TriggerGuide*)&trigger->guide[ info->lastGuidePos ];
+		entry->scanCode = Trigger_switchScanCode( guide->type, guide->scanCode );
+
+		// No timeout, always hold
+		if ( entry->timeout == 0 )
+		{
+			entry->state = MacroTapHold_Hold;
+			Output_usbCodeSend_capability( trigger, 0x01, 0x00, &entry->holdCode );
+			break;
+		}
+
+		// Re-evaluate the trigger once the timeout expires, even if no event arrives
+		Time deadline = entry->start;
+		deadline.ms += entry->timeout;
+		Timer_set( trigger - TriggerMacroList, deadline );
+		break;
+
+	case 0x03: // Release
+		if ( entry == 0 )
+			break;
+
+		switch ( entry->state )
+		{
+		// Released before being resolved, tap
+		// The tap code is released on the next processing loop, so the press is reported
+		case MacroTapHold_Undecided:
+			Timer_cancel( trigger - TriggerMacroList );
+			entry->state = MacroTapHold_Tap;
+			Output_usbCodeSend_capability( trigger, 0x01, 0x00, &entry->tapCode );
+			break;
+
+		case MacroTapHold_Hold:
+			Output_usbCodeSend_capability( trigger, 0x03, 0x00, &entry->holdCode );
+			*entry = macroTapHoldList[ --macroTapHoldListSize ];
+			break;
+
+		default:
+			break;
+		}
+		break;
+	}
+}
+
+
 
 // ----- Debug Functions -----
 
@@ -561,64 +782,419 @@ void Macro_showTriggerGuide( TriggerGuide *guide )
 
 // ----- Functions -----
 
-// Looks up the trigger list for the given scan code (from the active layer)
-// NOTE: Calling function must handle the NULL pointer case
-nat_ptr_t *Macro_layerLookup( TriggerEvent *event, uint8_t latch_expire )
+// Returns 1 if a key other than the tap/hold key was pressed this processing loop
+uint8_t Macro_tapHoldInterrupted( MacroTapHold *entry )
 {
-	uint8_t index = event->index;
+	for ( var_uint_t key = 0; key < macroTriggerEventBufferSize; key++ )
+	{
+		TriggerEvent *event = &macroTriggerEventBuffer[ key ];
 
-	// TODO Analog, LED, Layer, Animation
-	// If a normal key, and not pressed, do a layer cache lookup
-	if ( event->type == 0x00 && event->state != 0x01 )
+		if ( event->state != ScheduleType_P )
+			continue;
+
+		uint16_t scanCode = Trigger_switchScanCode( event->type, event->index );
+		if ( scanCode != 0xFFFF && scanCode != entry->scanCode )
+			return 1;
+	}
+
+	return 0;
+}
+
+
+// Resolves pending tap/hold keys
+//  * Undecided keys are resolved as held if the timeout expired or another key was pressed
+//  * Tapped keys release the tap code pressed during the previous processing loop
+// Called after Trigger_process, so deadlines fired during this processing loop are visible
+// USB codes are sent directly, so they are part of this processing loop's output
+void Macro_tapHoldProcess()
+{
+	uint8_t pos = 0;
+	while ( pos < macroTapHoldListSize )
 	{
-		// Cached layer
-		var_uint_t cachedLayer = macroTriggerEventLayerCache[ index ];
+		MacroTapHold *entry = &macroTapHoldList[ pos ];
+		TriggerMacro *trigger = (TriggerMacro*)entry->trigger;
+		index_uint_t triggerMacroIndex = entry->trigger - TriggerMacroList;
 
-		// Lookup map, then layer
-		nat_ptr_t **map = (nat_ptr_t**)LayerIndex[ cachedLayer ].triggerMap;
-		const Layer *layer = &LayerIndex[ cachedLayer ];
+		switch ( entry->state )
+		{
+		case MacroTapHold_Undecided:
+			if ( Trigger_deadlineFired( triggerMacroIndex )
+				|| Time_duration_ms( entry->start ) >= entry->timeout
+				|| Macro_tapHoldInterrupted( entry ) )
+			{
+				Timer_cancel( triggerMacroIndex );
+				entry->state = MacroTapHold_Hold;
+				Output_usbCodeSend_capability( trigger, 0x01, 0x00, &entry->holdCode );
+			}
+			break;
 
-		// Cache trigger list before attempting to expire latch
-		nat_ptr_t *trigger_list = map[ index - layer->first ];
+		case MacroTapHold_Tap:
+			Output_usbCodeSend_capability( trigger, 0x03, 0x00, &entry->tapCode );
 
-		// Check if latch has been pressed for this layer
-		uint8_t latch = LayerState[ cachedLayer ] & 0x02;
-		if ( latch && latch_expire )
+			// Replace with the last entry, and re-check this position
+			*entry = macroTapHoldList[ --macroTapHoldListSize ];
+			continue;
+
+		default:
+			break;
+		}
+
+		pos++;
+	}
+}
+
+
+// Checks the held back keys against a multi-key combo
+// Sets complete if they are exactly its keys, extendable if they are some of its keys
+void Macro_chordMatchCombo( const uint8_t *combo, uint8_t *complete, uint8_t *extendable )
+{
+	uint8_t comboLength = combo[ 0 ];
+	if ( comboLength < macroChordBufferSize )
+		return;
+
+	// Count the held back keys in the combo
+	uint8_t count = 0;
+	for ( uint8_t item = 0; item < comboLength; item++ )
+	{
+		TriggerGuide *comboGuide = (TriggerGuide*)&combo[ 1 + item * TriggerGuideSize ];
+		uint16_t scanCode = Trigger_switchScanCode( comboGuide->type, comboGuide->scanCode );
+		if ( scanCode != 0xFFFF && IndexBitmap_test( macroChordBufferBits, scanCode ) )
+			count++;
+	}
+
+	if ( count < macroChordBufferSize )
+		return;
+
+	if ( comboLength == macroChordBufferSize )
+		*complete = 1;
+	else
+		*extendable = 1;
+}
+
+
+// Checks the held back keys against the multi-key combos of every TriggerMacro
+// Returns 1 if they are exactly the keys of a combo
+// extendable is set if they are also part of a larger combo
+uint8_t Macro_chordMatch( uint8_t *extendable )
+{
+	uint8_t complete = 0;
+	*extendable = 0;
+
+	for ( index_uint_t combo = 0; combo < macroChordComboSize; combo++ )
+	{
+		Macro_chordMatchCombo( macroChordComboList[ combo ], &complete, extendable );
+	}
+
+	// Combos that did not fit in macroChordComboList
+	for ( index_uint_t macro = macroChordComboResume; macro < TriggerMacroNum; macro++ )
+	{
+		const uint8_t *guide = TriggerMacroList[ macro ].guide;
+		for ( var_uint_t pos = 0; guide[ pos ] != 0; pos += guide[ pos ] * TriggerGuideSize + 1 )
 		{
-			Macro_layerState( 0, 0, 0, cachedLayer, 0x02 );
-#if defined(ConnectEnabled_define) && defined(LCDEnabled_define)
-			// Evaluate the layerStack capability if available (LCD + Interconnect)
-			extern void LCD_layerStack_capability(
-				TriggerMacro *trigger,
-				uint8_t state,
-				uint8_t stateType,
-				uint8_t *args
-			);
-			LCD_layerStack_capability( 0, 0, 0, 0 );
-#endif
+			if ( guide[ pos ] >= 2 )
+				Macro_chordMatchCombo( &guide[ pos ], &complete, extendable );
 		}
+	}
 
-		return trigger_list;
+	return complete;
+}
+
+
+// Inserts events at the start of the event buffer
+// The room for the held back events is kept by Macro_eventRoom, so they always fit
+void Macro_chordInsert( TriggerEvent *events, uint8_t count )
+{
+	memmove(
+		&macroTriggerEventBuffer[ count ],
+		macroTriggerEventBuffer,
+		macroTriggerEventBufferSize * sizeof( TriggerEvent )
+	);
+	memcpy( macroTriggerEventBuffer, events, count * sizeof( TriggerEvent ) );
+	macroTriggerEventBufferSize += count;
+}
+
+
+// Replays the held back presses, ahead of the other events of this processing loop
+void Macro_chordFlush()
+{
+	// If the held back keys are a combo, they are held as a chord until released
+	uint8_t extendable;
+	if ( Macro_chordMatch( &extendable ) )
+	{
+		memcpy( macroChordActiveBits, macroChordBufferBits, sizeof( macroChordActiveBits ) );
+		macroChordActiveSize = macroChordBufferSize;
+	}
+
+	Macro_chordInsert( macroChordBuffer, macroChordBufferSize );
+
+	for ( uint8_t key = 0; key < macroChordBufferSize; key++ )
+	{
+		IndexBitmap_clear(
+			macroChordBufferBits,
+			Trigger_switchScanCode( macroChordBuffer[ key ].type, macroChordBuffer[ key ].index )
+		);
+	}
+	macroChordBufferSize = 0;
+}
+
+
+// Holds back presses of keys used in multi-key combos, then decides when to replay them
+// The chord is decided by whichever comes first
+//  * The held back keys are a combo, and are not part of a larger combo
+//  * The held back keys are not part of any combo
+//  * A held back key is released, or another key is pressed
+//  * The chord window expires
+// Events are only ever delayed, never dropped (hold events of held back keys are not pressed yet)
+void Macro_chordProcess()
+{
+	// Releases of keys replayed during the previous processing loop
+	if ( macroChordDeferredSize > 0 )
+	{
+		Macro_chordInsert( macroChordDeferred, macroChordDeferredSize );
+		macroChordDeferredSize = 0;
 	}
 
+	uint8_t flush = 0;
+	uint8_t added = 0;
+	var_uint_t tail = 0;
+	for ( var_uint_t key = 0; key < macroTriggerEventBufferSize; key++ )
+	{
+		TriggerEvent *event = &macroTriggerEventBuffer[ key ];
+		uint16_t scanCode = Trigger_switchScanCode( event->type, event->index );
+
+		// Held back key
+		if ( scanCode != 0xFFFF && IndexBitmap_test( macroChordBufferBits, scanCode ) )
+		{
+			// Released before the chord was decided, the release is sent after the replayed press
+			if ( event->state == ScheduleType_R )
+			{
+				macroChordDeferred[ macroChordDeferredSize++ ] = *event;
+				flush = 1;
+			}
+			continue;
+		}
+
+		// Hold back presses of keys used in multi-key combos
+		if ( event->state == ScheduleType_P
+			&& scanCode != 0xFFFF
+			&& macroChordWindow > 0
+			&& macroChordActiveSize == 0
+			&& macroChordBufferSize < MacroChordMax
+			&& IndexBitmap_test( macroChordKeyBits, scanCode ) )
+		{
+			IndexBitmap_set( macroChordBufferBits, scanCode );
+			macroChordBuffer[ macroChordBufferSize++ ] = *event;
+			added = 1;
+			continue;
+		}
+
+		// Any other key press decides the chord
+		if ( event->state == ScheduleType_P && macroChordBufferSize > 0 )
+		{
+			flush = 1;
+		}
+
+		macroTriggerEventBuffer[ tail++ ] = *event;
+	}
+	macroTriggerEventBufferSize = tail;
+
+	if ( macroChordBufferSize == 0 )
+		return;
+
+	if ( !flush )
+	{
+		// Chord window expired
+		if ( (uint16_t)( Time_now().ms - macroChordBuffer[ 0 ].time ) >= macroChordWindow )
+		{
+			flush = 1;
+		}
+		// Decide as soon as the held back keys cannot become a larger combo
+		else if ( added )
+		{
+			uint8_t extendable;
+			Macro_chordMatch( &extendable );
+			flush = !extendable;
+		}
+	}
+
+	if ( flush )
+	{
+		Macro_chordFlush();
+	}
+}
+
+
+// Returns 1 if the event may add the TriggerMacro to the pending list
+// While a chord is held, its keys only add TriggerMacros whose first combo has every key of the chord
+uint8_t Macro_chordAllows( TriggerEvent *event, index_uint_t triggerMacroIndex )
+{
+	uint16_t scanCode = Trigger_switchScanCode( event->type, event->index );
+	if ( scanCode == 0xFFFF || !IndexBitmap_test( macroChordActiveBits, scanCode ) )
+		return 1;
+
+	// Count the chord keys in the first combo
+	const uint8_t *guide = TriggerMacroList[ triggerMacroIndex ].guide;
+	uint8_t count = 0;
+	for ( uint8_t item = 0; item < guide[ 0 ]; item++ )
+	{
+		TriggerGuide *comboGuide = (TriggerGuide*)&guide[ 1 + item * TriggerGuideSize ];
+		uint16_t comboScanCode = Trigger_switchScanCode( comboGuide->type, comboGuide->scanCode );
+		if ( comboScanCode != 0xFFFF && IndexBitmap_test( macroChordActiveBits, comboScanCode ) )
+			count++;
+	}
+
+	return count == macroChordActiveSize;
+}
+
+
+// Removes released keys from the held chord, after the release has been processed
+void Macro_chordRelease()
+{
+	for ( var_uint_t key = 0; key < macroTriggerEventBufferSize; key++ )
+	{
+		TriggerEvent *event = &macroTriggerEventBuffer[ key ];
+		uint16_t scanCode = Trigger_switchScanCode( event->type, event->index );
+
+		if ( event->state == ScheduleType_R
+			&& scanCode != 0xFFFF
+			&& IndexBitmap_test( macroChordActiveBits, scanCode ) )
+		{
+			IndexBitmap_clear( macroChordActiveBits, scanCode );
+			macroChordActiveSize--;
+		}
+	}
+}
+
+
+// Marks every key used in a multi-key combo, only their presses are held back by the chord window
+// The combos are listed in macroChordComboList, so Macro_chordMatch does not walk every TriggerMacro
+void Macro_chordSetup()
+{
+	macroChordWindow = ChordWindow_define;
+	macroChordBufferSize = 0;
+	macroChordDeferredSize = 0;
+	macroChordActiveSize = 0;
+	memset( macroChordKeyBits, 0, sizeof( macroChordKeyBits ) );
+	memset( macroChordBufferBits, 0, sizeof( macroChordBufferBits ) );
+	memset( macroChordActiveBits, 0, sizeof( macroChordActiveBits ) );
+	macroChordComboSize = 0;
+	macroChordComboResume = TriggerMacroNum;
+
+	for ( index_uint_t macro = 0; macro < TriggerMacroNum; macro++ )
+	{
+		const uint8_t *guide = TriggerMacroList[ macro ].guide;
+		for ( var_uint_t pos = 0; guide[ pos ] != 0; pos += guide[ pos ] * TriggerGuideSize + 1 )
+		{
+			if ( guide[ pos ] < 2 )
+				continue;
+
+			// List the combo, once out of room the combos from this TriggerMacro on are found by walking the guides
+			if ( macroChordComboResume == TriggerMacroNum )
+			{
+				if ( macroChordComboSize < ChordComboMax_define )
+					macroChordComboList[ macroChordComboSize++ ] = &guide[ pos ];
+				else
+					macroChordComboResume = macro;
+			}
+
+			for ( uint8_t item = 0; item < guide[ pos ]; item++ )
+			{
+				TriggerGuide *comboGuide = (TriggerGuide*)&guide[ pos + 1 + item * TriggerGuideSize ];
+				uint16_t scanCode = Trigger_switchScanCode( comboGuide->type, comboGuide->scanCode );
+				if ( scanCode != 0xFFFF )
+					IndexBitmap_set( macroChordKeyBits, scanCode );
+			}
+		}
+	}
+
+	// Still works, but the chord window is slower to decide
+	if ( macroChordWindow > 0 && macroChordComboResume < TriggerMacroNum )
+	{
+		erro_msg("Multi-key combos not listed, increase ChordComboMax: TriggerMacro ");
+		printInt16( macroChordComboResume );
+		print( NL );
+	}
+}
+
+
+// Overlays the defined ScanCodes of a layer onto the resolved layer lookup
+void Macro_layerResolveLayer( index_uint_t layerIndex )
+{
+	const Layer *layer = &LayerIndex[ layerIndex ];
+	nat_ptr_t **map = (nat_ptr_t**)layer->triggerMap;
+
+	// Layer has no trigger map
+	if ( map == 0 )
+		return;
+
+	for ( var_uint_t index = layer->first; index <= layer->last && index <= MaxScanCode; index++ )
+	{
+		// Only override if the layer has the key defined
+		if ( *map[ index - layer->first ] != 0 )
+		{
+			macroLayerResolvedTriggerList[ index ] = map[ index - layer->first ];
+			macroLayerResolvedLayer[ index ] = layerIndex;
+		}
+	}
+}
+
+
+// Rebuilds the resolved layer lookup from the layer stack
+// Layers are overlaid from the default layer to the top of the stack, so the highest active layer wins
+void Macro_layerResolve()
+{
+	// Clear lookup
+	for ( var_uint_t index = 0; index <= MaxScanCode; index++ )
+	{
+		macroLayerResolvedTriggerList[ index ] = 0;
+		macroLayerResolvedLayer[ index ] = 0;
+	}
+
+	// Default layer
+	Macro_layerResolveLayer( 0 );
+
+	// Iterate over the layer stack starting from the bottom of the stack
+	for ( index_uint_t layer = macroLayerIndexStackNext[ 0 ]; layer != 0; layer = macroLayerIndexStackNext[ layer ] )
+	{
+		// Only use layer, if state is valid
+		// XOR each of the state bits
+		// If only two are enabled, do not use this state
+		if ( (macroLayerState[ layer ] & 0x01) ^ ((macroLayerState[ layer ] & 0x02)>>1) ^ ((macroLayerState[ layer ] & 0x04)>>2) )
+		{
+			Macro_layerResolveLayer( layer );
+		}
+	}
+}
+
+
+// Searches the layer stack, from the top, for the first active layer which defines the index
+// Falls back to the default layer, sets the layer cache if found
+// Returns 0 if the index is not defined on any layer
+nat_ptr_t *Macro_layerLookupStack( uint8_t index, uint8_t latch_expire )
+{
 	// If no trigger macro is defined at the given layer, fallthrough to the next layer
-	for ( uint16_t layerIndex = macroLayerIndexStackSize; layerIndex != 0xFFFF; layerIndex-- )
+	// Starting from the top of the stack
+	index_uint_t nextLayerIndex;
+	for ( index_uint_t layerIndex = macroLayerIndexStackPrev[ 0 ]; layerIndex != 0; layerIndex = nextLayerIndex )
 	{
 		// Lookup Layer
-		const Layer *layer = &LayerIndex[ macroLayerIndexStack[ layerIndex ] ];
+		const Layer *layer = &LayerIndex[ layerIndex ];
+
+		// Next layer down, the latch may remove this layer from the stack
+		nextLayerIndex = macroLayerIndexStackPrev[ layerIndex ];
 
 		// Check if latch has been pressed for this layer
 		// XXX Regardless of whether a key is found, the latch is removed on first lookup
-		uint8_t latch = LayerState[ macroLayerIndexStack[ layerIndex ] ] & 0x02;
+		uint8_t latch = macroLayerState[ layerIndex ] & 0x02;
 		if ( latch && latch_expire )
 		{
-			Macro_layerState( 0, 0, 0, macroLayerIndexStack[ layerIndex ], 0x02 );
+			Macro_layerState( 0, 0, 0, layerIndex, 0x02 );
 		}
 
 		// Only use layer, if state is valid
 		// XOR each of the state bits
 		// If only two are enabled, do not use this state
-		if ( (LayerState[ macroLayerIndexStack[ layerIndex ] ] & 0x01) ^ (latch>>1) ^ ((LayerState[ macroLayerIndexStack[ layerIndex ] ] & 0x04)>>2) )
+		if ( (macroLayerState[ layerIndex ] & 0x01) ^ (latch>>1) ^ ((macroLayerState[ layerIndex ] & 0x04)>>2) )
 		{
 			// Lookup layer
 			nat_ptr_t **map = (nat_ptr_t**)layer->triggerMap;
@@ -631,7 +1207,7 @@ nat_ptr_t *Macro_layerLookup( TriggerEvent *event, uint8_t latch_expire )
 				&& *map[ index - layer->first ] != 0 )
 			{
 				// Set the layer cache
-				macroTriggerEventLayerCache[ index ] = macroLayerIndexStack[ layerIndex ];
+				macroTriggerEventLayerCache[ index ] = layerIndex;
 
 				return map[ index - layer->first ];
 			}
@@ -656,6 +1232,74 @@ nat_ptr_t *Macro_layerLookup( TriggerEvent *event, uint8_t latch_expire )
 		return map[ index - layer->first ];
 	}
 
+	return 0;
+}
+
+
+// Looks up the trigger list for the given scan code (from the active layer)
+// NOTE: Calling function must handle the NULL pointer case
+nat_ptr_t *Macro_layerLookup( TriggerEvent *event, uint8_t latch_expire )
+{
+	uint8_t index = event->index;
+
+	// TODO Analog, LED, Layer, Animation
+	// If a normal key, and not pressed, do a layer cache lookup
+	if ( event->type == 0x00 && event->state != 0x01 )
+	{
+		// Cached layer
+		var_uint_t cachedLayer = macroTriggerEventLayerCache[ index ];
+
+		// Lookup map, then layer
+		nat_ptr_t **map = (nat_ptr_t**)LayerIndex[ cachedLayer ].triggerMap;
+		const Layer *layer = &LayerIndex[ cachedLayer ];
+
+		// Cache trigger list before attempting to expire latch
+		nat_ptr_t *trigger_list = map[ index - layer->first ];
+
+		// Check if latch has been pressed for this layer
+		uint8_t latch = macroLayerState[ cachedLayer ] & 0x02;
+		if ( latch && latch_expire )
+		{
+			Macro_layerState( 0, 0, 0, cachedLayer, 0x02 );
+#if defined(ConnectEnabled_define) && defined(LCDEnabled_define)
+			// Evaluate the layerStack capability if available (LCD + Interconnect)
+			extern void LCD_layerStack_capability(
+				TriggerMacro *trigger,
+				uint8_t state,
+				uint8_t stateType,
+				uint8_t *args
+			);
+			LCD_layerStack_capability( 0, 0, 0, 0 );
+#endif
+		}
+
+		return trigger_list;
+	}
+
+	nat_ptr_t *trigger_list = 0;
+
+	// Switch press, use the resolved layer lookup
+	if ( event->type == 0x00 )
+	{
+		if ( index <= MaxScanCode && macroLayerResolvedTriggerList[ index ] != 0 )
+		{
+			// Set the layer cache
+			macroTriggerEventLayerCache[ index ] = macroLayerResolvedLayer[ index ];
+
+			trigger_list = macroLayerResolvedTriggerList[ index ];
+		}
+	}
+	// Otherwise search the layer stack
+	else
+	{
+		trigger_list = Macro_layerLookupStack( index, latch_expire );
+	}
+
+	if ( trigger_list != 0 )
+	{
+		return trigger_list;
+	}
+
 	// Otherwise no defined Trigger Macro
 	erro_msg("Index has no defined Trigger Macro: ");
 	printHex( index );
@@ -664,11 +1308,40 @@ nat_ptr_t *Macro_layerLookup( TriggerEvent *event, uint8_t latch_expire )
 }
 
 
+#if defined(ConnectEnabled_define) || defined(PressReleaseCache_define)
+// Add a ScanCode to the Interconnect Cache, with the given timestamp
+// Returns 1 if added, 0 if the ScanCode is already in the buffer
+uint8_t Macro_pressReleaseCache( TriggerEvent *trigger, uint16_t time )
+{
+	// During each processing loop, a scancode may be re-added depending on it's state
+	for ( var_uint_t c = 0; c < macroInterconnectCacheSize; c++ )
+	{
+		// Check if the same ScanCode
+		if ( macroInterconnectCache[ c ].index == trigger->index )
+		{
+			// Update the state
+			macroInterconnectCache[ c ].state = trigger->state;
+			macroInterconnectCache[ c ].time  = time;
+			return 0;
+		}
+	}
+
+	// If not in the list, add it
+	// Only the TriggerGuide fields are given
+	macroInterconnectCache[ macroInterconnectCacheSize ].type  = trigger->type;
+	macroInterconnectCache[ macroInterconnectCacheSize ].state = trigger->state;
+	macroInterconnectCache[ macroInterconnectCacheSize ].index = trigger->index;
+	macroInterconnectCache[ macroInterconnectCacheSize ].time  = time;
+	macroInterconnectCacheSize++;
+
+	return 1;
+}
+
+
 // Add an interconnect ScanCode
 // These are handled differently (less information is sent, hold/off states must be assumed)
 // Returns 1 if added, 0 if the ScanCode is already in the buffer
 // Returns 2 if there's an error
-#if defined(ConnectEnabled_define) || defined(PressReleaseCache_define)
 uint8_t Macro_pressReleaseAdd( void *trigger_ptr )
 {
 	TriggerEvent *trigger = (TriggerEvent*)trigger_ptr;
@@ -718,26 +1391,78 @@ uint8_t Macro_pressReleaseAdd( void *trigger_ptr )
 		return 2;
 	}
 
-	// Add trigger to the Interconnect Cache
-	// During each processing loop, a scancode may be re-added depending on it's state
-	for ( var_uint_t c = 0; c < macroInterconnectCacheSize; c++ )
+	// Add trigger to the Interconnect Cache, timestamp when it was added
+	return Macro_pressReleaseCache( trigger, Time_now().ms );
+}
+#endif
+
+
+// Number of events that can still be added to macroTriggerEventBuffer
+// Room is kept for the Interconnect Cache, and for the events held back by the chord window (see Macro_chordInsert)
+uint16_t Macro_eventRoom()
+{
+	uint16_t used = macroTriggerEventBufferSize + macroChordBufferSize + macroChordDeferredSize;
+#if defined(ConnectEnabled_define) || defined(PressReleaseCache_define)
+	used += macroInterconnectCacheSize;
+#endif
+
+	return used < MaxScanCode ? MaxScanCode - used : 0;
+}
+
+
+// Add a TriggerEvent, keeping its timestamp
+// Switch events use the Interconnect Cache if enabled (hold states are synthesized by the trigger module)
+// Returns 1 if added, 0 if there is no room left until the next processing loop
+// Returns 2 if the index is out of range
+uint8_t Macro_eventAdd( void *event_ptr )
+{
+	TriggerEvent *event = (TriggerEvent*)event_ptr;
+
+	// Check if index is out of range
+	if ( event->index > MaxScanCode )
+		return 2;
+
+	// Events from the Interconnect Cache are added to macroTriggerEventBuffer during Macro_process
+	if ( Macro_eventRoom() <= 1 )
+		return 0;
+
+#if defined(ConnectEnabled_define) || defined(PressReleaseCache_define)
+	if ( event->type == TriggerType_Switch1 )
 	{
-		// Check if the same ScanCode
-		if ( macroInterconnectCache[ c ].index == trigger->index )
+		// Keep the pending press/release of this ScanCode, it would be replaced
+		for ( var_uint_t c = 0; c < macroInterconnectCacheSize; c++ )
 		{
-			// Update the state
-			macroInterconnectCache[ c ].state = trigger->state;
-			return 0;
+			if ( macroInterconnectCache[ c ].index == event->index
+				&& macroInterconnectCache[ c ].state != ScheduleType_H )
+			{
+				return 0;
+			}
 		}
-	}
 
-	// If not in the list, add it
-	macroInterconnectCache[ macroInterconnectCacheSize++ ] = *trigger;
+		Macro_pressReleaseCache( event, event->time );
+		return 1;
+	}
+#endif
 
+	macroTriggerEventBuffer[ macroTriggerEventBufferSize++ ] = *event;
 	return 1;
 }
+
+
+// Discards the key events not yet processed, and releases every held key
+// Used when key events may have been lost (e.g. an event buffer overflow), so no key stays held without its Release
+// The Release events are processed by the next Macro_process
+void Macro_clearPending()
+{
+	macroTriggerEventBufferSize = 0;
+#if defined(ConnectEnabled_define) || defined(PressReleaseCache_define)
+	macroInterconnectCacheSize = 0;
 #endif
 
+	uint16_t room = Macro_eventRoom();
+	macroTriggerEventBufferSize = Trigger_releaseHeld( macroTriggerEventBuffer, room > 0 ? room - 1 : 0 );
+}
+
 
 // Update the scancode key state
 // States:
@@ -802,9 +1527,14 @@ void Macro_keyState( uint16_t scanCode, uint8_t state )
 			type = TriggerType_Switch4;
 		}
 
+		// No room left until the next processing loop
+		if ( Macro_eventRoom() == 0 )
+			return;
+
 		macroTriggerEventBuffer[ macroTriggerEventBufferSize ].index = index;
 		macroTriggerEventBuffer[ macroTriggerEventBufferSize ].state = state;
 		macroTriggerEventBuffer[ macroTriggerEventBufferSize ].type  = type;
+		macroTriggerEventBuffer[ macroTriggerEventBufferSize ].time  = Time_now().ms;
 		macroTriggerEventBufferSize++;
 		break;
 	}
@@ -847,9 +1577,14 @@ void Macro_analogState( uint16_t scanCode, uint8_t state )
 		type = TriggerType_Analog4;
 	}
 
+	// No room left until the next processing loop
+	if ( Macro_eventRoom() == 0 )
+		return;
+
 	macroTriggerEventBuffer[ macroTriggerEventBufferSize ].index = index;
 	macroTriggerEventBuffer[ macroTriggerEventBufferSize ].state = state;
 	macroTriggerEventBuffer[ macroTriggerEventBufferSize ].type  = type;
+	macroTriggerEventBuffer[ macroTriggerEventBufferSize ].time  = Time_now().ms;
 	macroTriggerEventBufferSize++;
 }
 
@@ -874,9 +1609,14 @@ void Macro_ledState( uint16_t ledCode, uint8_t state )
 	case ScheduleType_A:  // Activate
 	case ScheduleType_On: // On
 	case ScheduleType_D:  // Deactivate
+		// No room left until the next processing loop
+		if ( Macro_eventRoom() == 0 )
+			return;
+
 		macroTriggerEventBuffer[ macroTriggerEventBufferSize ].index = index;
 		macroTriggerEventBuffer[ macroTriggerEventBufferSize ].state = state;
 		macroTriggerEventBuffer[ macroTriggerEventBufferSize ].type  = type;
+		macroTriggerEventBuffer[ macroTriggerEventBufferSize ].time  = Time_now().ms;
 		macroTriggerEventBufferSize++;
 		break;
 	}
@@ -934,9 +1674,14 @@ void Macro_animationState( uint16_t animationIndex, uint8_t state )
 			type = TriggerType_Animation4;
 		}
 
+		// No room left until the next processing loop
+		if ( Macro_eventRoom() == 0 )
+			return;
+
 		macroTriggerEventBuffer[ macroTriggerEventBufferSize ].index = index;
 		macroTriggerEventBuffer[ macroTriggerEventBufferSize ].state = state;
 		macroTriggerEventBuffer[ macroTriggerEventBufferSize ].type  = type;
+		macroTriggerEventBuffer[ macroTriggerEventBufferSize ].time  = Time_now().ms;
 		macroTriggerEventBufferSize++;
 		break;
 	}
@@ -997,6 +1742,7 @@ void Macro_layerState( uint16_t layerIndex, uint8_t state )
 		macroTriggerEventBuffer[ macroTriggerEventBufferSize ].index = index;
 		macroTriggerEventBuffer[ macroTriggerEventBufferSize ].state = state;
 		macroTriggerEventBuffer[ macroTriggerEventBufferSize ].type  = type;
+		macroTriggerEventBuffer[ macroTriggerEventBufferSize ].time  = Time_now().ms;
 		macroTriggerEventBufferSize++;
 		break;
 	}
@@ -1009,49 +1755,76 @@ void Macro_layerState( uint16_t layerIndex, uint8_t state )
 void Macro_appendResultMacroToPendingList( const TriggerMacro *triggerMacro )
 {
 	// Lookup result macro index
-	var_uint_t resultMacroIndex = triggerMacro->result;
+	index_uint_t resultMacroIndex = triggerMacro->result;
+
+	// Lookup scanCode of the last key in the last combo
+	const TriggerMacroInfo *info = Trigger_triggerMacroInfo( triggerMacro );
+	TriggerGuide *guide = (TriggerGuide*)&triggerMacro->guide[ info->lastGuidePos ];
+
+	// Lookup scanCode in the event lookup for the current state and stateType
+	uint16_t scanCode = Trigger_switchScanCode( guide->type, guide->scanCode );
+	uint8_t state = scanCode != 0xFFFF ? Trigger_switchState( scanCode ) : 0x00;
 
-	// Iterate through result macro pending list, making sure this macro hasn't been added yet
-	for ( var_uint_t macro = 0; macro < macroResultMacroPendingList.size; macro++ )
+	// Make sure this macro hasn't been added yet, if duplicate, do nothing
+	// Unless it was added by a held key, then a release from another TriggerMacro is kept
+	if ( IndexBitmap_test( macroResultMacroPendingListBits, resultMacroIndex ) )
 	{
-		// If duplicate found, do nothing
-		if ( macroResultMacroPendingList.data[ macro ].index == resultMacroIndex )
-			return;
+		if ( macroResultMacroRecordList[ resultMacroIndex ].state == ScheduleType_H
+			&& state == ScheduleType_R )
+		{
+			macroResultMacroRecordList[ resultMacroIndex ].state     = state;
+			macroResultMacroRecordList[ resultMacroIndex ].stateType = guide->type;
+		}
+		return;
 	}
 
 	// No duplicates found, add to pending list
+	IndexBitmap_set( macroResultMacroPendingListBits, resultMacroIndex );
 	macroResultMacroPendingList.data[ macroResultMacroPendingList.size ].trigger = (TriggerMacro*)triggerMacro;
 	macroResultMacroPendingList.data[ macroResultMacroPendingList.size++ ].index = resultMacroIndex;
 
-	// Lookup scanCode of the last key in the last combo
-	var_uint_t pos = 0;
-	for ( uint8_t comboLength = triggerMacro->guide[0]; comboLength > 0; )
+	if ( state != 0x00 )
 	{
-		pos += TriggerGuideSize * comboLength + 1;
-		comboLength = triggerMacro->guide[ pos ];
-	}
-
-	uint8_t scanCode = ((TriggerGuide*)&triggerMacro->guide[ pos - TriggerGuideSize ])->scanCode;
-
-	// Lookup scanCode in buffer list for the current state and stateType
-	for ( var_uint_t keyIndex = 0; keyIndex < macroTriggerEventBufferSize; keyIndex++ )
-	{
-		if ( macroTriggerEventBuffer[ keyIndex ].index == scanCode )
-		{
-			ResultMacroRecordList[ resultMacroIndex ].state     = macroTriggerEventBuffer[ keyIndex ].state;
-			ResultMacroRecordList[ resultMacroIndex ].stateType = macroTriggerEventBuffer[ keyIndex ].type;
-		}
+		macroResultMacroRecordList[ resultMacroIndex ].state     = state;
+		macroResultMacroRecordList[ resultMacroIndex ].stateType = guide->type;
 	}
 
 	// Reset the macro position
-	ResultMacroRecordList[ resultMacroIndex ].pos = 0;
+	macroResultMacroRecordList[ resultMacroIndex ].pos = 0;
 }
 
 
 // Macro Procesing Loop
 // Called once per USB buffer send
+// Returns 1 if there is nothing for Macro_process to do
+// Deadlines that fired during the last loop must be cleared by Trigger_process before the next event
+uint8_t Macro_idle()
+{
+	return macroTriggerEventBufferSize == 0
+#if defined(ConnectEnabled_define) || defined(PressReleaseCache_define)
+		&& macroInterconnectCacheSize == 0
+#endif
+		&& macroTriggerMacroPendingListSize == 0
+		&& macroTriggerCursorListSize == 0
+		&& macroResultMacroPendingList.size == 0
+		&& Timer_count() == 0
+		&& macroTriggerMacroDeadlineFired == 0
+		&& macroTapHoldListSize == 0
+		&& macroChordBufferSize == 0
+		&& macroChordDeferredSize == 0;
+}
+
+
 void Macro_process()
 {
+	// Skip processing, nothing outstanding
+	if ( Macro_idle() )
+	{
+		macroIdleLoops++;
+		return;
+	}
+	macroActiveLoops++;
+
 	// Latency measurement
 	Latency_start_time( macroLatencyResource );
 
@@ -1075,42 +1848,13 @@ void Macro_process()
 	if ( Connect_master && macroInterconnectCacheSize > 0 )
 #endif
 	{
-		// Iterate over all the cache ScanCodes
-		uint8_t currentInterconnectCacheSize = macroInterconnectCacheSize;
-		macroInterconnectCacheSize = 0;
-		for ( uint8_t c = 0; c < currentInterconnectCacheSize; c++ )
+		// Move the cache ScanCodes to the trigger list
+		// Press/Release only, Hold is synthesized from the held key set (see Trigger_buildEventLookup)
+		for ( uint8_t c = 0; c < macroInterconnectCacheSize; c++ )
 		{
-			// Add to the trigger list
 			macroTriggerEventBuffer[ macroTriggerEventBufferSize++ ] = macroInterconnectCache[ c ];
-
-			// TODO Handle other TriggerGuide types (e.g. analog)
-			switch ( macroInterconnectCache[ c ].type )
-			{
-			// Normal (Press/Hold/Release)
-			case TriggerType_Switch1:
-				// Decide what to do based on the current state
-				switch ( macroInterconnectCache[ c ].state )
-				{
-				// Re-add to interconnect cache in hold state
-				case ScheduleType_P: // Press
-				//case ScheduleType_H: // Hold // XXX Why does this not work? -HaaTa
-					macroInterconnectCache[ c ].state = 0x02;
-					macroInterconnectCache[ macroInterconnectCacheSize++ ] = macroInterconnectCache[ c ];
-					break;
-
-				case ScheduleType_R: // Release
-					break;
-
-				// Otherwise, do not re-add
-				default:
-					break;
-				}
-
-			// Not implemented
-			default:
-				erro_print("Interconnect Trigger Event Type - Not Implemented");
-			}
 		}
+		macroInterconnectCacheSize = 0;
 	}
 #endif
 	// Macro incoming state debug
@@ -1135,7 +1879,9 @@ void Macro_process()
 	if ( macroTriggerEventBufferSize >= MaxScanCode )
 	{
 		erro_print("Macro Trigger Event Overflow! Serious Bug!");
-		macroTriggerEventBufferSize = 0;
+
+		// Events were lost, release the held keys rather than leave them held
+		Macro_clearPending();
 	}
 
 	// If the pause flag is set, only process if the step counter is non-zero
@@ -1149,13 +1895,33 @@ void Macro_process()
 		dbug_print("Macro Step");
 	}
 
+	// Hold back, or replay, chord key presses
+	if ( macroChordWindow > 0 || macroChordBufferSize > 0 || macroChordDeferredSize > 0 )
+	{
+		Macro_chordProcess();
+	}
+
 	// Process Trigger Macros
 	Trigger_process();
 
+	// Release keys from a held chord
+	if ( macroChordActiveSize > 0 )
+	{
+		Macro_chordRelease();
+	}
+
+	// Resolve tap/hold keys
+	if ( macroTapHoldListSize > 0 )
+	{
+		Macro_tapHoldProcess();
+	}
 
 	// Process result macros
 	Result_process();
 
+	// Apply the USB Codes sent by the result macros in a single pass
+	Output_usbCodeApply();
+
 	// Signal buffer that we've used it
 	Scan_finishedWithMacro( macroTriggerEventBufferSize );
 
@@ -1168,7 +1934,7 @@ void Macro_process()
 	// If Macro debug mode is set, clear the USB Buffer
 	if ( macroDebugMode == 1 || macroDebugMode == 3 )
 	{
-		USBKeys_primary.changed = 0;
+		Output_usbReportDiscard();
 	}
 }
 
@@ -1196,6 +1962,19 @@ inline void Macro_setup()
 	// Set the current rotated layer to 0
 	Macro_rotationLayer = 0;
 
+	// No tap/hold keys pressed
+	macroTapHoldListSize = 0;
+
+	// Reset processing loop counters
+	macroIdleLoops = 0;
+	macroActiveLoops = 0;
+
+	// Setup chord window
+	Macro_chordSetup();
+
+	// Build resolved layer lookup
+	Macro_layerResolve();
+
 	// Layer debug mode
 	layerDebugMode = 0;
 
@@ -1425,7 +2204,7 @@ void cliFunc_layerList( char* args )
 
 		// Layer State
 		print( NL "\t\t Layer State: " );
-		printHex( LayerState[ layer ] );
+		printHex( macroLayerState[ layer ] );
 
 		// First -> Last Indices
 		print(" First -> Last Indices: ");
@@ -1476,7 +2255,8 @@ void cliFunc_layerState( char* args )
 			printHex( arg2 );
 
 			// Set the layer state
-			LayerState[ arg1 ] = arg2;
+			macroLayerState[ arg1 ] = arg2;
+			Macro_layerResolve();
 			break;
 		}
 	}
@@ -1519,6 +2299,44 @@ void cliFunc_macroDebug( char* args )
 	printInt8( macroDebugMode );
 }
 
+void cliFunc_macroIdle( char* args )
+{
+	char* arg1Ptr;
+	char* arg2Ptr;
+	CLI_argumentIsolation( args, &arg1Ptr, &arg2Ptr );
+
+	// Reset counters
+	if ( *arg1Ptr != '\0' )
+	{
+		macroIdleLoops = 0;
+		macroActiveLoops = 0;
+	}
+
+	print( NL );
+	info_msg("Idle Loops: ");
+	printInt32( macroIdleLoops );
+	print( NL );
+	info_msg("Active Loops: ");
+	printInt32( macroActiveLoops );
+
+	// Outstanding work, any of these keep Macro_process active
+	print( NL );
+	info_msg("Events: ");
+	printInt16( (uint16_t)macroTriggerEventBufferSize );
+	print(" Triggers: ");
+	printInt16( (uint16_t)macroTriggerMacroPendingListSize );
+	print(" Cursors: ");
+	printInt16( (uint16_t)macroTriggerCursorListSize );
+	print(" Results: ");
+	printInt16( (uint16_t)macroResultMacroPendingList.size );
+	print(" Timers: ");
+	printInt16( (uint16_t)Timer_count() );
+	print(" Tap/Hold: ");
+	printInt8( macroTapHoldListSize );
+	print(" Chord: ");
+	printInt8( macroChordBufferSize + macroChordDeferredSize );
+}
+
 void cliFunc_macroList( char* args )
 {
 	// Show pending key events
@@ -1537,18 +2355,34 @@ void cliFunc_macroList( char* args )
 	info_msg("Pending Trigger Macros: ");
 	printInt16( (uint16_t)macroTriggerMacroPendingListSize );
 	print(" : ");
-	for ( var_uint_t macro = 0; macro < macroTriggerMacroPendingListSize; macro++ )
+	for ( index_uint_t macro = 0; macro < macroTriggerMacroPendingListSize; macro++ )
 	{
 		printHex( macroTriggerMacroPendingList[ macro ] );
 		print(" ");
 	}
 
+	// Show pending long trigger macros, grouped by cursor
+	print( NL );
+	info_msg("Pending Long Trigger Macro Cursors: ");
+	printInt16( (uint16_t)macroTriggerCursorListSize );
+	print(" :");
+	for ( index_uint_t cursor = 0; cursor < macroTriggerCursorListSize; cursor++ )
+	{
+		print(" [");
+		for ( index_uint_t item = 0; item < macroTriggerCursorList[ cursor ].count; item++ )
+		{
+			print(" ");
+			printHex( macroTriggerLongList[ macroTriggerCursorList[ cursor ].first + item ] );
+		}
+		print(" ]");
+	}
+
 	// Show pending result macros
 	print( NL );
 	info_msg("Pending Result Macros: ");
 	printInt16( (uint16_t)macroResultMacroPendingList.size );
 	print(" : ");
-	for ( var_uint_t macro = 0; macro < macroResultMacroPendingList.size; macro++ )
+	for ( index_uint_t macro = 0; macro < macroResultMacroPendingList.size; macro++ )
 	{
 		printHex( macroResultMacroPendingList.data[ macro ].index );
 		print(" ");
@@ -1567,7 +2401,7 @@ void cliFunc_macroList( char* args )
 	// Show Trigger to Result Macro Links
 	print( NL );
 	info_msg("Trigger : Result Macro Pairs");
-	for ( var_uint_t macro = 0; macro < TriggerMacroNum; macro++ )
+	for ( index_uint_t macro = 0; macro < TriggerMacroNum; macro++ )
 	{
 		print( NL );
 		print("\tT");
@@ -1587,7 +2421,7 @@ void cliFunc_macroProc( char* args )
 	printInt8( macroPauseMode );
 }
 
-void macroDebugShowTrigger( var_uint_t index )
+void macroDebugShowTrigger( index_uint_t index )
 {
 	// Only proceed if the macro exists
 	if ( index >= TriggerMacroNum )
@@ -1595,7 +2429,7 @@ void macroDebugShowTrigger( var_uint_t index )
 
 	// Trigger Macro Show
 	const TriggerMacro *macro = &TriggerMacroList[ index ];
-	TriggerMacroRecord *record = &TriggerMacroRecordList[ index ];
+	TriggerMacroRecord *record = &macroTriggerMacroRecordList[ index ];
 
 	print( NL );
 	info_msg("Trigger Macro Index: ");
@@ -1659,7 +2493,7 @@ void macroDebugShowTrigger( var_uint_t index )
 	}
 }
 
-void macroDebugShowResult( var_uint_t index )
+void macroDebugShowResult( index_uint_t index )
 {
 	// Only proceed if the macro exists
 	if ( index >= ResultMacroNum )
@@ -1667,7 +2501,7 @@ void macroDebugShowResult( var_uint_t index )
 
 	// Trigger Macro Show
 	const ResultMacro *macro = &ResultMacroList[ index ];
-	ResultMacroRecord *record = &ResultMacroRecordList[ index ];
+	ResultMacroRecord *record = &macroResultMacroRecordList[ index ];
 
 	print( NL );
 	info_msg("Result Macro Index: ");
@@ -29,6 +29,20 @@
 
 
 
+// ----- Defines -----
+
+// Decoded ResultOp storage (ops, and 32 bit argument words), see ResultOpsPerMacro in capabilities.kll
+// ResultMacros that do not fit are interpreted directly from their guide, and reported by Result_setup
+// 0 (default) interprets every guide, and keeps no op storage
+#if !defined(ResultOpsPerMacro_define)
+#define ResultOpsPerMacro_define 0
+#endif
+
+#define ResultOpMax    ( ResultMacroNum * ResultOpsPerMacro_define )
+#define ResultOpArgMax ( ResultMacroNum * ResultOpsPerMacro_define )
+
+
+
 // ----- Enums -----
 
 typedef enum ResultMacroEval {
@@ -44,7 +58,6 @@ typedef enum ResultMacroEval {
 extern const Capability CapabilitiesList[];
 
 extern const ResultMacro ResultMacroList[];
-extern ResultMacroRecord ResultMacroRecordList[];
 
 
 
@@ -52,18 +65,78 @@ extern ResultMacroRecord ResultMacroRecordList[];
 
 // Pending Result Macro Index List
 //  * Any result macro that needs processing from a previous macro processing loop
-ResultsPending macroResultMacroPendingList;
+Instance ResultsPending macroResultMacroPendingList;
+
+// Pending Result Macro membership bitmap
+//  * Bit is set for each result macro index in macroResultMacroPendingList
+Instance uint8_t macroResultMacroPendingListBits[ IndexBitmapSize( ResultMacroNum ) ];
+
+// ResultMacro states, per instance copy of the kll generated ResultMacroRecordList on the host (see kll.h)
+#if defined(_host_)
+Instance ResultMacroRecord macroResultMacroRecordList[ ResultMacroNum ];
+#endif
+
+// ResultMacro metadata
+//  * Decoded from each ResultMacro guide during Result_setup, guides are constant
+Instance ResultMacroInfo macroResultMacroInfo[ ResultMacroNum ];
+
+// Decoded ResultMacro guides
+//  * Each sequence is a contiguous run of ops, see ResultMacroInfo.firstOp
+//  * Capability arguments start on a 32 bit boundary (offsets within them are unchanged, see ResultOp)
+Instance ResultOp macroResultOpList[ ResultOpMax ];
+Instance uint16_t macroResultOpListSize;
+Instance uint32_t macroResultOpArgs[ ResultOpArgMax ];
+Instance uint16_t macroResultOpArgsSize;
+
+// Number of ResultMacros that did not fit in the decoded op storage
+Instance uint16_t macroResultOpOverflow;
+
+// Decode ResultMacro guides into ops
+//  * When 0, every ResultMacro is interpreted from its guide
+//  * Only change while nothing is pending, followed by Result_setup, the host tests use it to compare both paths
+Instance uint8_t macroResultOpDecode = 1;
 
 
 
 // ----- Functions -----
 
-// Evaluate/Update ResultMacro
-ResultMacroEval Macro_evalResultMacro( ResultPendingElem resultElem )
+// Evaluate/Update ResultMacro, using the decoded ops
+ResultMacroEval Macro_evalResultOps( ResultPendingElem resultElem, const ResultMacroInfo *info )
+{
+	ResultMacroRecord *record = &macroResultMacroRecordList[ resultElem.index ];
+
+	// Current combo
+	const ResultOp *first = &macroResultOpList[ info->firstOp ];
+	const ResultOp *op = &first[ record->pos ];
+
+	// Call each capability in the combo
+	for ( ;; op++ )
+	{
+		op->func( resultElem.trigger, record->state, record->stateType, (uint8_t*)&macroResultOpArgs[ op->args ] );
+
+		if ( op->flags & ResultOpComboEnd )
+			break;
+	}
+
+	// If the ResultMacro is finished, remove
+	if ( op->flags & ResultOpMacroEnd )
+	{
+		record->pos = 0;
+		return ResultMacroEval_Remove;
+	}
+
+	// Otherwise move to the next combo and leave the macro in the list
+	record->pos = op - first + 1;
+	return ResultMacroEval_DoNothing;
+}
+
+
+// Evaluate/Update ResultMacro, interpreting the guide
+ResultMacroEval Macro_evalResultGuide( ResultPendingElem resultElem )
 {
 	// Lookup ResultMacro
 	const ResultMacro *macro = &ResultMacroList[ resultElem.index ];
-	ResultMacroRecord *record = &ResultMacroRecordList[ resultElem.index ];
+	ResultMacroRecord *record = &macroResultMacroRecordList[ resultElem.index ];
 
 	// Current Macro position
 	var_uint_t pos = record->pos;
@@ -110,6 +183,77 @@ ResultMacroEval Macro_evalResultMacro( ResultPendingElem resultElem )
 }
 
 
+// Evaluate/Update ResultMacro
+ResultMacroEval Macro_evalResultMacro( ResultPendingElem resultElem )
+{
+	const ResultMacroInfo *info = &macroResultMacroInfo[ resultElem.index ];
+
+	if ( ResultOpsPerMacro_define > 0 && info->firstOp != ResultOpNone )
+		return Macro_evalResultOps( resultElem, info );
+
+	return Macro_evalResultGuide( resultElem );
+}
+
+
+// Decodes a ResultMacro guide into ops
+// Left to the guide interpreter if decoding is disabled, the sequence is empty, or the op storage is full
+void Result_decodeOps( index_uint_t macro )
+{
+	const uint8_t *guide = ResultMacroList[ macro ].guide;
+	ResultMacroInfo *info = &macroResultMacroInfo[ macro ];
+
+	info->firstOp = ResultOpNone;
+	if ( ResultOpsPerMacro_define == 0 || !macroResultOpDecode || guide[ 0 ] == 0 )
+		return;
+
+	// Check the whole sequence fits
+	uint16_t ops = 0;
+	uint16_t words = 0;
+	for ( var_uint_t pos = 0; guide[ pos ] != 0; )
+	{
+		uint8_t comboLength = guide[ pos++ ];
+		for ( uint8_t result = 0; result < comboLength; result++ )
+		{
+			ResultGuide *resultGuide = (ResultGuide*)&guide[ pos ];
+			words += ( CapabilitiesList[ resultGuide->index ].argCount + 3 ) / 4;
+			ops++;
+			pos += ResultGuideSize( resultGuide );
+		}
+	}
+	if ( macroResultOpListSize + ops > ResultOpMax || macroResultOpArgsSize + words > ResultOpArgMax )
+	{
+		macroResultOpOverflow++;
+		return;
+	}
+
+	info->firstOp = macroResultOpListSize;
+
+	// Decode each capability
+	ResultOp *op = 0;
+	for ( var_uint_t pos = 0; guide[ pos ] != 0; )
+	{
+		uint8_t comboLength = guide[ pos++ ];
+		for ( uint8_t result = 0; result < comboLength; result++ )
+		{
+			ResultGuide *resultGuide = (ResultGuide*)&guide[ pos ];
+			uint8_t argCount = CapabilitiesList[ resultGuide->index ].argCount;
+
+			op = &macroResultOpList[ macroResultOpListSize++ ];
+			op->func = (void(*)(TriggerMacro*, uint8_t, uint8_t, uint8_t*))(CapabilitiesList[ resultGuide->index ].func);
+			op->args = macroResultOpArgsSize;
+			op->flags = 0;
+
+			memcpy( &macroResultOpArgs[ macroResultOpArgsSize ], &resultGuide->args, argCount );
+			macroResultOpArgsSize += ( argCount + 3 ) / 4;
+
+			pos += ResultGuideSize( resultGuide );
+		}
+		op->flags |= ResultOpComboEnd;
+	}
+	op->flags |= ResultOpMacroEnd;
+}
+
+
 void Result_add( uint32_t index )
 {
 }
@@ -119,13 +263,51 @@ void Result_setup()
 {
 	// Initialize macroResultMacroPendingList
 	macroResultMacroPendingList.size = 0;
+	memset( macroResultMacroPendingListBits, 0, sizeof( macroResultMacroPendingListBits ) );
 
 	// Initialize ResultMacro states
-	for ( var_uint_t macro = 0; macro < ResultMacroNum; macro++ )
+	for ( index_uint_t macro = 0; macro < ResultMacroNum; macro++ )
 	{
-		ResultMacroRecordList[ macro ].pos       = 0;
-		ResultMacroRecordList[ macro ].state     = 0;
-		ResultMacroRecordList[ macro ].stateType = 0;
+		macroResultMacroRecordList[ macro ].pos       = 0;
+		macroResultMacroRecordList[ macro ].state     = 0;
+		macroResultMacroRecordList[ macro ].stateType = 0;
+	}
+
+	// Decode ResultMacro metadata
+	for ( index_uint_t macro = 0; macro < ResultMacroNum; macro++ )
+	{
+		const uint8_t *guide = ResultMacroList[ macro ].guide;
+		ResultMacroInfo *info = &macroResultMacroInfo[ macro ];
+
+		info->comboCount = 0;
+
+		// Walk each combo until the 0 length terminator
+		var_uint_t pos = 0;
+		while ( guide[ pos ] != 0 )
+		{
+			uint8_t comboLength = guide[ pos++ ];
+			for ( uint8_t result = 0; result < comboLength; result++ )
+				pos += ResultGuideSize( (ResultGuide*)&guide[ pos ] );
+			info->comboCount++;
+		}
+	}
+
+	// Decode ResultMacro guides into ops
+	macroResultOpListSize = 0;
+	macroResultOpArgsSize = 0;
+	macroResultOpOverflow = 0;
+	memset( macroResultOpArgs, 0, sizeof( macroResultOpArgs ) );
+	for ( index_uint_t macro = 0; macro < ResultMacroNum; macro++ )
+	{
+		Result_decodeOps( macro );
+	}
+
+	// Still works, but the ResultMacros left over are slower to evaluate
+	if ( macroResultOpOverflow > 0 )
+	{
+		erro_msg("ResultMacros not decoded, increase ResultOpsPerMacro: ");
+		printInt16( macroResultOpOverflow );
+		print( NL );
 	}
 }
 
@@ -137,9 +319,22 @@ void Result_process()
 	index_uint_t macroResultMacroPendingListTail = 0;
 
 	// Iterate through the pending ResultMacros, processing each of them
-	for ( index_uint_t macro = 0; macro < macroResultMacroPendingList.size; macro++ )
+	index_uint_t macro = 0;
+	for ( ; macro < macroResultMacroPendingList.size; macro++ )
 	{
-		switch ( Macro_evalResultMacro( macroResultMacroPendingList.data[ macro ] ) )
+		// No room left to queue keyboard reports, the rest wait for the Output module to catch up
+		if ( !Output_usbReportReady() )
+			break;
+
+		ResultMacroEval eval = Macro_evalResultMacro( macroResultMacroPendingList.data[ macro ] );
+
+		// Continue the sequence during this processing loop while each combo's USB Codes can be queued as a separate report
+		while ( eval == ResultMacroEval_DoNothing && Output_usbCodeCommit() )
+		{
+			eval = Macro_evalResultMacro( macroResultMacroPendingList.data[ macro ] );
+		}
+
+		switch ( eval )
 		{
 		// Re-add macros to pending list
 		case ResultMacroEval_DoNothing:
@@ -150,12 +345,22 @@ void Result_process()
 			);
 			break;
 
-		// Remove Macro from Pending List, nothing to do, removing by default
+		// Remove Macro from Pending List, removing by default (just clear the membership bit)
 		case ResultMacroEval_Remove:
+			IndexBitmap_clear( macroResultMacroPendingListBits, macroResultMacroPendingList.data[ macro ].index );
 			break;
 		}
 	}
 
+	// Keep the ResultMacros not processed, in order
+	for ( ; macro < macroResultMacroPendingList.size; macro++ )
+	{
+		memcpy( &macroResultMacroPendingList.data[ macroResultMacroPendingListTail++ ],
+			&macroResultMacroPendingList.data[ macro ],
+			sizeof( ResultPendingElem )
+		);
+	}
+
 	// Update the macroResultMacroPendingListSize with the tail pointer
 	macroResultMacroPendingList.size = macroResultMacroPendingListTail;
 }
@@ -14,6 +14,7 @@
 set ( Module_SRCS
 	macro.c
 	result.c
+	timer.c
 	trigger.c
 )
 
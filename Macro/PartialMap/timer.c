@@ -0,0 +1,312 @@
+/* Copyright (C) 2017 by Jacob Alexander
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <Lib/MacroLib.h>
+
+// Project Includes
+#include <print.h>
+
+// Local Includes
+#include "timer.h"
+#include "kll.h"
+
+
+
+// ----- Defines -----
+
+// Hierarchical timer wheel, millisecond resolution
+//  * Level 0 - TimerWheelSlots slots of 1 ms
+//  * Level 1 - TimerWheelSlots slots of TimerWheelSlots ms
+//  * Deadlines beyond level 1 wait in the furthest level 1 slot, and are re-inserted each time it cascades
+// Each slot is a doubly linked list of pool entries, so linking/unlinking is O(1)
+// Timer_process only visits the slots for the elapsed milliseconds, not every armed deadline
+#define TimerWheelBits   5
+#define TimerWheelSlots  ( 1 << TimerWheelBits )
+#define TimerWheelMask   ( TimerWheelSlots - 1 )
+#define TimerWheelLevels 2
+
+// Armed deadlines kept at once, see capabilities.kll
+#if !defined(TimerPoolSize_define)
+#define TimerPoolSize_define 8
+#endif
+
+// Links are uint8_t, leaving room for TimerNone
+#if TimerPoolSize_define > 254
+#error "TimerPoolSize must be 254 or less"
+#endif
+
+// List links are stored as pool entry + 1, 0 terminates the list
+#define TimerNone 0
+
+// Slot of an unused pool entry
+#define TimerFree 0xFF
+
+
+
+// ----- Variables -----
+
+// Slot list heads, per level
+Instance uint8_t macroTimerSlots[ TimerWheelLevels ][ TimerWheelSlots ];
+
+// Deadline entries, only for armed TriggerMacros
+Instance index_uint_t macroTimerTrigger[ TimerPoolSize_define ];
+Instance uint8_t      macroTimerNext[ TimerPoolSize_define ];
+Instance uint8_t      macroTimerPrev[ TimerPoolSize_define ];
+Instance uint8_t      macroTimerSlot[ TimerPoolSize_define ]; // level * TimerWheelSlots + slot, TimerFree if unused
+Instance uint32_t     macroTimerDeadline[ TimerPoolSize_define ];
+
+Instance index_uint_t macroTimerArmedCount;
+
+// Last processed millisecond
+Instance uint32_t macroTimerNow;
+
+
+
+// ----- Protected Macro Functions -----
+
+extern void Trigger_deadline( index_uint_t triggerMacroIndex );
+
+
+
+// ----- Functions -----
+
+// Pool entry armed for a TriggerMacro
+// Returns TimerPoolSize_define if not armed
+static uint8_t Timer_find( index_uint_t triggerMacroIndex )
+{
+	// Only a handful of deadlines are armed at once
+	if ( macroTimerArmedCount == 0 )
+		return TimerPoolSize_define;
+
+	for ( uint8_t entry = 0; entry < TimerPoolSize_define; entry++ )
+	{
+		if ( macroTimerSlot[ entry ] != TimerFree && macroTimerTrigger[ entry ] == triggerMacroIndex )
+			return entry;
+	}
+
+	return TimerPoolSize_define;
+}
+
+
+// Links an entry into the slot for its deadline
+static void Timer_insert( uint8_t entry )
+{
+	uint32_t deadline = macroTimerDeadline[ entry ];
+	int32_t delta = (int32_t)( deadline - macroTimerNow );
+	uint8_t slot;
+
+	// Due this millisecond (only when cascading, before the level 0 slot is fired)
+	if ( delta <= 0 )
+	{
+		slot = macroTimerNow & TimerWheelMask;
+	}
+	// Level 0
+	else if ( delta < TimerWheelSlots )
+	{
+		slot = deadline & TimerWheelMask;
+	}
+	// Level 1
+	else if ( delta < TimerWheelSlots * TimerWheelSlots )
+	{
+		slot = TimerWheelSlots + ( ( deadline >> TimerWheelBits ) & TimerWheelMask );
+	}
+	// Beyond level 1, wait in the furthest level 1 slot
+	else
+	{
+		slot = TimerWheelSlots + ( ( ( macroTimerNow >> TimerWheelBits ) - 1 ) & TimerWheelMask );
+	}
+
+	// Push to the front of the slot list
+	uint8_t *head = &macroTimerSlots[ slot >> TimerWheelBits ][ slot & TimerWheelMask ];
+	macroTimerSlot[ entry ] = slot;
+	macroTimerPrev[ entry ] = TimerNone;
+	macroTimerNext[ entry ] = *head;
+	if ( *head != TimerNone )
+	{
+		macroTimerPrev[ *head - 1 ] = entry + 1;
+	}
+	*head = entry + 1;
+}
+
+
+// Unlinks an entry from its slot
+static void Timer_unlink( uint8_t entry )
+{
+	uint8_t slot = macroTimerSlot[ entry ];
+	uint8_t prev = macroTimerPrev[ entry ];
+	uint8_t next = macroTimerNext[ entry ];
+
+	if ( prev != TimerNone )
+	{
+		macroTimerNext[ prev - 1 ] = next;
+	}
+	else
+	{
+		macroTimerSlots[ slot >> TimerWheelBits ][ slot & TimerWheelMask ] = next;
+	}
+
+	if ( next != TimerNone )
+	{
+		macroTimerPrev[ next - 1 ] = prev;
+	}
+}
+
+
+// Unlinks an entry and returns it to the pool
+static void Timer_release( uint8_t entry )
+{
+	Timer_unlink( entry );
+	macroTimerSlot[ entry ] = TimerFree;
+	macroTimerArmedCount--;
+}
+
+
+void Timer_set( index_uint_t triggerMacroIndex, Time deadline )
+{
+	uint8_t entry = Timer_find( triggerMacroIndex );
+
+	// Re-arm
+	if ( entry < TimerPoolSize_define )
+	{
+		Timer_unlink( entry );
+	}
+	else
+	{
+		// Nothing armed, Timer_process may not have been called during idle processing loops
+		if ( macroTimerArmedCount == 0 )
+		{
+			macroTimerNow = Time_now().ms;
+		}
+
+		// Take a free entry
+		for ( entry = 0; entry < TimerPoolSize_define; entry++ )
+		{
+			if ( macroTimerSlot[ entry ] == TimerFree )
+				break;
+		}
+
+		// Pool full, the TriggerMacro is only re-evaluated on its next event
+		if ( entry == TimerPoolSize_define )
+		{
+			warn_msg("Timer pool full, increase TimerPoolSize: ");
+			printInt16( (uint16_t)triggerMacroIndex );
+			print( NL );
+			return;
+		}
+
+		macroTimerTrigger[ entry ] = triggerMacroIndex;
+		macroTimerArmedCount++;
+	}
+
+	// Deadlines have ms resolution, matching Time_duration_ms
+	// Ticks are a free running counter (ARM cycle counter, ns on the host), not an offset into the ms, so they are ignored
+	uint32_t ms = deadline.ms;
+
+	// Current millisecond has already been processed, already due deadlines fire on the next one
+	if ( (int32_t)( ms - macroTimerNow ) <= 0 )
+	{
+		ms = macroTimerNow + 1;
+	}
+
+	macroTimerDeadline[ entry ] = ms;
+	Timer_insert( entry );
+}
+
+
+void Timer_cancel( index_uint_t triggerMacroIndex )
+{
+	uint8_t entry = Timer_find( triggerMacroIndex );
+	if ( entry == TimerPoolSize_define )
+		return;
+
+	Timer_release( entry );
+}
+
+
+uint8_t Timer_armed( index_uint_t triggerMacroIndex )
+{
+	return Timer_find( triggerMacroIndex ) < TimerPoolSize_define ? 1 : 0;
+}
+
+
+index_uint_t Timer_count()
+{
+	return macroTimerArmedCount;
+}
+
+
+void Timer_process( Time now )
+{
+	// Nothing armed, just keep up with the clock
+	if ( macroTimerArmedCount == 0 )
+	{
+		macroTimerNow = now.ms;
+		return;
+	}
+
+	// Visit each elapsed millisecond
+	while ( (int32_t)( now.ms - macroTimerNow ) > 0 )
+	{
+		macroTimerNow++;
+
+		// Cascade the next level 1 slot down, once per level 0 revolution
+		if ( ( macroTimerNow & TimerWheelMask ) == 0 )
+		{
+			uint8_t *head = &macroTimerSlots[ 1 ][ ( macroTimerNow >> TimerWheelBits ) & TimerWheelMask ];
+			uint8_t entry = *head;
+			*head = TimerNone;
+
+			while ( entry != TimerNone )
+			{
+				uint8_t next = macroTimerNext[ entry - 1 ];
+				Timer_insert( entry - 1 );
+				entry = next;
+			}
+		}
+
+		// Fire the level 0 slot
+		uint8_t *head = &macroTimerSlots[ 0 ][ macroTimerNow & TimerWheelMask ];
+		while ( *head != TimerNone )
+		{
+			uint8_t entry = *head - 1;
+			index_uint_t triggerMacroIndex = macroTimerTrigger[ entry ];
+
+			Timer_release( entry );
+
+			Trigger_deadline( triggerMacroIndex );
+		}
+
+		// Stop early once nothing is left armed
+		if ( macroTimerArmedCount == 0 )
+		{
+			macroTimerNow = now.ms;
+			break;
+		}
+	}
+}
+
+
+void Timer_setup()
+{
+	memset( macroTimerSlots, 0, sizeof( macroTimerSlots ) );
+	memset( macroTimerSlot, TimerFree, sizeof( macroTimerSlot ) );
+	macroTimerArmedCount = 0;
+	macroTimerNow = Time_now().ms;
+}
+
@@ -0,0 +1,52 @@
+/* Copyright (C) 2017 by Jacob Alexander
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <stdint.h>
+
+// Project Includes
+#include <Lib/time.h>
+
+// Local Includes
+#include "kll.h"
+
+
+
+// ----- Functions -----
+
+// Arms (or re-arms) the deadline of a TriggerMacro
+// The TriggerMacro is re-evaluated by Trigger_process once the deadline has passed
+// Deadlines have ms resolution, deadline.ticks is ignored
+// Not armed (with a warning) if TimerPoolSize deadlines are already armed
+void Timer_set( index_uint_t triggerMacroIndex, Time deadline );
+
+// Disarms the deadline of a TriggerMacro, ignored if not armed
+void Timer_cancel( index_uint_t triggerMacroIndex );
+
+// Returns non-zero if the TriggerMacro has an armed deadline
+uint8_t Timer_armed( index_uint_t triggerMacroIndex );
+
+// Number of armed deadlines
+index_uint_t Timer_count();
+
+// Fires all deadlines up to and including now
+void Timer_process( Time now );
+void Timer_setup();
+
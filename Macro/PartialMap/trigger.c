@@ -24,11 +24,21 @@
 #include <print.h>
 
 // Local Includes
+#include "timer.h"
 #include "trigger.h"
 #include "kll.h"
 
 
 
+// ----- Defines -----
+
+// Long TriggerMacros kept in the prefix trie, none by default (see Trigger_buildLongTrie)
+#if !defined(LongTriggerMacroMax_define)
+#define LongTriggerMacroMax_define 0
+#endif
+
+
+
 // ----- Enums -----
 
 // Bit positions are important, passes (correct key) always trump incorrect key votes
@@ -56,7 +66,6 @@ typedef enum TriggerMacroEval {
 extern const Capability CapabilitiesList[];
 
 extern const TriggerMacro TriggerMacroList[];
-extern TriggerMacroRecord TriggerMacroRecordList[];
 
 extern const ResultMacro ResultMacroList[];
 
@@ -65,12 +74,12 @@ extern const ResultMacro ResultMacroList[];
 // ----- Variables -----
 
 // Incoming Trigger Event Buffer
-extern TriggerEvent macroTriggerEventBuffer[];
-extern var_uint_t macroTriggerEventBufferSize;
-extern var_uint_t macroTriggerEventLayerCache[];
+extern Instance TriggerEvent macroTriggerEventBuffer[];
+extern Instance var_uint_t macroTriggerEventBufferSize;
+extern Instance var_uint_t macroTriggerEventLayerCache[];
 
 // Debug Variables
-extern uint8_t voteDebugMode;
+extern Instance uint8_t voteDebugMode;
 
 // Pending Trigger Macro Index List
 //  * Any trigger macros that need processing from a previous macro processing loop
@@ -81,17 +90,86 @@ extern uint8_t voteDebugMode;
 #undef TriggerMacroNum
 #define TriggerMacroNum 1
 #endif
-index_uint_t macroTriggerMacroPendingList[ TriggerMacroNum ] = { 0 };
-index_uint_t macroTriggerMacroPendingListSize = 0;
+Instance index_uint_t macroTriggerMacroPendingList[ TriggerMacroNum ] = { 0 };
+Instance index_uint_t macroTriggerMacroPendingListSize = 0;
+
+// TriggerMacro states, per instance copy of the kll generated TriggerMacroRecordList on the host (see kll.h)
+#if defined(_host_)
+Instance TriggerMacroRecord macroTriggerMacroRecordList[ TriggerMacroNum ];
+#endif
+
+// Pending Trigger Macro membership bitmap
+//  * Bit is set for each trigger macro index in macroTriggerMacroPendingList
+Instance uint8_t macroTriggerMacroPendingListBits[ IndexBitmapSize( TriggerMacroNum ) ] = { 0 };
+
+// Deadline fired bitmap
+//  * Bit is set for each trigger macro whose Timer_set deadline fired during this Trigger_process
+//  * Kept until the next Trigger_process, so ResultMacro capabilities can also check it
+Instance uint8_t macroTriggerMacroDeadlineBits[ IndexBitmapSize( TriggerMacroNum ) ] = { 0 };
+Instance uint8_t macroTriggerMacroDeadlineFired = 0;
+
+// Trigger Event Lookup
+//  * Indexed by ScanCode (Switch banks 1-4), rebuilt from macroTriggerEventBuffer each Trigger_process
+//  * Holds the state of the first event for each ScanCode, 0x00 if there was no event this cycle
+//  * Voting is then a single lookup per TriggerGuide, rather than a scan of the whole event buffer
+Instance uint8_t macroTriggerEventLookup[ MaxScanCode + 1 ];
+
+// Held key set
+//  * Bit is set for each ScanCode (Switch banks 1-4) between its Press and Release events
+//  * Scan modules only need to send Press/Release, keys without an event this cycle are voted as Hold
+//  * Hold is only synthesized for TriggerMacros that vote on the key, events per cycle are O(changes)
+Instance uint8_t    macroTriggerHeldBits[ IndexBitmapSize( MaxScanCode + 1 ) ];
+Instance var_uint_t macroTriggerHeldSize;
+
+// TriggerMacro metadata
+//  * Decoded from each TriggerMacro guide during Trigger_setup, guides are constant
+Instance TriggerMacroInfo macroTriggerMacroInfo[ TriggerMacroNum ];
+
+// Long TriggerMacro prefix trie
+//  * Long TriggerMacros (more than 1 combo) sorted by guide during Trigger_setup
+//  * TriggerMacros sharing a guide prefix are adjacent, so every trie node is a range of the sorted list
+//  * macroTriggerLongPrefix is the number of guide bytes shared with the previous TriggerMacro in the sorted list
+//  * Sized by LongTriggerMacroMax, long TriggerMacros left over are evaluated on their own (previous matcher)
+Instance index_uint_t macroTriggerLongList[ LongTriggerMacroMax_define ];
+Instance var_uint_t   macroTriggerLongPrefix[ LongTriggerMacroMax_define ];
+Instance index_uint_t macroTriggerLongIndex[ LongTriggerMacroMax_define ]; // TriggerMacro index of each entry, ascending
+Instance index_uint_t macroTriggerLongRank[ LongTriggerMacroMax_define ];  // Sorted list position, in macroTriggerLongIndex order
+Instance index_uint_t macroTriggerLongListSize;
+
+// Pending long TriggerMacro cursors
+//  * Instead of a record per pending long TriggerMacro, each trie node being followed is voted on once
+//  * A cursor only splits where the TriggerMacros in it continue with different combos
+//  * Pending long TriggerMacros are also set in macroTriggerMacroPendingListBits
+Instance TriggerCursor macroTriggerCursorList[ LongTriggerMacroMax_define ];
+Instance index_uint_t  macroTriggerCursorListSize = 0;
+Instance index_uint_t  macroTriggerCursorListTail;
+Instance index_uint_t  macroTriggerCursorListPos;
+
+// Follow pending long TriggerMacros with the prefix trie cursors
+//  * When 0, each long TriggerMacro is kept in the pending list and evaluated on its own (previous matcher)
+//  * Only change while nothing is pending, the host tests use it to compare both matchers
+Instance uint8_t macroTriggerLongTrie = 1;
+
+// Sorted positions of long TriggerMacros added to the pending list this processing loop
+Instance uint8_t macroTriggerLongNewBits[ IndexBitmapSize( LongTriggerMacroMax_define ) ];
+
+// Vote given to a long macro TriggerGuide when no event matched it this cycle
+// Every event in the buffer is a "wrong key" in this case, so the vote is the same for all guides
+Instance TriggerMacroVote macroTriggerEventMissVote;
 
 
 
 // ----- Protected Macro Functions -----
 
+extern Instance ResultMacroInfo macroResultMacroInfo[];
+
 extern nat_ptr_t *Macro_layerLookup( TriggerEvent *event, uint8_t latch_expire );
 
 extern void Macro_appendResultMacroToPendingList( const TriggerMacro *triggerMacro );
 
+extern Instance uint8_t macroChordActiveSize;
+extern uint8_t Macro_chordAllows( TriggerEvent *event, index_uint_t triggerMacroIndex );
+
 
 
 // ----- Functions -----
@@ -148,27 +226,229 @@ void Trigger_showTriggerMacroVote( TriggerMacroVote vote )
 // Determine if long ResultMacro (more than 1 seqence element)
 uint8_t Macro_isLongResultMacro( const ResultMacro *macro )
 {
-	// Check the second sequence combo length
-	// If non-zero return non-zero (long sequence)
-	// 0 otherwise (short sequence)
-	var_uint_t position = 1;
-	for ( var_uint_t result = 0; result < macro->guide[0]; result++ )
-		position += ResultGuideSize( (ResultGuide*)&macro->guide[ position ] );
-	return macro->guide[ position ];
+	return macroResultMacroInfo[ macro - ResultMacroList ].comboCount > 1;
 }
 
 
 // Determine if long TriggerMacro (more than 1 sequence element)
 uint8_t Trigger_isLongTriggerMacro( const TriggerMacro *macro )
 {
-	// Check the second sequence combo length
-	// If non-zero return non-zero (long sequence)
-	// 0 otherwise (short sequence)
-	return macro->guide[ macro->guide[0] * TriggerGuideSize + 1 ];
+	return macroTriggerMacroInfo[ macro - TriggerMacroList ].comboCount > 1;
+}
+
+
+// Lookup the decoded metadata of a TriggerMacro
+// Returns 0 if the TriggerMacro is not in TriggerMacroList
+const TriggerMacroInfo *Trigger_triggerMacroInfo( const TriggerMacro *macro )
+{
+	if ( macro < TriggerMacroList || macro >= TriggerMacroList + TriggerMacroNum_KLL )
+		return 0;
+
+	return &macroTriggerMacroInfo[ macro - TriggerMacroList ];
+}
+
+
+// Votes on the state of a key that matches the guide (short and long macros)
+TriggerMacroVote Trigger_evalMatchVote( ScheduleState state )
+{
+	switch ( state )
+	{
+	// Correct key, pressed, possible passing
+	case ScheduleType_P:
+		return TriggerMacroVote_Pass;
+
+	// Correct key, held, possible passing or release
+	case ScheduleType_H:
+		return TriggerMacroVote_PassRelease;
+
+	// Correct key, released, possible release
+	case ScheduleType_R:
+		return TriggerMacroVote_Release;
+
+	// Invalid state, fail
+	default:
+		return TriggerMacroVote_Fail;
+	}
+}
+
+
+// Votes on the state of a key that does not match the guide, long macros
+TriggerMacroVote Trigger_evalLongMissVote( ScheduleState state )
+{
+	switch ( state )
+	{
+	// Wrong key, pressed, fail
+	case ScheduleType_P:
+		return TriggerMacroVote_Fail;
+
+	// Wrong key, held, do not pass (no effect)
+	case ScheduleType_H:
+		return TriggerMacroVote_DoNothing;
+
+	// Wrong key released, fail out if pos == 0
+	case ScheduleType_R:
+		return TriggerMacroVote_DoNothing | TriggerMacroVote_DoNothingRelease;
+
+	// Invalid state, fail
+	default:
+		return TriggerMacroVote_Fail;
+	}
+}
+
+
+// Converts a TriggerGuide/TriggerEvent type and index into a ScanCode
+// Returns 0xFFFF if not a Switch type, or if the ScanCode is out of range
+uint16_t Trigger_switchScanCode( uint8_t type, uint8_t index )
+{
+	// Only Switch banks are indexed
+	if ( type > TriggerType_Switch4 )
+		return 0xFFFF;
+
+	// Each bank is 256 ScanCodes wide
+	uint16_t scanCode = (uint16_t)type * 256 + index;
+	if ( scanCode > MaxScanCode )
+		return 0xFFFF;
+
+	return scanCode;
+}
+
+
+// Builds the ScanCode -> state lookup from macroTriggerEventBuffer
+// Must be paired with Trigger_clearEventLookup once the events have been processed
+void Trigger_buildEventLookup()
+{
+	macroTriggerEventMissVote = TriggerMacroVote_Invalid;
+
+	for ( var_uint_t key = 0; key < macroTriggerEventBufferSize; key++ )
+	{
+		TriggerEvent *event = &macroTriggerEventBuffer[ key ];
+
+		// Accumulate the vote for guides that no event matches
+		macroTriggerEventMissVote |= Trigger_evalLongMissVote( event->state );
+
+		uint16_t scanCode = Trigger_switchScanCode( event->type, event->index );
+		if ( scanCode == 0xFFFF )
+			continue;
+
+		// Only the first event for each ScanCode is used
+		if ( macroTriggerEventLookup[ scanCode ] == 0x00 )
+		{
+			macroTriggerEventLookup[ scanCode ] = event->state;
+		}
+
+		// Update the held key set, every event is applied in order
+		switch ( event->state )
+		{
+		case ScheduleType_P:
+			if ( !IndexBitmap_test( macroTriggerHeldBits, scanCode ) )
+			{
+				IndexBitmap_set( macroTriggerHeldBits, scanCode );
+				macroTriggerHeldSize++;
+			}
+			break;
+
+		case ScheduleType_R:
+			if ( IndexBitmap_test( macroTriggerHeldBits, scanCode ) )
+			{
+				IndexBitmap_clear( macroTriggerHeldBits, scanCode );
+				macroTriggerHeldSize--;
+			}
+			break;
+
+		// Hold events do not change the set
+		default:
+			break;
+		}
+	}
+
+	// Held keys without an event are wrong keys held, as if a Hold event was sent
+	if ( macroTriggerHeldSize > 0 )
+	{
+		macroTriggerEventMissVote |= Trigger_evalLongMissVote( ScheduleType_H );
+	}
+}
+
+
+// State of a ScanCode during this processing loop
+// Keys held without an event are synthesized as Hold, 0x00 if there is no event and the key is not held
+uint8_t Trigger_switchState( uint16_t scanCode )
+{
+	uint8_t state = macroTriggerEventLookup[ scanCode ];
+	if ( state == 0x00 && IndexBitmap_test( macroTriggerHeldBits, scanCode ) )
+		return ScheduleType_H;
+
+	return state;
+}
+
+
+// Returns 1 if a short TriggerMacro only uses Switch keys, and they are all still held
+// Such TriggerMacros stay pending, as they would be re-added by the Hold event of each key
+uint8_t Trigger_shortHeld( index_uint_t triggerMacroIndex )
+{
+	if ( macroTriggerMacroInfo[ triggerMacroIndex ].comboCount != 1 )
+		return 0;
+
+	const uint8_t *guide = TriggerMacroList[ triggerMacroIndex ].guide;
+	for ( uint8_t item = 0; item < guide[ 0 ]; item++ )
+	{
+		TriggerGuide *comboGuide = (TriggerGuide*)&guide[ 1 + item * TriggerGuideSize ];
+		uint16_t scanCode = Trigger_switchScanCode( comboGuide->type, comboGuide->scanCode );
+		if ( scanCode == 0xFFFF || !IndexBitmap_test( macroTriggerHeldBits, scanCode ) )
+			return 0;
+	}
+
+	return 1;
+}
+
+
+// Clears the held key set, adding a Release event for each key that was held
+// Returns the number of events added to events (at most max)
+// Used when a Release may have been lost, so no key stays held (see Macro_clearPending)
+var_uint_t Trigger_releaseHeld( TriggerEvent *events, var_uint_t max )
+{
+	var_uint_t count = 0;
+	for ( uint16_t scanCode = 0; scanCode <= MaxScanCode && macroTriggerHeldSize > 0; scanCode++ )
+	{
+		if ( !IndexBitmap_test( macroTriggerHeldBits, scanCode ) )
+			continue;
+
+		IndexBitmap_clear( macroTriggerHeldBits, scanCode );
+		macroTriggerHeldSize--;
+
+		if ( count < max )
+		{
+			events[ count ].type  = TriggerType_Switch1 + ( scanCode >> 8 );
+			events[ count ].state = ScheduleType_R;
+			events[ count ].index = scanCode & 0xFF;
+			events[ count ].time  = Time_now().ms;
+			count++;
+		}
+	}
+
+	return count;
+}
+
+
+// Clears the ScanCode -> state lookup
+// Only the entries set by the current macroTriggerEventBuffer are touched
+void Trigger_clearEventLookup()
+{
+	for ( var_uint_t key = 0; key < macroTriggerEventBufferSize; key++ )
+	{
+		uint16_t scanCode = Trigger_switchScanCode(
+			macroTriggerEventBuffer[ key ].type,
+			macroTriggerEventBuffer[ key ].index
+		);
+		if ( scanCode != 0xFFFF )
+		{
+			macroTriggerEventLookup[ scanCode ] = 0x00;
+		}
+	}
 }
 
 
 // Votes on the given key vs. guide, short macros
+// NOTE: Switch guides are voted using macroTriggerEventLookup (see Trigger_evalTriggerMacro)
 TriggerMacroVote Trigger_evalShortTriggerMacroVote( TriggerEvent *event, TriggerGuide *guide )
 {
 	// Depending on key type
@@ -179,24 +459,7 @@ TriggerMacroVote Trigger_evalShortTriggerMacroVote( TriggerEvent *event, Trigger
 		// For short TriggerMacros completely ignore incorrect keys
 		if ( guide->scanCode == event->index )
 		{
-			switch ( event->state )
-			{
-			// Correct key, pressed, possible passing
-			case ScheduleType_P:
-				return TriggerMacroVote_Pass;
-
-			// Correct key, held, possible passing or release
-			case ScheduleType_H:
-				return TriggerMacroVote_PassRelease;
-
-			// Correct key, released, possible release
-			case ScheduleType_R:
-				return TriggerMacroVote_Release;
-
-			// Invalid state, fail
-			default:
-				return TriggerMacroVote_Fail;
-			}
+			return Trigger_evalMatchVote( event->state );
 		}
 
 		return TriggerMacroVote_DoNothing;
@@ -234,6 +497,7 @@ TriggerMacroVote Trigger_evalShortTriggerMacroVote( TriggerEvent *event, Trigger
 
 // Votes on the given key vs. guide, long macros
 // A long macro is defined as a guide with more than 1 combo
+// NOTE: Switch guides are voted using macroTriggerEventLookup (see Trigger_evalTriggerMacro)
 TriggerMacroVote Trigger_evalLongTriggerMacroVote( TriggerEvent *event, TriggerGuide *guide )
 {
 	// Depending on key type
@@ -245,50 +509,11 @@ TriggerMacroVote Trigger_evalLongTriggerMacroVote( TriggerEvent *event, TriggerG
 		// Incorrect key
 		if ( guide->scanCode != event->index )
 		{
-			switch ( event->state )
-			{
-			// Wrong key, pressed, fail
-			case ScheduleType_P:
-				return TriggerMacroVote_Fail;
-
-			// Wrong key, held, do not pass (no effect)
-			case ScheduleType_H:
-				return TriggerMacroVote_DoNothing;
-
-			// Wrong key released, fail out if pos == 0
-			case ScheduleType_R:
-				return TriggerMacroVote_DoNothing | TriggerMacroVote_DoNothingRelease;
-
-			// Invalid state, fail
-			default:
-				return TriggerMacroVote_Fail;
-			}
+			return Trigger_evalLongMissVote( event->state );
 		}
 
 		// Correct key
-		else
-		{
-			switch ( event->state )
-			{
-			// Correct key, pressed, possible passing
-			case ScheduleType_P:
-				return TriggerMacroVote_Pass;
-
-			// Correct key, held, possible passing or release
-			case ScheduleType_H:
-				return TriggerMacroVote_PassRelease;
-
-			// Correct key, released, possible release
-			case ScheduleType_R:
-				return TriggerMacroVote_Release;
-
-			// Invalid state, fail
-			default:
-				return TriggerMacroVote_Fail;
-			}
-		}
-
-		break;
+		return Trigger_evalMatchVote( event->state );
 
 	// LED State Type
 	case TriggerType_LED1:
@@ -321,35 +546,9 @@ TriggerMacroVote Trigger_evalLongTriggerMacroVote( TriggerEvent *event, TriggerG
 }
 
 
-// Evaluate/Update TriggerMacro
-TriggerMacroEval Trigger_evalTriggerMacro( var_uint_t triggerMacroIndex )
+// Votes on the combo at pos of a TriggerMacro guide, using the events of this processing loop
+TriggerMacroVote Trigger_voteCombo( const uint8_t *comboGuide, var_uint_t pos, uint8_t longMacro )
 {
-	// Lookup TriggerMacro
-	const TriggerMacro *macro = &TriggerMacroList[ triggerMacroIndex ];
-	TriggerMacroRecord *record = &TriggerMacroRecordList[ triggerMacroIndex ];
-
-	// Check if macro has finished and should be incremented sequence elements
-	if ( record->state == TriggerMacro_Release )
-	{
-		record->state = TriggerMacro_Waiting;
-		record->pos = record->pos + macro->guide[ record->pos ] * TriggerGuideSize + 1;
-	}
-
-	// Current Macro position
-	var_uint_t pos = record->pos;
-
-	// Length of the combo being processed
-	uint8_t comboLength = macro->guide[ pos ] * TriggerGuideSize;
-
-	// If no combo items are left, remove the TriggerMacro from the pending list
-	if ( comboLength == 0 )
-	{
-		return TriggerMacroEval_Remove;
-	}
-
-	// Check if this is a long Trigger Macro
-	uint8_t longMacro = Trigger_isLongTriggerMacro( macro );
-
 	// Iterate through the items in the combo, voting the on the key state
 	// If any of the pressed keys do not match, fail the macro
 	//
@@ -362,14 +561,37 @@ TriggerMacroEval Trigger_evalTriggerMacro( var_uint_t triggerMacroIndex )
 	// TODO Add support for 0x00 Key state (not pressing a key, not all that useful in general)
 	// TODO Add support for Press/Hold/Release differentiation when evaluating (not sure if useful)
 	TriggerMacroVote overallVote = TriggerMacroVote_Invalid;
+	uint8_t comboLength = comboGuide[ pos ] * TriggerGuideSize;
 	for ( uint8_t comboItem = pos + 1; comboItem < pos + comboLength + 1; comboItem += TriggerGuideSize )
 	{
 		// Assign TriggerGuide element (key type, state and scancode)
-		TriggerGuide *guide = (TriggerGuide*)(&macro->guide[ comboItem ]);
+		TriggerGuide *guide = (TriggerGuide*)(&comboGuide[ comboItem ]);
 
 		TriggerMacroVote vote = TriggerMacroVote_Invalid;
+
+		// Switch types are voted using the event lookup
+		uint16_t scanCode = Trigger_switchScanCode( guide->type, guide->scanCode );
+		if ( scanCode != 0xFFFF )
+		{
+			// Correct key, vote on the key state (Hold if held without an event this cycle)
+			// Otherwise, each key in the buffer is an incorrect key
+			// Short macros ignore incorrect keys (failing below if there are no passes)
+			uint8_t state = Trigger_switchState( scanCode );
+			if ( state != 0x00 )
+			{
+				vote = Trigger_evalMatchVote( state );
+			}
+			else if ( longMacro )
+			{
+				vote = macroTriggerEventMissVote;
+			}
+			else if ( macroTriggerEventBufferSize > 0 )
+			{
+				vote = TriggerMacroVote_DoNothing;
+			}
+		}
 		// Iterate through the key buffer, comparing to each key in the combo
-		for ( var_uint_t key = 0; key < macroTriggerEventBufferSize; key++ )
+		else for ( var_uint_t key = 0; key < macroTriggerEventBufferSize; key++ )
 		{
 			// Lookup key information
 			TriggerEvent *triggerInfo = &macroTriggerEventBuffer[ key ];
@@ -409,6 +631,42 @@ TriggerMacroEval Trigger_evalTriggerMacro( var_uint_t triggerMacroIndex )
 		break;
 	}
 
+	return overallVote;
+}
+
+
+// Evaluate/Update TriggerMacro
+TriggerMacroEval Trigger_evalTriggerMacro( index_uint_t triggerMacroIndex )
+{
+	// Lookup TriggerMacro
+	const TriggerMacro *macro = &TriggerMacroList[ triggerMacroIndex ];
+	const TriggerMacroInfo *info = &macroTriggerMacroInfo[ triggerMacroIndex ];
+	TriggerMacroRecord *record = &macroTriggerMacroRecordList[ triggerMacroIndex ];
+
+	// Check if macro has finished and should be incremented sequence elements
+	if ( record->state == TriggerMacro_Release )
+	{
+		record->state = TriggerMacro_Waiting;
+		record->pos = record->pos + macro->guide[ record->pos ] * TriggerGuideSize + 1;
+	}
+
+	// Current Macro position
+	var_uint_t pos = record->pos;
+
+	// Length of the combo being processed
+	uint8_t comboLength = macro->guide[ pos ] * TriggerGuideSize;
+
+	// If no combo items are left, remove the TriggerMacro from the pending list
+	if ( comboLength == 0 )
+	{
+		return TriggerMacroEval_Remove;
+	}
+
+	// Check if this is a long Trigger Macro
+	uint8_t longMacro = info->comboCount > 1;
+
+	TriggerMacroVote overallVote = Trigger_voteCombo( macro->guide, pos, longMacro );
+
 	// Decide new state of macro after voting
 	// Fail macro, remove from pending list
 	if ( overallVote & TriggerMacroVote_Fail )
@@ -427,7 +685,7 @@ TriggerMacroEval Trigger_evalTriggerMacro( var_uint_t triggerMacroIndex )
 		record->state = TriggerMacro_Release;
 
 		// If this is the last combo in the sequence, remove from the pending list
-		if ( macro->guide[ record->pos + macro->guide[ record->pos ] * TriggerGuideSize + 1 ] == 0 )
+		if ( pos == info->lastComboPos )
 			return TriggerMacroEval_DoResultAndRemove;
 	}
 	// If passing and in Waiting state, set macro state to Press
@@ -440,10 +698,10 @@ TriggerMacroEval Trigger_evalTriggerMacro( var_uint_t triggerMacroIndex )
 		// Check to see if the result macro only has a single element
 		// If this result macro has more than 1 key, only send once
 		// TODO Add option to have long macro repeat rate
-		if ( macro->guide[ pos + comboLength + 1 ] == 0 )
+		if ( pos == info->lastComboPos )
 		{
 			// Long result macro (more than 1 combo)
-			if ( Macro_isLongResultMacro( &ResultMacroList[ macro->result ] ) )
+			if ( macroResultMacroInfo[ macro->result ].comboCount > 1 )
 			{
 				// Only ever trigger result once, on press
 				if ( overallVote == TriggerMacroVote_Pass )
@@ -455,7 +713,7 @@ TriggerMacroEval Trigger_evalTriggerMacro( var_uint_t triggerMacroIndex )
 			else
 			{
 				// Only trigger result once, on press, if long trigger (more than 1 combo)
-				if ( Trigger_isLongTriggerMacro( macro ) )
+				if ( longMacro )
 				{
 					return TriggerMacroEval_DoResultAndRemove;
 				}
@@ -483,9 +741,303 @@ TriggerMacroEval Trigger_evalTriggerMacro( var_uint_t triggerMacroIndex )
 }
 
 
+// -- Long TriggerMacro Prefix Trie --
+
+// Compares two TriggerMacro guides, combo by combo
+// Returns -1, 0 or 1, a finished guide sorts first
+// shared is set to the number of identical leading guide bytes
+int8_t Trigger_compareGuide( const uint8_t *a, const uint8_t *b, var_uint_t *shared )
+{
+	var_uint_t pos = 0;
+	while ( 1 )
+	{
+		// Combo length, then each TriggerGuide of the combo
+		var_uint_t end = pos + a[ pos ] * TriggerGuideSize + 1;
+		for ( var_uint_t byte = pos; byte < end; byte++ )
+		{
+			if ( a[ byte ] != b[ byte ] )
+			{
+				*shared = byte;
+				return a[ byte ] < b[ byte ] ? -1 : 1;
+			}
+		}
+
+		// Identical guides, including the terminator
+		if ( a[ pos ] == 0 )
+		{
+			*shared = end;
+			return 0;
+		}
+
+		pos = end;
+	}
+}
+
+
+// Position of a TriggerMacro in macroTriggerLongIndex
+// Returns macroTriggerLongListSize if the TriggerMacro is not in the prefix trie
+index_uint_t Trigger_longSlot( index_uint_t triggerMacroIndex )
+{
+	// Binary search, macroTriggerLongIndex is ascending
+	index_uint_t low = 0;
+	index_uint_t high = macroTriggerLongListSize;
+	while ( low < high )
+	{
+		index_uint_t mid = low + ( high - low ) / 2;
+		if ( macroTriggerLongIndex[ mid ] < triggerMacroIndex )
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if ( low < macroTriggerLongListSize && macroTriggerLongIndex[ low ] == triggerMacroIndex )
+		return low;
+
+	return macroTriggerLongListSize;
+}
+
+
+// Sorts the long TriggerMacros by guide, building the prefix trie
+void Trigger_buildLongTrie()
+{
+	macroTriggerLongListSize = 0;
+	index_uint_t overflow = 0;
+
+	// Insertion sort, only done once
+	for ( index_uint_t macro = 0; macro < TriggerMacroNum_KLL; macro++ )
+	{
+		if ( macroTriggerMacroInfo[ macro ].comboCount < 2 )
+			continue;
+
+		// No room, evaluated on its own
+		if ( macroTriggerLongListSize >= LongTriggerMacroMax_define )
+		{
+			overflow++;
+			continue;
+		}
+
+		const uint8_t *guide = TriggerMacroList[ macro ].guide;
+		var_uint_t shared;
+		macroTriggerLongIndex[ macroTriggerLongListSize ] = macro;
+		index_uint_t pos = macroTriggerLongListSize++;
+		while ( pos > 0 && Trigger_compareGuide( guide, TriggerMacroList[ macroTriggerLongList[ pos - 1 ] ].guide, &shared ) < 0 )
+		{
+			macroTriggerLongList[ pos ] = macroTriggerLongList[ pos - 1 ];
+			pos--;
+		}
+		macroTriggerLongList[ pos ] = macro;
+	}
+
+	// Record the sorted position and shared prefix of each long TriggerMacro
+	for ( index_uint_t pos = 0; pos < macroTriggerLongListSize; pos++ )
+	{
+		index_uint_t macro = macroTriggerLongList[ pos ];
+		macroTriggerLongRank[ Trigger_longSlot( macro ) ] = pos;
+		macroTriggerLongPrefix[ pos ] = 0;
+
+		if ( pos > 0 )
+		{
+			Trigger_compareGuide(
+				TriggerMacroList[ macro ].guide,
+				TriggerMacroList[ macroTriggerLongList[ pos - 1 ] ].guide,
+				&macroTriggerLongPrefix[ pos ]
+			);
+		}
+	}
+
+	// Still works, but the long TriggerMacros left over are slower to evaluate
+	// LongTriggerMacroMax of 0 disables the trie
+	if ( overflow > 0 && LongTriggerMacroMax_define > 0 )
+	{
+		erro_msg("Long TriggerMacros not in the prefix trie, increase LongTriggerMacroMax: ");
+		printInt16( overflow );
+		print( NL );
+	}
+}
+
+
+// Adds a cursor to the end of the cursor list
+void Trigger_appendCursor( index_uint_t first, index_uint_t count )
+{
+	macroTriggerCursorList[ macroTriggerCursorListSize ].first = first;
+	macroTriggerCursorList[ macroTriggerCursorListSize ].count = count;
+	macroTriggerCursorListSize++;
+}
+
+
+// Keeps a cursor for the next processing loop, only while iterating over the cursor list
+// Slots up to the cursor being evaluated are re-used, any further splits are appended
+void Trigger_keepCursor( index_uint_t first, index_uint_t count, var_uint_t pos, TriggerMacroState state )
+{
+	TriggerMacroRecord *record = &macroTriggerMacroRecordList[ macroTriggerLongList[ first ] ];
+	record->pos   = pos;
+	record->state = state;
+
+	if ( macroTriggerCursorListTail <= macroTriggerCursorListPos )
+	{
+		macroTriggerCursorList[ macroTriggerCursorListTail ].first = first;
+		macroTriggerCursorList[ macroTriggerCursorListTail ].count = count;
+		macroTriggerCursorListTail++;
+		return;
+	}
+
+	Trigger_appendCursor( first, count );
+}
+
+
+// Removes a range of the sorted long TriggerMacros from the pending list
+// If result is set, the ResultMacro of each is triggered
+void Trigger_removeLong( index_uint_t first, index_uint_t count, uint8_t result )
+{
+	for ( index_uint_t item = first; item < first + count; item++ )
+	{
+		index_uint_t macro = macroTriggerLongList[ item ];
+
+		if ( result )
+		{
+			Macro_appendResultMacroToPendingList( &TriggerMacroList[ macro ] );
+		}
+
+		IndexBitmap_clear( macroTriggerMacroPendingListBits, macro );
+		Timer_cancel( macro );
+	}
+}
+
+
+// Number of TriggerMacros at the start of the range that finish with the combo ending at end
+// Finished guides sort first, so only the start of the range is checked
+index_uint_t Trigger_longFinished( index_uint_t first, index_uint_t count, var_uint_t end )
+{
+	index_uint_t finished = 0;
+	while ( finished < count && TriggerMacroList[ macroTriggerLongList[ first + finished ] ].guide[ end ] == 0 )
+	{
+		finished++;
+	}
+
+	return finished;
+}
+
+
+// Votes once on a range of long TriggerMacros sharing the guide up to the end of the combo at pos
+// Same decisions as Trigger_evalTriggerMacro, applied to each TriggerMacro in the range
+void Trigger_evalCursorCombo( index_uint_t first, index_uint_t count, var_uint_t pos, TriggerMacroState state )
+{
+	const uint8_t *guide = TriggerMacroList[ macroTriggerLongList[ first ] ].guide;
+	var_uint_t end = pos + guide[ pos ] * TriggerGuideSize + 1;
+
+	TriggerMacroVote overallVote = Trigger_voteCombo( guide, pos, 1 );
+
+	// Fail, remove from pending list
+	if ( overallVote & TriggerMacroVote_Fail )
+	{
+		Trigger_removeLong( first, count, 0 );
+		return;
+	}
+	// Do nothing, incorrect key is being held or released
+	else if ( overallVote & TriggerMacroVote_DoNothing )
+	{
+	}
+	// Ready for transition, TriggerMacros finishing with this combo send their ResultMacro and are removed
+	else if ( overallVote & TriggerMacroVote_Release && state == TriggerMacro_Press )
+	{
+		state = TriggerMacro_Release;
+
+		index_uint_t finished = Trigger_longFinished( first, count, end );
+		Trigger_removeLong( first, finished, 1 );
+		first += finished;
+		count -= finished;
+	}
+	// Passing, TriggerMacros finishing with this combo send their ResultMacro and are removed
+	else if ( overallVote & TriggerMacroVote_Pass
+		&& ( state == TriggerMacro_Waiting || state == TriggerMacro_Press ) )
+	{
+		state = TriggerMacro_Press;
+
+		// Long ResultMacros are only triggered once, on press, otherwise keep waiting for the release
+		index_uint_t finished = Trigger_longFinished( first, count, end );
+		index_uint_t kept = first;
+		for ( index_uint_t item = first; item < first + finished; item++ )
+		{
+			index_uint_t macro = macroTriggerLongList[ item ];
+			if ( overallVote != TriggerMacroVote_Pass
+				&& macroResultMacroInfo[ TriggerMacroList[ macro ].result ].comboCount > 1 )
+			{
+				continue;
+			}
+
+			// Keep the TriggerMacros before this one
+			if ( item > kept )
+			{
+				Trigger_keepCursor( kept, item - kept, pos, state );
+			}
+
+			Trigger_removeLong( item, 1, 1 );
+			kept = item + 1;
+		}
+		count -= kept - first;
+		first = kept;
+	}
+	// Otherwise, just remove the macros on key release
+	else if ( overallVote & TriggerMacroVote_Release )
+	{
+		Trigger_removeLong( first, count, 1 );
+		return;
+	}
+
+	if ( count > 0 )
+	{
+		Trigger_keepCursor( first, count, pos, state );
+	}
+}
+
+
+// Evaluate/Update a pending long TriggerMacro cursor
+void Trigger_evalCursor( TriggerCursor cursor )
+{
+	TriggerMacroRecord *record = &macroTriggerMacroRecordList[ macroTriggerLongList[ cursor.first ] ];
+	if ( record->state != TriggerMacro_Release )
+	{
+		Trigger_evalCursorCombo( cursor.first, cursor.count, record->pos, record->state );
+		return;
+	}
+
+	// Move to the next combo, the TriggerMacros in the cursor may continue with different combos
+	const uint8_t *guide = TriggerMacroList[ macroTriggerLongList[ cursor.first ] ].guide;
+	var_uint_t pos = record->pos + guide[ record->pos ] * TriggerGuideSize + 1;
+	while ( cursor.count > 0 )
+	{
+		// Split off the TriggerMacros sharing the next combo
+		guide = TriggerMacroList[ macroTriggerLongList[ cursor.first ] ].guide;
+		var_uint_t end = pos + guide[ pos ] * TriggerGuideSize + 1;
+		index_uint_t count = 1;
+		while ( count < cursor.count && macroTriggerLongPrefix[ cursor.first + count ] >= end )
+		{
+			count++;
+		}
+
+		// If no combo items are left, remove from the pending list
+		if ( guide[ pos ] == 0 )
+		{
+			Trigger_removeLong( cursor.first, count, 0 );
+		}
+		else
+		{
+			Trigger_evalCursorCombo( cursor.first, count, pos, TriggerMacro_Waiting );
+		}
+
+		cursor.first += count;
+		cursor.count -= count;
+	}
+}
+
+
 // Update pending trigger list
 void Trigger_updateTriggerMacroPendingList()
 {
+	// Sorted list range of new long TriggerMacros
+	index_uint_t newFirst = macroTriggerLongListSize;
+	index_uint_t newEnd = 0;
+
 	// Iterate over the macroTriggerEventBuffer to add any new Trigger Macros to the pending list
 	for ( var_uint_t key = 0; key < macroTriggerEventBufferSize; key++ )
 	{
@@ -514,30 +1066,67 @@ void Trigger_updateTriggerMacroPendingList()
 		for ( var_uint_t macro = 1; macro < triggerListSize + 1; macro++ )
 		{
 			// Lookup trigger macro index
-			var_uint_t triggerMacroIndex = triggerList[ macro ];
+			index_uint_t triggerMacroIndex = triggerList[ macro ];
 
-			// Iterate over macroTriggerMacroPendingList to see if any macro in the scancode's
-			//  triggerList needs to be added
-			var_uint_t pending = 0;
-			for ( ; pending < macroTriggerMacroPendingListSize; pending++ )
-			{
-				// Stop scanning if the trigger macro index is found in the pending list
-				if ( macroTriggerMacroPendingList[ pending ] == triggerMacroIndex )
-					break;
-			}
+			// Keys of a held chord only start TriggerMacros using the whole chord
+			if ( macroChordActiveSize > 0 && !Macro_chordAllows( &macroTriggerEventBuffer[ key ], triggerMacroIndex ) )
+				continue;
 
-			// If the triggerMacroIndex (macro) was not found in the macroTriggerMacroPendingList
+			// If the triggerMacroIndex (macro) is not in the macroTriggerMacroPendingList
 			// Add it to the list
-			if ( pending == macroTriggerMacroPendingListSize )
+			if ( !IndexBitmap_test( macroTriggerMacroPendingListBits, triggerMacroIndex ) )
 			{
-				macroTriggerMacroPendingList[ macroTriggerMacroPendingListSize++ ] = triggerMacroIndex;
+				IndexBitmap_set( macroTriggerMacroPendingListBits, triggerMacroIndex );
 
 				// Reset macro position
-				TriggerMacroRecordList[ triggerMacroIndex ].pos   = 0;
-				TriggerMacroRecordList[ triggerMacroIndex ].state = TriggerMacro_Waiting;
+				macroTriggerMacroRecordList[ triggerMacroIndex ].pos   = 0;
+				macroTriggerMacroRecordList[ triggerMacroIndex ].state = TriggerMacro_Waiting;
+
+				// Long TriggerMacros in the prefix trie are grouped into cursors once all the events have been added
+				index_uint_t slot = macroTriggerLongListSize;
+				if ( macroTriggerLongTrie && macroTriggerMacroInfo[ triggerMacroIndex ].comboCount > 1 )
+				{
+					slot = Trigger_longSlot( triggerMacroIndex );
+				}
+				if ( slot < macroTriggerLongListSize )
+				{
+					index_uint_t rank = macroTriggerLongRank[ slot ];
+					IndexBitmap_set( macroTriggerLongNewBits, rank );
+					if ( rank < newFirst )
+						newFirst = rank;
+					if ( rank >= newEnd )
+						newEnd = rank + 1;
+					continue;
+				}
+
+				macroTriggerMacroPendingList[ macroTriggerMacroPendingListSize++ ] = triggerMacroIndex;
 			}
 		}
 	}
+
+	// Add a cursor for each group of new long TriggerMacros
+	// TriggerMacros adjacent in the sorted list, and sharing the first combo, are followed by the same cursor
+	for ( index_uint_t rank = newFirst; rank < newEnd; rank++ )
+	{
+		if ( !IndexBitmap_test( macroTriggerLongNewBits, rank ) )
+			continue;
+
+		const uint8_t *guide = TriggerMacroList[ macroTriggerLongList[ rank ] ].guide;
+		var_uint_t end = guide[ 0 ] * TriggerGuideSize + 1;
+		index_uint_t count = 1;
+
+		IndexBitmap_clear( macroTriggerLongNewBits, rank );
+		while ( rank + count < newEnd
+			&& IndexBitmap_test( macroTriggerLongNewBits, rank + count )
+			&& macroTriggerLongPrefix[ rank + count ] >= end )
+		{
+			IndexBitmap_clear( macroTriggerLongNewBits, rank + count );
+			count++;
+		}
+
+		Trigger_appendCursor( rank, count );
+		rank += count - 1;
+	}
 }
 
 
@@ -553,30 +1142,111 @@ uint8_t Trigger_update( uint8_t type, uint8_t state, uint8_t index )
 }
 
 
+// Called by Timer_process when a TriggerMacro deadline fires
+// The TriggerMacro is re-evaluated in this processing loop, even if no event arrived
+void Trigger_deadline( index_uint_t triggerMacroIndex )
+{
+	IndexBitmap_set( macroTriggerMacroDeadlineBits, triggerMacroIndex );
+	macroTriggerMacroDeadlineFired = 1;
+
+	// Add to the pending list if not already there, the record is left as is
+	if ( !IndexBitmap_test( macroTriggerMacroPendingListBits, triggerMacroIndex ) )
+	{
+		IndexBitmap_set( macroTriggerMacroPendingListBits, triggerMacroIndex );
+		macroTriggerMacroPendingList[ macroTriggerMacroPendingListSize++ ] = triggerMacroIndex;
+	}
+}
+
+
+uint8_t Trigger_deadlineFired( index_uint_t triggerMacroIndex )
+{
+	return IndexBitmap_test( macroTriggerMacroDeadlineBits, triggerMacroIndex ) ? 1 : 0;
+}
+
+
 void Trigger_setup()
 {
+	// Initialize pending list
+	macroTriggerMacroPendingListSize = 0;
+	memset( macroTriggerMacroPendingListBits, 0, sizeof( macroTriggerMacroPendingListBits ) );
+	memset( macroTriggerMacroDeadlineBits, 0, sizeof( macroTriggerMacroDeadlineBits ) );
+	macroTriggerMacroDeadlineFired = 0;
+
+	// Initialize held key set
+	memset( macroTriggerHeldBits, 0, sizeof( macroTriggerHeldBits ) );
+	macroTriggerHeldSize = 0;
+
+	// Initialize deadlines
+	Timer_setup();
+
 	// Initialize TriggerMacro states
-	for ( var_uint_t macro = 0; macro < TriggerMacroNum; macro++ )
+	for ( index_uint_t macro = 0; macro < TriggerMacroNum; macro++ )
 	{
-		TriggerMacroRecordList[ macro ].pos   = 0;
-		TriggerMacroRecordList[ macro ].state = TriggerMacro_Waiting;
+		macroTriggerMacroRecordList[ macro ].pos   = 0;
+		macroTriggerMacroRecordList[ macro ].state = TriggerMacro_Waiting;
+	}
+
+	// Decode TriggerMacro metadata
+	for ( index_uint_t macro = 0; macro < TriggerMacroNum_KLL; macro++ )
+	{
+		const uint8_t *guide = TriggerMacroList[ macro ].guide;
+		TriggerMacroInfo *info = &macroTriggerMacroInfo[ macro ];
+
+		info->lastComboPos = 0;
+		info->lastGuidePos = 0;
+		info->comboCount   = 0;
+
+		// Walk each combo until the 0 length terminator
+		for ( var_uint_t pos = 0; guide[ pos ] != 0; pos += guide[ pos ] * TriggerGuideSize + 1 )
+		{
+			info->lastComboPos = pos;
+			info->lastGuidePos = pos + ( guide[ pos ] - 1 ) * TriggerGuideSize + 1;
+			info->comboCount++;
+		}
 	}
+
+	// Build long TriggerMacro prefix trie
+	Trigger_buildLongTrie();
+	macroTriggerCursorListSize = 0;
+	memset( macroTriggerLongNewBits, 0, sizeof( macroTriggerLongNewBits ) );
 }
 
 
 void Trigger_process()
 {
+	// Index the incoming events by ScanCode, used for voting
+	Trigger_buildEventLookup();
+
 	// Update pending trigger list, before processing TriggerMacros
 	Trigger_updateTriggerMacroPendingList();
 
+	// Clear the deadlines fired during the previous processing loop
+	if ( macroTriggerMacroDeadlineFired )
+	{
+		memset( macroTriggerMacroDeadlineBits, 0, sizeof( macroTriggerMacroDeadlineBits ) );
+		macroTriggerMacroDeadlineFired = 0;
+	}
+
+	// Fire any expired deadlines, adding the TriggerMacros to the pending list
+	Timer_process( Time_now() );
+
 	// Tail pointer for macroTriggerMacroPendingList
 	// Macros must be explicitly re-added
-	var_uint_t macroTriggerMacroPendingListTail = 0;
+	index_uint_t macroTriggerMacroPendingListTail = 0;
 
 	// Iterate through the pending TriggerMacros, processing each of them
-	for ( var_uint_t macro = 0; macro < macroTriggerMacroPendingListSize; macro++ )
+	for ( index_uint_t macro = 0; macro < macroTriggerMacroPendingListSize; macro++ )
 	{
-		switch ( Trigger_evalTriggerMacro( macroTriggerMacroPendingList[ macro ] ) )
+		// Macros waiting on a deadline are only re-evaluated once it fires, or an event arrives
+		if ( macroTriggerEventBufferSize == 0 && Timer_armed( macroTriggerMacroPendingList[ macro ] ) )
+		{
+			macroTriggerMacroPendingList[ macroTriggerMacroPendingListTail++ ] = macroTriggerMacroPendingList[ macro ];
+			continue;
+		}
+
+		TriggerMacroEval eval = Trigger_evalTriggerMacro( macroTriggerMacroPendingList[ macro ] );
+
+		switch ( eval )
 		{
 		// Trigger Result Macro (purposely falling through)
 		case TriggerMacroEval_DoResult:
@@ -592,13 +1262,46 @@ void Trigger_process()
 			// Append ResultMacro to PendingList
 			Macro_appendResultMacroToPendingList( &TriggerMacroList[ macroTriggerMacroPendingList[ macro ] ] );
 
-		// Remove Macro from Pending List, nothing to do, removing by default
+			// Keys still held, restart the TriggerMacro instead (Hold is not sent by the scan module)
+			if ( Trigger_shortHeld( macroTriggerMacroPendingList[ macro ] ) )
+			{
+				macroTriggerMacroRecordList[ macroTriggerMacroPendingList[ macro ] ].pos   = 0;
+				macroTriggerMacroRecordList[ macroTriggerMacroPendingList[ macro ] ].state = TriggerMacro_Waiting;
+				macroTriggerMacroPendingList[ macroTriggerMacroPendingListTail++ ] = macroTriggerMacroPendingList[ macro ];
+				break;
+			}
+
+		// Remove Macro from Pending List, removing by default (just clear the membership bit)
+		// Any armed deadline no longer applies
 		case TriggerMacroEval_Remove:
+			IndexBitmap_clear( macroTriggerMacroPendingListBits, macroTriggerMacroPendingList[ macro ] );
+			Timer_cancel( macroTriggerMacroPendingList[ macro ] );
 			break;
 		}
 	}
 
 	// Update the macroTriggerMacroPendingListSize with the tail pointer
 	macroTriggerMacroPendingListSize = macroTriggerMacroPendingListTail;
+
+	// Iterate through the pending long TriggerMacro cursors
+	// Cursors are compacted towards the start of the list, splits that do not fit are appended
+	// Result order: ResultMacros of long TriggerMacros are queued after those of the pending list,
+	// and long TriggerMacros finishing in the same processing loop are queued in guide order (see long_trigger.py)
+	index_uint_t cursorListSize = macroTriggerCursorListSize;
+	macroTriggerCursorListTail = 0;
+	for ( macroTriggerCursorListPos = 0; macroTriggerCursorListPos < cursorListSize; macroTriggerCursorListPos++ )
+	{
+		Trigger_evalCursor( macroTriggerCursorList[ macroTriggerCursorListPos ] );
+	}
+
+	// Move the appended cursors after the kept cursors
+	for ( index_uint_t cursor = cursorListSize; cursor < macroTriggerCursorListSize; cursor++ )
+	{
+		macroTriggerCursorList[ macroTriggerCursorListTail++ ] = macroTriggerCursorList[ cursor ];
+	}
+	macroTriggerCursorListSize = macroTriggerCursorListTail;
+
+	// Reset the event lookup for the next processing loop
+	Trigger_clearEventLookup();
 }
 
@@ -21,6 +21,9 @@
 // Compiler Includes
 #include <stdint.h>
 
+// Local Includes
+#include "kll.h"
+
 
 
 // ----- Functions -----
@@ -33,6 +36,22 @@ void Trigger_state( uint8_t type, uint8_t state, uint8_t index );
 // Returns 1 otherwise
 uint8_t Trigger_update( uint8_t type, uint8_t state, uint8_t index );
 
+// Converts a Switch type and index into a ScanCode, 0xFFFF if not a Switch or out of range
+uint16_t Trigger_switchScanCode( uint8_t type, uint8_t index );
+
+// State of a Switch ScanCode this processing loop, Hold if held without an event, 0x00 if off
+uint8_t Trigger_switchState( uint16_t scanCode );
+
+// Clears the held key set, adding a Release event for each key that was held to events
+// Returns the number of events added (at most max)
+var_uint_t Trigger_releaseHeld( TriggerEvent *events, var_uint_t max );
+
+// Lookup the metadata decoded from a TriggerMacro guide, 0 if not a TriggerMacroList entry
+const TriggerMacroInfo *Trigger_triggerMacroInfo( const TriggerMacro *macro );
+
+// Returns non-zero if the Timer_set deadline of the TriggerMacro fired during this processing loop
+uint8_t Trigger_deadlineFired( index_uint_t triggerMacroIndex );
+
 void Trigger_process();
 void Trigger_setup();
 
@@ -18,6 +18,10 @@
 
 // Compiler Includes
 #include <Lib/MacroLib.h>
+#if defined(_host_)
+#include <pthread.h>
+#include <stdlib.h>
+#endif
 
 // Project Includes
 #include <cli.h>
@@ -26,6 +30,7 @@
 #include <led.h>
 #include <print.h>
 #include <output_com.h>
+#include <trigger.h>
 
 // Local Includes
 #include "pixel.h"
@@ -93,22 +98,22 @@ CLIDict_Def( pixelCLIDict, "Pixel Module Commands" ) = {
 };
 
 // Debug states
-PixelTest Pixel_testMode;
-uint16_t  Pixel_testPos = 0;
+Instance PixelTest Pixel_testMode;
+Instance uint16_t  Pixel_testPos = 0;
 
 // Frame State
 //  Indicates to pixel and output modules current state of the buffer
-FrameState Pixel_FrameState;
+Instance FrameState Pixel_FrameState;
 
 // Animation Stack
-AnimationStack Pixel_AnimationStack;
+Instance AnimationStack Pixel_AnimationStack;
 
 // Animation Control
-AnimationControl Pixel_animationControl;
+Instance AnimationControl Pixel_animationControl;
 
 // Memory Stor for Animation Elements
 // Animation elements may be called multiple times, thus memory must be allocated per instance
-AnimationStackElement Pixel_AnimationElement_Stor[Pixel_AnimationStackSize];
+Instance AnimationStackElement Pixel_AnimationElement_Stor[Pixel_AnimationStackSize];
 
 #if defined(_host_)
 uint16_t Pixel_AnimationStack_HostSize = Pixel_AnimationStackSize;
@@ -116,10 +121,19 @@ uint8_t  Pixel_Buffers_HostLen = Pixel_BuffersLen_KLL;
 uint8_t  Pixel_MaxChannelPerPixel_Host = Pixel_MaxChannelPerPixel;
 uint16_t Pixel_Mapping_HostLen = 128; // TODO Define
 uint8_t  Pixel_AnimationStackElement_HostSize = sizeof( AnimationStackElement );
+
+// Frame buffers of each instance, see Pixel_setupBuffers
+//  * kll emits a single set of frame buffers (Pixel_Buffers), used by the first instance set up (and host.py)
+//  * Any other instance draws into its own copy, so instances do not share frames
+//  * The buffers are released when the thread of the instance ends (see Pixel_releaseBuffers)
+Instance PixelBuf *Pixel_InstanceBuffers;
+static uint8_t Pixel_BuffersClaimed;
+static pthread_key_t Pixel_BuffersKey;
+static pthread_once_t Pixel_BuffersKeyOnce = PTHREAD_ONCE_INIT;
 #endif
 
 // Latency Measurement Resource
-static uint8_t pixelLatencyResource;
+static Instance uint8_t pixelLatencyResource;
 
 
 
@@ -132,6 +146,7 @@ uint8_t Pixel_determineLastTriggerScanCode( TriggerMacro *trigger );
 void Pixel_pixelSet( PixelElement *elem, uint32_t value );
 
 PixelBuf *Pixel_bufferMap( uint16_t channel );
+static inline PixelBuf *Pixel_bufferList();
 
 AnimationStackElement *Pixel_lookupAnimation( uint16_t index, uint16_t prev );
 
@@ -506,24 +521,101 @@ void Pixel_stackProcess()
 
 // -- Pixel Control --
 
+// Frame buffers of the current instance
+static inline PixelBuf *Pixel_bufferList()
+{
+#if defined(_host_)
+	return Pixel_InstanceBuffers;
+#else
+	return Pixel_Buffers;
+#endif
+}
+
+#if defined(_host_)
+// Releases the frame buffers of an instance, called when its thread ends
+// The kll frame buffers are handed back, so a later instance may claim them
+void Pixel_releaseBuffers( void *buffer_list )
+{
+	PixelBuf *buffers = (PixelBuf*)buffer_list;
+
+	if ( buffers == Pixel_Buffers )
+	{
+		__atomic_clear( &Pixel_BuffersClaimed, __ATOMIC_SEQ_CST );
+		return;
+	}
+
+	for ( uint8_t buf = 0; buf < Pixel_BuffersLen_KLL; buf++ )
+	{
+		free( buffers[ buf ].data );
+	}
+	free( buffers );
+}
+
+void Pixel_setupBuffersKey()
+{
+	pthread_key_create( &Pixel_BuffersKey, Pixel_releaseBuffers );
+}
+
+// Selects the frame buffers of the current instance
+// Returns 0 if they could not be allocated
+uint8_t Pixel_setupBuffers()
+{
+	// Already selected, e.g. Host_init called again
+	if ( Pixel_InstanceBuffers )
+		return 1;
+
+	pthread_once( &Pixel_BuffersKeyOnce, Pixel_setupBuffersKey );
+
+	// First instance, use the kll frame buffers
+	if ( !__atomic_test_and_set( &Pixel_BuffersClaimed, __ATOMIC_SEQ_CST ) )
+	{
+		Pixel_InstanceBuffers = Pixel_Buffers;
+		pthread_setspecific( Pixel_BuffersKey, Pixel_InstanceBuffers );
+		return 1;
+	}
+
+	// Otherwise copy the buffer list, each buffer pointing to its own frame storage
+	PixelBuf *buffers = calloc( Pixel_BuffersLen_KLL, sizeof( PixelBuf ) );
+	if ( buffers == NULL )
+		return 0;
+
+	for ( uint8_t buf = 0; buf < Pixel_BuffersLen_KLL; buf++ )
+	{
+		buffers[ buf ] = Pixel_Buffers[ buf ];
+		buffers[ buf ].data = calloc( Pixel_Buffers[ buf ].size, Pixel_Buffers[ buf ].width / 8 );
+		if ( buffers[ buf ].data == NULL )
+		{
+			// The list is zeroed, only the buffers allocated so far are freed
+			Pixel_releaseBuffers( buffers );
+			return 0;
+		}
+	}
+	Pixel_InstanceBuffers = buffers;
+	pthread_setspecific( Pixel_BuffersKey, Pixel_InstanceBuffers );
+	return 1;
+}
+#endif
+
 // PixelBuf lookup
 // - Determines which buffer a channel resides in
 PixelBuf *Pixel_bufferMap( uint16_t channel )
 {
+	PixelBuf *buffers = Pixel_bufferList();
+
 	// TODO Generate based on keyboard
 #if ISSI_Chip_31FL3731_define == 1 || ISSI_Chip_31FL3732_define == 1
-	if      ( channel < 144 ) return &Pixel_Buffers[0];
-	else if ( channel < 288 ) return &Pixel_Buffers[1];
-	else if ( channel < 432 ) return &Pixel_Buffers[2];
-	else if ( channel < 576 ) return &Pixel_Buffers[3];
+	if      ( channel < 144 ) return &buffers[0];
+	else if ( channel < 288 ) return &buffers[1];
+	else if ( channel < 432 ) return &buffers[2];
+	else if ( channel < 576 ) return &buffers[3];
 #elif ISSI_Chip_31FL3733_define == 1
-	if      ( channel < 192 ) return &Pixel_Buffers[0];
-	else if ( channel < 384 ) return &Pixel_Buffers[1];
-	else if ( channel < 576 ) return &Pixel_Buffers[2];
+	if      ( channel < 192 ) return &buffers[0];
+	else if ( channel < 384 ) return &buffers[1];
+	else if ( channel < 576 ) return &buffers[2];
 #else
-	if      ( channel < 192 ) return &Pixel_Buffers[0];
-	else if ( channel < 384 ) return &Pixel_Buffers[1];
-	else if ( channel < 576 ) return &Pixel_Buffers[2];
+	if      ( channel < 192 ) return &buffers[0];
+	else if ( channel < 384 ) return &buffers[1];
+	else if ( channel < 576 ) return &buffers[2];
 #endif
 
 	// Invalid channel, return first channel and display error
@@ -1491,31 +1583,18 @@ void Pixel_pixelToggle( PixelElement *elem )
 // -- General --
 
 // Looks up the final scancode in a trigger macro
+// Uses the first TriggerGuide of the final combo
 uint8_t Pixel_determineLastTriggerScanCode( TriggerMacro *trigger )
 {
-	// Ignore (set to zero) if unset
-	if ( trigger == 0 )
+	// Ignore (set to zero) if unset or not a TriggerMacroList entry
+	const TriggerMacroInfo *info = Trigger_triggerMacroInfo( trigger );
+	if ( info == 0 || info->comboCount == 0 )
 	{
 		return 0;
 	}
 
-	// Iterate over each TriggerGuide element
-	uint8_t curScanCode = 0;
-	for ( var_uint_t pos = 0; ; pos += trigger->guide[ pos ] * TriggerGuideSize + 1 )
-	{
-		// Length of this combo
-		uint8_t comboLength = trigger->guide[ pos ] * TriggerGuideSize;
-
-		// Determine scancode, use first TriggerGuide scanCode
-		TriggerGuide *guide = (TriggerGuide*)&trigger->guide[ pos + 1 ];
-		curScanCode = guide->scanCode;
-
-		// If this combo has zero length, we are at the end
-		if ( trigger->guide[ pos + comboLength + 1 ] == 0 )
-		{
-			return curScanCode;
-		}
-	}
+	TriggerGuide *guide = (TriggerGuide*)&trigger->guide[ info->lastComboPos + 1 ];
+	return guide->scanCode;
 }
 
 // Updates animations for USB Lock LEDs
@@ -1865,6 +1944,16 @@ inline void Pixel_setup()
 	// Register Pixel CLI dictionary
 	CLI_registerDictionary( pixelCLIDict, pixelCLIDictName );
 
+#if defined(_host_)
+	// Frame buffers of this instance
+	if ( !Pixel_setupBuffers() )
+	{
+		erro_print("Could not allocate the frame buffers");
+		Host_initFailed = 1;
+		return;
+	}
+#endif
+
 	// Set frame state to update
 	Pixel_FrameState = FrameState_Update;
 
@@ -1909,14 +1998,15 @@ void cliFunc_pixelList( char* args )
 		// List all buffers
 		for ( uint8_t buf = 0; buf < Pixel_BuffersLen_KLL; buf++ )
 		{
+			PixelBuf *pixbuf = &Pixel_bufferList()[ buf ];
 			print( NL "\t" );
 			printInt8( buf );
 			print(":");
-			printHex32( (uint32_t)(uintptr_t)(Pixel_Buffers[ buf ].data) );
+			printHex32( (uint32_t)(uintptr_t)(pixbuf->data) );
 			print(":width(");
-			printInt8( Pixel_Buffers[ buf ].width );
+			printInt8( pixbuf->width );
 			print("):size(");
-			printInt8( Pixel_Buffers[ buf ].size );
+			printInt8( pixbuf->size );
 			print(")");
 		}
 		break;
@@ -212,7 +212,7 @@ typedef struct AnimationStack {
 
 // ----- Variables -----
 
-extern FrameState Pixel_FrameState;
+extern Instance FrameState Pixel_FrameState;
 
 extern const AnimationStackElement Pixel_AnimationSettings[];
 
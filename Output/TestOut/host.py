@@ -23,7 +23,7 @@ Host-Side Python Commands for TestOut Output Module
 import os
 import sys
 
-from ctypes import POINTER, cast, c_uint8, c_uint16
+from ctypes import POINTER, Structure, cast, c_uint8, c_uint16
 
 
 
@@ -41,6 +41,36 @@ data = None
 debug = False
 control = None
 
+# NKRO bit position to USB Code, see nkro_lookup()
+nkro_codes = None
+
+
+
+### Functions ###
+
+def nkro_lookup():
+	'''
+	Returns a dictionary of NKRO bitfield positions to USB Codes
+	Built from USBKeys_NKROLookup (see Output/USBKeys/usbkeys.c), modifiers are excluded
+	'''
+	global nkro_codes
+	if nkro_codes is None:
+		# See usbkeys.h USBKeysNKRO
+		class USBKeysNKRO( Structure ):
+			_fields_ = [
+				( 'position', c_uint8 ),
+				( 'changed',  c_uint8 ),
+			]
+		table = cast( control.kiibohd.USBKeys_NKROLookup, POINTER( USBKeysNKRO * 256 ) )[0]
+
+		# USBKeyChangeState_None (0x00) and USBKeyChangeState_Modifiers (0x01) have no keys bitfield position
+		nkro_codes = {}
+		for code, entry in enumerate( table ):
+			if entry.changed not in ( 0x00, 0x01 ):
+				nkro_codes[ entry.position ] = code
+
+	return nkro_codes
+
 
 
 ### Classes ###
@@ -73,7 +103,7 @@ class USBKeyboard:
 		# Calculate modifiers
 		for bit in range( 0, 8 ):
 			if self.modifiers & (1<<bit):
-				keys.append( 0xE0 | (1<<bit) )
+				keys.append( 0xE0 + bit )
 
 		# 6 keys for boot mode
 		if self.protocol == 0:
@@ -82,25 +112,13 @@ class USBKeyboard:
 					keys.append( self.keys[ index ] )
 		# NKRO key extraction
 		elif self.protocol == 1:
-			# See output_com.c Output_usbCodeSend_capability for details on start/pos
-			start = 0
-			for byte in self.keys:
-				for pos, bit in zip( range( start, start + 8 ), range( 0, 8 ) ):
+			# Bit positions are decoded using the same lookup table as the firmware
+			lookup = nkro_lookup()
+			for index, byte in enumerate( self.keys ):
+				for bit in range( 0, 8 ):
 					# Check if bit is set
-					if byte & (1<<bit):
-						if pos <= 45:
-							keys.append( pos + 4 )
-						elif pos <= 47:
-							pass
-						elif pos <= 161:
-							keys.append( pos + 3 )
-						elif pos <= 167:
-							pass
-						elif pos <= 213:
-							keys.append( pos + 8 )
-						elif pos <= 216:
-							pass
-				start += 8
+					if byte & (1<<bit) and ( index << 3 | bit ) in lookup:
+						keys.append( lookup[ index << 3 | bit ] )
 
 		return keys
 
@@ -150,24 +168,32 @@ class Callbacks:
 		Callback received when Host-side KLL is ready to send USB keyboard codes
 		When this command is received, we must do a few things
 		1) Read the Bitfield size
-		2) Read in USBKeys_Keys data array and USBKeys_Keys modifier byte
-		3) Read in USBKeys_Protocol to determine format of USBKeys_Keys data
-		4) Convert USBKeys_Keys into an array of USB Keyboard Codes
-		5) Set USBKeys_Changed to 0x00 (USBKeysChangeState_None)
+		2) Read in USBKeys_primary keys data array and modifier byte
+		3) Read in USBKeys_Protocol to determine format of the keys data
+		4) Convert the keys data into an array of USB Keyboard Codes
+		5) Set USBKeys_primary changed to 0x00 (USBKeyChangeState_None)
 		'''
 		# Gather data/pointers
 		bitfield_size = cast( control.kiibohd.USBKeys_BitfieldSize, POINTER( c_uint8 ) )[0]
-		modifiers     = cast( control.kiibohd.USBKeys_Modifiers,    POINTER( c_uint8 ) )[0]
-		keys          = cast( control.kiibohd.USBKeys_Keys,         POINTER( c_uint8 * bitfield_size ) )[0]
 		protocol      = cast( control.kiibohd.USBKeys_Protocol,     POINTER( c_uint8 ) )[0]
-		consumer_ctrl = cast( control.kiibohd.USBKeys_ConsCtrl,     POINTER( c_uint16 ) )[0]
-		system_ctrl   = cast( control.kiibohd.USBKeys_SysCtrl,      POINTER( c_uint8 ) )[0]
+
+		# See output_com.h USBKeys
+		class USBKeys( Structure ):
+			_fields_ = [
+				( 'modifiers', c_uint8 ),
+				( 'keys',      c_uint8 * bitfield_size ),
+				( 'sys_ctrl',  c_uint8 ),
+				( 'cons_ctrl', c_uint16 ),
+				( 'changed',   c_uint8 ),
+			]
+		usb_keys      = cast( control.kiibohd.USBKeys_Sending, POINTER( POINTER( USBKeys ) ) )[0][0]
+		modifiers     = usb_keys.modifiers
+		keys          = usb_keys.keys
+		consumer_ctrl = usb_keys.cons_ctrl
+		system_ctrl   = usb_keys.sys_ctrl
 
 		# keys array format
-		# Bits   0 -  45 (bytes  0 -  5) correspond to USB Codes   4 -  49 (Main)
-		# Bits  48 - 161 (bytes  6 - 20) correspond to USB Codes  51 - 164 (Secondary)
-		# Bits 168 - 213 (bytes 21 - 26) correspond to USB Codes 176 - 221 (Tertiary)
-		# Bits 214 - 216                 unused
+		# See Output/USBKeys/usbkeys.c USBKeys_NKROLookup for the USB Code to bit position mapping
 		key_list = []
 		for index in range( 0, bitfield_size ):
 			key_list.append( keys[ index ] )
@@ -180,9 +206,17 @@ class Callbacks:
 			consumer_ctrl,
 			system_ctrl,
 		)
+		data.usb_keyboard_reports.append( data.usb_keyboard_data )
 
 		# Indicate we are done with the buffer
-		cast( control.kiibohd.USBKeys_Changed, POINTER( c_uint8 ) )[0] = 0
+		usb_keys.changed = 0
+
+	def keyboard_drain( self, args ):
+		'''
+		Callback received when the keyboard report ring is full
+		See Control.report_ring_setup() in Lib/host.py
+		'''
+		control.report_ring_drain()
 
 	def mouse_send( self, args ):
 		'''
@@ -32,6 +32,7 @@
 #include <led.h>
 #include <print.h>
 #include <scan_loop.h>
+#include <usbkeys.h>
 
 // KLL
 #include <kll_defs.h>
@@ -42,21 +43,6 @@
 
 
 
-// ----- Macros -----
-
-// Used to build a bitmap lookup table from a byte addressable array
-#define byteLookup( byte ) \
-	case (( byte ) * ( 8 )):         bytePosition = byte; byteShift = 0; break; \
-	case (( byte ) * ( 8 ) + ( 1 )): bytePosition = byte; byteShift = 1; break; \
-	case (( byte ) * ( 8 ) + ( 2 )): bytePosition = byte; byteShift = 2; break; \
-	case (( byte ) * ( 8 ) + ( 3 )): bytePosition = byte; byteShift = 3; break; \
-	case (( byte ) * ( 8 ) + ( 4 )): bytePosition = byte; byteShift = 4; break; \
-	case (( byte ) * ( 8 ) + ( 5 )): bytePosition = byte; byteShift = 5; break; \
-	case (( byte ) * ( 8 ) + ( 6 )): bytePosition = byte; byteShift = 6; break; \
-	case (( byte ) * ( 8 ) + ( 7 )): bytePosition = byte; byteShift = 7; break
-
-
-
 // ----- Function Declarations -----
 
 void cliFunc_current    ( char* args );
@@ -65,6 +51,7 @@ void cliFunc_kbdProtocol( char* args );
 void cliFunc_outputDebug( char* args );
 void cliFunc_readLEDs   ( char* args );
 void cliFunc_usbInitTime( char* args );
+void cliFunc_usbReports ( char* args );
 
 
 
@@ -77,6 +64,7 @@ CLIDict_Entry( kbdProtocol, "Keyboard Protocol Mode: 0 - Boot, 1 - OS/NKRO Mode.
 CLIDict_Entry( outputDebug, "Toggle Output Debug mode." );
 CLIDict_Entry( readLEDs,    "Read LED byte:" NL "\t\t1 NumLck, 2 CapsLck, 4 ScrlLck, 16 Kana, etc." );
 CLIDict_Entry( usbInitTime, "Displays the time in ms from usb_init() till the last setup call." );
+CLIDict_Entry( usbReports,  "Show USB reports sent and suppressed (matching the last report sent)." NL "\t\tAny argument resets the counters." );
 
 CLIDict_Def( outputCLIDict, "USB Module Commands" ) = {
 	CLIDict_Item( current ),
@@ -85,77 +73,84 @@ CLIDict_Def( outputCLIDict, "USB Module Commands" ) = {
 	CLIDict_Item( outputDebug ),
 	CLIDict_Item( readLEDs ),
 	CLIDict_Item( usbInitTime ),
+	CLIDict_Item( usbReports ),
 	{ 0, 0, 0 } // Null entry for dictionary end
 };
 
 
 // USBKeys Keyboard Buffer
-USBKeys USBKeys_primary; // Primary send buffer
-USBKeys USBKeys_idle;    // Idle timeout send buffer
+Instance USBKeys USBKeys_primary; // Primary send buffer
+Instance USBKeys USBKeys_idle;    // Idle timeout send buffer
 
-uint8_t  USBKeys_BitfieldSize = USB_NKRO_BITFIELD_SIZE_KEYS;
+Instance uint8_t  USBKeys_BitfieldSize = USB_NKRO_BITFIELD_SIZE_KEYS;
 
 // The number of keys sent to the usb in the array
-uint8_t  USBKeys_Sent;
+Instance uint8_t  USBKeys_Sent;
 
 // 1=num lock, 2=caps lock, 4=scroll lock, 8=compose, 16=kana
-volatile uint8_t  USBKeys_LEDs = 0;
-volatile uint8_t  USBKeys_LEDs_Changed;
+Instance volatile uint8_t  USBKeys_LEDs = 0;
+Instance volatile uint8_t  USBKeys_LEDs_Changed;
 
 // Currently pressed mouse buttons, bitmask, 0 represents no buttons pressed
-volatile uint16_t USBMouse_Buttons = 0;
+Instance volatile uint16_t USBMouse_Buttons = 0;
 
 // Relative mouse axis movement, stores pending movement
-volatile uint16_t USBMouse_Relative_x = 0;
-volatile uint16_t USBMouse_Relative_y = 0;
+Instance volatile uint16_t USBMouse_Relative_x = 0;
+Instance volatile uint16_t USBMouse_Relative_y = 0;
 
 // Protocol setting from the host.
 // 0 - Boot Mode
 // 1 - NKRO Mode (Default, unless set by a BIOS or boot interface)
-volatile uint8_t  USBKeys_Protocol = USBProtocol_define;
+Instance volatile uint8_t  USBKeys_Protocol = USBProtocol_define;
 
 // Indicate if USB should send update
-volatile USBMouseChangeState USBMouse_Changed = 0;
+Instance volatile USBMouseChangeState USBMouse_Changed = 0;
 
 // the idle configuration, how often we send the report to the
 // host (ms * 4) even when it hasn't changed
 // 0 - Disables
-uint8_t  USBKeys_Idle_Config = 0;
+Instance uint8_t  USBKeys_Idle_Config = 0;
 
 // Count until idle timeout
-uint32_t USBKeys_Idle_Expiry = 0;
-uint8_t  USBKeys_Idle_Count = 0;
+Instance uint32_t USBKeys_Idle_Expiry = 0;
+Instance uint8_t  USBKeys_Idle_Count = 0;
 
 // Indicates whether the Output module is fully functional
 // 0 - Not fully functional, 1 - Fully functional
 // 0 is often used to show that a USB cable is not plugged in (but has power)
-volatile uint8_t  Output_Available = 0;
+Instance volatile uint8_t  Output_Available = 0;
 
 // Debug control variable for Output modules
 // 0 - Debug disabled (default)
 // 1 - Debug enabled
-uint8_t  Output_DebugMode = 0;
+Instance uint8_t  Output_DebugMode = 0;
 
 // mA - Set by outside module if not using USB (i.e. Interconnect)
 // Generally set to 100 mA (low power) or 500 mA (high power)
-uint16_t Output_ExtCurrent_Available = 0;
+Instance uint16_t Output_ExtCurrent_Available = 0;
 
 // mA - Set by USB module (if exists)
 // Initially 100 mA, but may be negotiated higher (e.g. 500 mA)
-uint16_t Output_USBCurrent_Available = 0;
+Instance uint16_t Output_USBCurrent_Available = 0;
 
 // USB Init Time (ms) - usb_init()
-volatile uint32_t USBInit_TimeStart;
-volatile uint32_t USBInit_TimeEnd;
-volatile uint16_t USBInit_Ticks;
+Instance volatile uint32_t USBInit_TimeStart;
+Instance volatile uint32_t USBInit_TimeEnd;
+Instance volatile uint16_t USBInit_Ticks;
 
 // Latency measurement resource
-static uint8_t outputPeriodicLatencyResource;
-static uint8_t outputPollLatencyResource;
+static Instance uint8_t outputPeriodicLatencyResource;
+static Instance uint8_t outputPollLatencyResource;
 
 // Callback function to host
 // Output_Host_Callback( char* command, char* args ) return int
-void *Output_Host_Callback;
+Instance void *Output_Host_Callback;
+
+// Keyboard report being sent by the host callback
+Instance USBKeys *USBKeys_Sending;
+
+// Host provided keyboard report ring, NULL sends reports through the callback
+Instance HostReportRing *Output_Host_ReportRing;
 
 
 
@@ -317,6 +312,7 @@ void Output_sysCtrlSend_capability( TriggerMacro *trigger, uint8_t state, uint8_
 
 
 // Adds a single USB Code to the USB Output buffer
+// The change is queued, and applied along with the other changes of the processing loop by Output_usbCodeApply
 // Argument #1: USB Code
 void Output_usbCodeSend_capability( TriggerMacro *trigger, uint8_t state, uint8_t stateType, uint8_t *args )
 {
@@ -340,206 +336,44 @@ void Output_usbCodeSend_capability( TriggerMacro *trigger, uint8_t state, uint8_
 		keyPress = 1;
 
 	// Get the keycode from arguments
-	uint8_t key = args[0];
-
-	// Depending on which mode the keyboard is in, USBKeys_Keys array is used differently
-	// Boot mode - Maximum of 6 byte codes
-	// NKRO mode - Each bit of the 26 byte corresponds to a key
-	//  Bits   0 -  45 (bytes  0 -  5) correspond to USB Codes   4 -  49 (Main)
-	//  Bits  48 - 161 (bytes  6 - 20) correspond to USB Codes  51 - 164 (Secondary)
-	//  Bits 168 - 213 (bytes 21 - 26) correspond to USB Codes 176 - 221 (Tertiary)
-	//  Bits 214 - 216                 unused
-	uint8_t bytePosition = 0;
-	uint8_t byteShift = 0;
+	USBKeys_queue( args[0], keyPress );
+#endif
+}
 
-	switch ( USBKeys_Protocol )
-	{
-	case 0: // Boot Mode
-		// Set the modifier bit if this key is a modifier
-		if ( (key & 0xE0) == 0xE0 ) // AND with 0xE0 (Left Ctrl, first modifier)
-		{
-			if ( keyPress )
-			{
-				USBKeys_primary.modifiers |= 1 << (key ^ 0xE0); // Left shift 1 by key XOR 0xE0
-			}
-			else // Release
-			{
-				USBKeys_primary.modifiers &= ~(1 << (key ^ 0xE0)); // Left shift 1 by key XOR 0xE0
-			}
-
-			USBKeys_primary.changed |= USBKeyChangeState_Modifiers;
-		}
-		// Normal USB Code
-		else
-		{
-			// Determine if key was set
-			uint8_t keyFound = 0;
-			uint8_t old_sent = USBKeys_Sent;
-
-			for ( uint8_t curkey = 0, newkey = 0; curkey < old_sent; curkey++, newkey++ )
-			{
-				// On press, key already present, don't re-add
-				if ( keyPress && USBKeys_primary.keys[newkey] == key )
-				{
-					keyFound = 1;
-					break;
-				}
-
-				// On release, remove if found
-				if ( !keyPress && USBKeys_primary.keys[newkey] == key )
-				{
-					// Shift next key onto this one
-					// (Doesn't matter if it overflows, buffer is large enough, and size is used)
-					USBKeys_primary.keys[newkey--] = USBKeys_primary.keys[++curkey];
-					USBKeys_Sent--;
-					keyFound = 1;
-					USBKeys_primary.changed = USBKeyChangeState_MainKeys;
-					break;
-				}
-			}
-
-			// USB Key limit reached
-			if ( USBKeys_Sent >= USB_BOOT_MAX_KEYS )
-			{
-				warn_print("USB Key limit reached");
-				break;
-			}
-
-			// Add key if not already found in the buffer
-			if ( keyPress && !keyFound )
-			{
-				USBKeys_primary.keys[USBKeys_Sent++] = key;
-				USBKeys_primary.changed = USBKeyChangeState_MainKeys;
-			}
-		}
-		break;
 
-	case 1: // NKRO Mode
-		// Set the modifier bit if this key is a modifier
-		if ( (key & 0xE0) == 0xE0 ) // AND with 0xE0 (Left Ctrl, first modifier)
-		{
-			if ( keyPress )
-			{
-				USBKeys_primary.modifiers |= 1 << (key ^ 0xE0); // Left shift 1 by key XOR 0xE0
-			}
-			else // Release
-			{
-				USBKeys_primary.modifiers &= ~(1 << (key ^ 0xE0)); // Left shift 1 by key XOR 0xE0
-			}
-
-			USBKeys_primary.changed |= USBKeyChangeState_Modifiers;
-			break;
-		}
-		// First 6 bytes
-		else if ( key >= 4 && key <= 49 )
-		{
-			// Lookup (otherwise division or multiple checks are needed to do alignment)
-			// Starting at 0th position, each byte has 8 bits, starting at 4th bit
-			uint8_t keyPos = key + (0 * 8 - 4); // Starting position in array, Ignoring 4 keys
-			switch ( keyPos )
-			{
-				byteLookup( 0 );
-				byteLookup( 1 );
-				byteLookup( 2 );
-				byteLookup( 3 );
-				byteLookup( 4 );
-				byteLookup( 5 );
-			}
-
-			USBKeys_primary.changed |= USBKeyChangeState_MainKeys;
-		}
-		// Next 14 bytes
-		else if ( key >= 51 && key <= 155 )
-		{
-			// Lookup (otherwise division or multiple checks are needed to do alignment)
-			// Starting at 6th byte position, each byte has 8 bits, starting at 51st bit
-			uint8_t keyPos = key + (6 * 8 - 51); // Starting position in array
-			switch ( keyPos )
-			{
-				byteLookup( 6 );
-				byteLookup( 7 );
-				byteLookup( 8 );
-				byteLookup( 9 );
-				byteLookup( 10 );
-				byteLookup( 11 );
-				byteLookup( 12 );
-				byteLookup( 13 );
-				byteLookup( 14 );
-				byteLookup( 15 );
-				byteLookup( 16 );
-				byteLookup( 17 );
-				byteLookup( 18 );
-				byteLookup( 19 );
-			}
-
-			USBKeys_primary.changed |= USBKeyChangeState_SecondaryKeys;
-		}
-		// Next byte
-		else if ( key >= 157 && key <= 164 )
-		{
-			// Lookup (otherwise division or multiple checks are needed to do alignment)
-			uint8_t keyPos = key + (20 * 8 - 157); // Starting position in array, Ignoring 6 keys
-			switch ( keyPos )
-			{
-				byteLookup( 20 );
-			}
-
-			USBKeys_primary.changed |= USBKeyChangeState_TertiaryKeys;
-		}
-		// Last 6 bytes
-		else if ( key >= 176 && key <= 221 )
-		{
-			// Lookup (otherwise division or multiple checks are needed to do alignment)
-			uint8_t keyPos = key + (21 * 8 - 176); // Starting position in array
-			switch ( keyPos )
-			{
-				byteLookup( 21 );
-				byteLookup( 22 );
-				byteLookup( 23 );
-				byteLookup( 24 );
-				byteLookup( 25 );
-				byteLookup( 26 );
-			}
-
-			USBKeys_primary.changed |= USBKeyChangeState_QuartiaryKeys;
-		}
-		// Received 0x00
-		// This is a special USB Code that internally indicates a "break"
-		// It is used to send "nothing" in order to break up sequences of USB Codes
-		else if ( key == 0x00 )
-		{
-			USBKeys_primary.changed |= USBKeyChangeState_MainKeys;
+void Output_usbCodeApply()
+{
+#if enableKeyboard_define == 1
+	USBKeys_apply();
+#endif
+}
 
-			// Also flush out buffers just in case
-			Output_flushBuffers();
-			break;
-		}
-		// Invalid key
-		else
-		{
-			warn_msg("USB Code not within 4-49 (0x4-0x31), 51-155 (0x33-0x9B), 157-164 (0x9D-0xA4), 176-221 (0xB0-0xDD) or 224-231 (0xE0-0xE7) NKRO Mode: ");
-			printHex( key );
-			print( NL );
-			break;
-		}
 
-		// Set/Unset
-		if ( keyPress )
-		{
-			USBKeys_primary.keys[bytePosition] |= (1 << byteShift);
-			USBKeys_Sent--;
-		}
-		else // Release
-		{
-			USBKeys_primary.keys[bytePosition] &= ~(1 << byteShift);
-			USBKeys_Sent++;
-		}
+uint8_t Output_usbCodeCommit()
+{
+#if enableKeyboard_define == 1
+	return USBKeys_reportCommit();
+#else
+	return 0;
+#endif
+}
 
-		break;
-	}
+
+uint8_t Output_usbReportReady()
+{
+#if enableKeyboard_define == 1
+	return !USBKeys_ringFull();
+#else
+	return 1;
 #endif
 }
 
+
+void Output_usbReportDiscard()
+{
+	USBKeys_reportDiscard();
+}
+
 void Output_flashMode_capability( TriggerMacro *trigger, uint8_t state, uint8_t stateType, uint8_t *args )
 {
 	// Display capability name
@@ -624,6 +458,63 @@ int Output_callback( char* command, char* args )
 	return callback( command, args );
 }
 
+// Writes a keyboard report to the host report ring
+void Output_keyboardRecord( USBKeys *buffer )
+{
+	HostReportRing *ring = Output_Host_ReportRing;
+
+	// Ring is full, ask the host to drain it
+	if ( ring->head - ring->tail >= ring->size )
+	{
+		Output_callback( "keyboard_drain", "" );
+
+		if ( ring->head - ring->tail >= ring->size )
+		{
+			ring->dropped++;
+			buffer->changed = USBKeyChangeState_None;
+			return;
+		}
+	}
+
+	Time now = Time_now();
+	HostReport *report = &ring->reports[ ring->head % ring->size ];
+	report->ms = now.ms;
+	report->ticks = now.ticks;
+	report->protocol = USBKeys_Protocol;
+	report->modifiers = buffer->modifiers;
+	report->sys_ctrl = buffer->sys_ctrl;
+	report->cons_ctrl = buffer->cons_ctrl;
+	memcpy( report->keys, buffer->keys, USB_NKRO_BITFIELD_SIZE_KEYS );
+	ring->head++;
+	USBKeys_ReportsSent++;
+
+	buffer->changed = USBKeyChangeState_None;
+}
+
+// Sends a keyboard report through the host callback
+void Output_keyboardSend( USBKeys *buffer )
+{
+	// Drop reports matching the last ones sent, the remaining sections are sent together per report
+	USBKeys_reportDiff( buffer );
+
+	// Write the whole report to the ring, if the host provided one
+	if ( Output_Host_ReportRing != NULL )
+	{
+		if ( buffer->changed )
+			Output_keyboardRecord( buffer );
+		return;
+	}
+
+	// Send keypresses while there are pending changes
+	USBKeys_Sending = buffer;
+	while ( buffer->changed )
+	{
+		Output_callback( "keyboard_send", "" );
+		USBKeys_ReportsSent++;
+	}
+}
+
+
 // Flush Key buffers
 void Output_flushBuffers()
 {
@@ -634,6 +525,12 @@ void Output_flushBuffers()
 	// Reset USBKeys_Keys size
 	USBKeys_Sent = 0;
 
+	// Drop any queued USB Code changes
+	USBKeys_PendingCount = 0;
+
+	// Send the next reports even if they match the last ones sent
+	USBKeys_reportInvalidate();
+
 	// Set USBKeys_LEDs_Changed to indicate that we should update LED status
 	USBKeys_LEDs_Changed = 1;
 }
@@ -645,6 +542,9 @@ inline void Output_setup()
 	// Register USB Output CLI dictionary
 	CLI_registerDictionary( outputCLIDict, outputCLIDictName );
 
+	// Setup report tracking
+	USBKeys_setup();
+
 	// Flush key buffers
 	Output_flushBuffers();
 
@@ -688,6 +588,16 @@ inline void Output_periodic()
 #endif
 
 #if enableKeyboard_define == 1
+	// Send the reports queued during macro processing, in order
+	// Then apply the USB Code changes still queued (e.g. from the CLI, or left waiting for room in the ring)
+	do {
+		while ( USBKeys_RingCount > 0 )
+		{
+			Output_keyboardSend( USBKeys_ringFront() );
+			USBKeys_ringPop();
+		}
+	} while ( !USBKeys_apply() || USBKeys_RingCount > 0 );
+
 	// Boot Mode Only, unset stale keys
 	if ( USBKeys_Protocol == 0 )
 	{
@@ -697,9 +607,7 @@ inline void Output_periodic()
 		}
 	}
 
-	// Send keypresses while there are pending changes
-	while ( USBKeys_primary.changed )
-		Output_callback( "keyboard_send", "" );
+	Output_keyboardSend( &USBKeys_primary );
 
 	// Clear keys sent
 	USBKeys_Sent = 0;
@@ -988,3 +896,27 @@ void cliFunc_usbInitTime( char* args )
 	print(" ticks");
 }
 
+
+void cliFunc_usbReports( char* args )
+{
+	// Parse number from argument
+	//  NOTE: Only first argument is used
+	char* arg1Ptr;
+	char* arg2Ptr;
+	CLI_argumentIsolation( args, &arg1Ptr, &arg2Ptr );
+
+	// Reset counters if an argument is given
+	if ( arg1Ptr[0] != '\0' )
+	{
+		USBKeys_ReportsSent = 0;
+		USBKeys_ReportsSuppressed = 0;
+	}
+
+	print( NL );
+	info_msg("Reports Sent: ");
+	printInt32( USBKeys_ReportsSent );
+	print( NL );
+	info_msg("Reports Suppressed: ");
+	printInt32( USBKeys_ReportsSuppressed );
+}
+
@@ -26,6 +26,9 @@
 // Compiler Includes
 #include <stdint.h>
 
+// Project Includes
+#include <Lib/mcu_compat.h>
+
 // Local Includes
 #include <buildvars.h> // Defines USB Parameters, partially generated by CMake
 
@@ -88,44 +91,68 @@ typedef struct USBKeys {
 	USBKeyChangeState changed;
 } USBKeys;
 
+// Timestamped keyboard report, written to the host report ring
+typedef struct HostReport {
+	uint32_t ms;    // Time_now() when sent
+	uint32_t ticks;
+	uint8_t  protocol;
+	uint8_t  modifiers;
+	uint8_t  sys_ctrl;
+	uint8_t  keys[USB_NKRO_BITFIELD_SIZE_KEYS];
+	uint16_t cons_ctrl;
+} HostReport;
+
+// Host provided ring of keyboard reports, see Host_register_report_ring
+// head is only written by the firmware, tail only by the host (free running, index modulo size)
+typedef struct HostReportRing {
+	volatile uint32_t head;
+	volatile uint32_t tail;
+	uint32_t size;    // Number of reports
+	uint32_t dropped; // Reports lost while the ring was full
+	HostReport reports[];
+} HostReportRing;
+
 
 
 // ----- Variables -----
 
 // Variables used to communciate to the output module
 // XXX Even if the output module is not USB, this is internally understood keymapping scheme
-extern          USBKeys  USBKeys_primary;
-extern          USBKeys  USBKeys_idle;
-extern          uint8_t  USBKeys_BitfieldSize;
+extern Instance          USBKeys  USBKeys_primary;
+extern Instance          USBKeys  USBKeys_idle;
+extern Instance          uint8_t  USBKeys_BitfieldSize;
 
-extern          uint8_t  USBKeys_Sent;
-extern volatile uint8_t  USBKeys_LEDs;
-extern volatile uint8_t  USBKeys_LEDs_Changed;
+extern Instance          uint8_t  USBKeys_Sent;
+extern Instance volatile uint8_t  USBKeys_LEDs;
+extern Instance volatile uint8_t  USBKeys_LEDs_Changed;
 
-extern volatile uint8_t  USBKeys_Protocol; // 0 - Boot Mode, 1 - NKRO Mode
+extern Instance volatile uint8_t  USBKeys_Protocol; // 0 - Boot Mode, 1 - NKRO Mode
 
-extern volatile uint16_t USBMouse_Buttons; // Bitmask for mouse buttons
-extern volatile uint16_t USBMouse_Relative_x;
-extern volatile uint16_t USBMouse_Relative_y;
+extern Instance volatile uint16_t USBMouse_Buttons; // Bitmask for mouse buttons
+extern Instance volatile uint16_t USBMouse_Relative_x;
+extern Instance volatile uint16_t USBMouse_Relative_y;
 
 // Keeps track of the idle timeout refresh (used on Mac OSX)
-extern          uint8_t  USBKeys_Idle_Config;
-extern          uint32_t USBKeys_Idle_Expiry;
-extern          uint8_t  USBKeys_Idle_Count; // AVR only
+extern Instance          uint8_t  USBKeys_Idle_Config;
+extern Instance          uint32_t USBKeys_Idle_Expiry;
+extern Instance          uint8_t  USBKeys_Idle_Count; // AVR only
+
+extern Instance volatile USBMouseChangeState USBMouse_Changed;
 
-extern volatile USBMouseChangeState USBMouse_Changed;
+extern Instance volatile uint8_t  Output_Available; // 0 - Output module not fully functional, 1 - Output module working
 
-extern volatile uint8_t  Output_Available; // 0 - Output module not fully functional, 1 - Output module working
+extern Instance          uint8_t  Output_DebugMode; // 0 - Debug disabled, 1 - Debug enabled
 
-extern          uint8_t  Output_DebugMode; // 0 - Debug disabled, 1 - Debug enabled
+extern Instance          uint16_t Output_ExtCurrent_Available; // mA - Set by outside module if not using USB (i.e. Interconnect)
 
-extern          uint16_t Output_ExtCurrent_Available; // mA - Set by outside module if not using USB (i.e. Interconnect)
+extern Instance volatile uint32_t USBInit_TimeStart; // Timetamp when usb_init was triggered
+extern Instance volatile uint32_t USBInit_TimeEnd;   // Timetamp since last call to the Configuration endpoint
+extern Instance volatile uint16_t USBInit_Ticks;     // Number of times the end time has been updated
 
-extern volatile uint32_t USBInit_TimeStart; // Timetamp when usb_init was triggered
-extern volatile uint32_t USBInit_TimeEnd;   // Timetamp since last call to the Configuration endpoint
-extern volatile uint16_t USBInit_Ticks;     // Number of times the end time has been updated
+extern Instance          void*    Output_Host_Callback; // Callback function to host
+extern Instance          USBKeys* USBKeys_Sending;      // Keyboard report being sent by the host callback
 
-extern          void*    Output_Host_Callback; // Callback function to host
+extern Instance HostReportRing* Output_Host_ReportRing; // Keyboard reports are written here instead of the callback, if set
 
 
 
@@ -137,6 +164,19 @@ void Output_periodic();
 
 void Output_flushBuffers();
 
+// Applies the USB Code changes queued during this processing loop to USBKeys_primary
+void Output_usbCodeApply();
+
+// Applies the queued USB Code changes, and queues the resulting keyboard report
+// Returns 0 if no changes were queued, or there is no room left to queue the report
+uint8_t Output_usbCodeCommit();
+
+// Returns 0 while there is no room left to queue keyboard reports, see USBKeys_ringPush
+uint8_t Output_usbReportReady();
+
+// Drops the current and queued keyboard reports
+void Output_usbReportDiscard();
+
 void Output_firmwareReload();
 void Output_softReset();
 
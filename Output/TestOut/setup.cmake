@@ -11,6 +11,7 @@
 # Required Sub-modules
 #
 AddModule ( Output HID-IO )
+AddModule ( Output USBKeys )
 
 
 
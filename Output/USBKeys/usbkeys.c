@@ -0,0 +1,521 @@
+/* Copyright (C) 2017 by Jacob Alexander
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <Lib/OutputLib.h>
+#include <string.h>
+
+// Project Includes
+#include <print.h>
+
+// Local Includes
+#include "usbkeys.h"
+
+
+
+// ----- Macros -----
+
+// USB Code to NKRO bitfield position
+#define NKRO_Key( bit, section ) { bit, USBKeyChangeState_##section##Keys }
+#define NKRO_Modifier( bit )     { bit, USBKeyChangeState_Modifiers }
+#define NKRO_None                { 0, USBKeyChangeState_None }
+
+
+
+// ----- Variables -----
+
+// NKRO bitfield layout
+//  Bits   0 -  45 (bytes  0 -  5) correspond to USB Codes   4 -  49 (Main)
+//  Bits  48 - 152 (bytes  6 - 19) correspond to USB Codes  51 - 155 (Secondary)
+//  Bits 160 - 167 (byte  20)      correspond to USB Codes 157 - 164 (Tertiary)
+//  Bits 168 - 213 (bytes 21 - 26) correspond to USB Codes 176 - 221 (Quartiary)
+//  Modifiers (USB Codes 224 - 231) are kept in a separate byte
+const USBKeysNKRO USBKeys_NKROLookup[ 256 ] = {
+	/* 0x00 */ NKRO_None, NKRO_None, NKRO_None, NKRO_None, NKRO_Key( 0, Main ), NKRO_Key( 1, Main ), NKRO_Key( 2, Main ), NKRO_Key( 3, Main ),
+	/* 0x08 */ NKRO_Key( 4, Main ), NKRO_Key( 5, Main ), NKRO_Key( 6, Main ), NKRO_Key( 7, Main ), NKRO_Key( 8, Main ), NKRO_Key( 9, Main ), NKRO_Key( 10, Main ), NKRO_Key( 11, Main ),
+	/* 0x10 */ NKRO_Key( 12, Main ), NKRO_Key( 13, Main ), NKRO_Key( 14, Main ), NKRO_Key( 15, Main ), NKRO_Key( 16, Main ), NKRO_Key( 17, Main ), NKRO_Key( 18, Main ), NKRO_Key( 19, Main ),
+	/* 0x18 */ NKRO_Key( 20, Main ), NKRO_Key( 21, Main ), NKRO_Key( 22, Main ), NKRO_Key( 23, Main ), NKRO_Key( 24, Main ), NKRO_Key( 25, Main ), NKRO_Key( 26, Main ), NKRO_Key( 27, Main ),
+	/* 0x20 */ NKRO_Key( 28, Main ), NKRO_Key( 29, Main ), NKRO_Key( 30, Main ), NKRO_Key( 31, Main ), NKRO_Key( 32, Main ), NKRO_Key( 33, Main ), NKRO_Key( 34, Main ), NKRO_Key( 35, Main ),
+	/* 0x28 */ NKRO_Key( 36, Main ), NKRO_Key( 37, Main ), NKRO_Key( 38, Main ), NKRO_Key( 39, Main ), NKRO_Key( 40, Main ), NKRO_Key( 41, Main ), NKRO_Key( 42, Main ), NKRO_Key( 43, Main ),
+	/* 0x30 */ NKRO_Key( 44, Main ), NKRO_Key( 45, Main ), NKRO_None, NKRO_Key( 48, Secondary ), NKRO_Key( 49, Secondary ), NKRO_Key( 50, Secondary ), NKRO_Key( 51, Secondary ), NKRO_Key( 52, Secondary ),
+	/* 0x38 */ NKRO_Key( 53, Secondary ), NKRO_Key( 54, Secondary ), NKRO_Key( 55, Secondary ), NKRO_Key( 56, Secondary ), NKRO_Key( 57, Secondary ), NKRO_Key( 58, Secondary ), NKRO_Key( 59, Secondary ), NKRO_Key( 60, Secondary ),
+	/* 0x40 */ NKRO_Key( 61, Secondary ), NKRO_Key( 62, Secondary ), NKRO_Key( 63, Secondary ), NKRO_Key( 64, Secondary ), NKRO_Key( 65, Secondary ), NKRO_Key( 66, Secondary ), NKRO_Key( 67, Secondary ), NKRO_Key( 68, Secondary ),
+	/* 0x48 */ NKRO_Key( 69, Secondary ), NKRO_Key( 70, Secondary ), NKRO_Key( 71, Secondary ), NKRO_Key( 72, Secondary ), NKRO_Key( 73, Secondary ), NKRO_Key( 74, Secondary ), NKRO_Key( 75, Secondary ), NKRO_Key( 76, Secondary ),
+	/* 0x50 */ NKRO_Key( 77, Secondary ), NKRO_Key( 78, Secondary ), NKRO_Key( 79, Secondary ), NKRO_Key( 80, Secondary ), NKRO_Key( 81, Secondary ), NKRO_Key( 82, Secondary ), NKRO_Key( 83, Secondary ), NKRO_Key( 84, Secondary ),
+	/* 0x58 */ NKRO_Key( 85, Secondary ), NKRO_Key( 86, Secondary ), NKRO_Key( 87, Secondary ), NKRO_Key( 88, Secondary ), NKRO_Key( 89, Secondary ), NKRO_Key( 90, Secondary ), NKRO_Key( 91, Secondary ), NKRO_Key( 92, Secondary ),
+	/* 0x60 */ NKRO_Key( 93, Secondary ), NKRO_Key( 94, Secondary ), NKRO_Key( 95, Secondary ), NKRO_Key( 96, Secondary ), NKRO_Key( 97, Secondary ), NKRO_Key( 98, Secondary ), NKRO_Key( 99, Secondary ), NKRO_Key( 100, Secondary ),
+	/* 0x68 */ NKRO_Key( 101, Secondary ), NKRO_Key( 102, Secondary ), NKRO_Key( 103, Secondary ), NKRO_Key( 104, Secondary ), NKRO_Key( 105, Secondary ), NKRO_Key( 106, Secondary ), NKRO_Key( 107, Secondary ), NKRO_Key( 108, Secondary ),
+	/* 0x70 */ NKRO_Key( 109, Secondary ), NKRO_Key( 110, Secondary ), NKRO_Key( 111, Secondary ), NKRO_Key( 112, Secondary ), NKRO_Key( 113, Secondary ), NKRO_Key( 114, Secondary ), NKRO_Key( 115, Secondary ), NKRO_Key( 116, Secondary ),
+	/* 0x78 */ NKRO_Key( 117, Secondary ), NKRO_Key( 118, Secondary ), NKRO_Key( 119, Secondary ), NKRO_Key( 120, Secondary ), NKRO_Key( 121, Secondary ), NKRO_Key( 122, Secondary ), NKRO_Key( 123, Secondary ), NKRO_Key( 124, Secondary ),
+	/* 0x80 */ NKRO_Key( 125, Secondary ), NKRO_Key( 126, Secondary ), NKRO_Key( 127, Secondary ), NKRO_Key( 128, Secondary ), NKRO_Key( 129, Secondary ), NKRO_Key( 130, Secondary ), NKRO_Key( 131, Secondary ), NKRO_Key( 132, Secondary ),
+	/* 0x88 */ NKRO_Key( 133, Secondary ), NKRO_Key( 134, Secondary ), NKRO_Key( 135, Secondary ), NKRO_Key( 136, Secondary ), NKRO_Key( 137, Secondary ), NKRO_Key( 138, Secondary ), NKRO_Key( 139, Secondary ), NKRO_Key( 140, Secondary ),
+	/* 0x90 */ NKRO_Key( 141, Secondary ), NKRO_Key( 142, Secondary ), NKRO_Key( 143, Secondary ), NKRO_Key( 144, Secondary ), NKRO_Key( 145, Secondary ), NKRO_Key( 146, Secondary ), NKRO_Key( 147, Secondary ), NKRO_Key( 148, Secondary ),
+	/* 0x98 */ NKRO_Key( 149, Secondary ), NKRO_Key( 150, Secondary ), NKRO_Key( 151, Secondary ), NKRO_Key( 152, Secondary ), NKRO_None, NKRO_Key( 160, Tertiary ), NKRO_Key( 161, Tertiary ), NKRO_Key( 162, Tertiary ),
+	/* 0xA0 */ NKRO_Key( 163, Tertiary ), NKRO_Key( 164, Tertiary ), NKRO_Key( 165, Tertiary ), NKRO_Key( 166, Tertiary ), NKRO_Key( 167, Tertiary ), NKRO_None, NKRO_None, NKRO_None,
+	/* 0xA8 */ NKRO_None, NKRO_None, NKRO_None, NKRO_None, NKRO_None, NKRO_None, NKRO_None, NKRO_None,
+	/* 0xB0 */ NKRO_Key( 168, Quartiary ), NKRO_Key( 169, Quartiary ), NKRO_Key( 170, Quartiary ), NKRO_Key( 171, Quartiary ), NKRO_Key( 172, Quartiary ), NKRO_Key( 173, Quartiary ), NKRO_Key( 174, Quartiary ), NKRO_Key( 175, Quartiary ),
+	/* 0xB8 */ NKRO_Key( 176, Quartiary ), NKRO_Key( 177, Quartiary ), NKRO_Key( 178, Quartiary ), NKRO_Key( 179, Quartiary ), NKRO_Key( 180, Quartiary ), NKRO_Key( 181, Quartiary ), NKRO_Key( 182, Quartiary ), NKRO_Key( 183, Quartiary ),
+	/* 0xC0 */ NKRO_Key( 184, Quartiary ), NKRO_Key( 185, Quartiary ), NKRO_Key( 186, Quartiary ), NKRO_Key( 187, Quartiary ), NKRO_Key( 188, Quartiary ), NKRO_Key( 189, Quartiary ), NKRO_Key( 190, Quartiary ), NKRO_Key( 191, Quartiary ),
+	/* 0xC8 */ NKRO_Key( 192, Quartiary ), NKRO_Key( 193, Quartiary ), NKRO_Key( 194, Quartiary ), NKRO_Key( 195, Quartiary ), NKRO_Key( 196, Quartiary ), NKRO_Key( 197, Quartiary ), NKRO_Key( 198, Quartiary ), NKRO_Key( 199, Quartiary ),
+	/* 0xD0 */ NKRO_Key( 200, Quartiary ), NKRO_Key( 201, Quartiary ), NKRO_Key( 202, Quartiary ), NKRO_Key( 203, Quartiary ), NKRO_Key( 204, Quartiary ), NKRO_Key( 205, Quartiary ), NKRO_Key( 206, Quartiary ), NKRO_Key( 207, Quartiary ),
+	/* 0xD8 */ NKRO_Key( 208, Quartiary ), NKRO_Key( 209, Quartiary ), NKRO_Key( 210, Quartiary ), NKRO_Key( 211, Quartiary ), NKRO_Key( 212, Quartiary ), NKRO_Key( 213, Quartiary ), NKRO_None, NKRO_None,
+	/* 0xE0 */ NKRO_Modifier( 0 ), NKRO_Modifier( 1 ), NKRO_Modifier( 2 ), NKRO_Modifier( 3 ), NKRO_Modifier( 4 ), NKRO_Modifier( 5 ), NKRO_Modifier( 6 ), NKRO_Modifier( 7 ),
+	/* 0xE8 */ NKRO_None, NKRO_None, NKRO_None, NKRO_None, NKRO_None, NKRO_None, NKRO_None, NKRO_None,
+	/* 0xF0 */ NKRO_None, NKRO_None, NKRO_None, NKRO_None, NKRO_None, NKRO_None, NKRO_None, NKRO_None,
+	/* 0xF8 */ NKRO_None, NKRO_None, NKRO_None, NKRO_None, NKRO_None, NKRO_None, NKRO_None, NKRO_None,
+};
+
+
+// Last report sent, per endpoint
+Instance USBKeysSent USBKeys_LastSent;
+
+// Reports sent and reports dropped for matching the last report sent
+Instance uint32_t USBKeys_ReportsSent;
+Instance uint32_t USBKeys_ReportsSuppressed;
+
+// Queued keyboard reports
+Instance USBKeys  USBKeys_Ring[ USBReportRing_define ];
+Instance uint8_t  USBKeys_RingHead;
+Instance uint8_t  USBKeys_RingCount;
+
+// Reports merged into the newest queued report, as they matched it
+Instance uint32_t USBKeys_RingCollapsed;
+
+// USB Code changes queued by Output_usbCodeSend_capability
+Instance USBKeyChange USBKeys_Pending[ USB_PENDING_MAX_KEYS ];
+Instance uint8_t      USBKeys_PendingCount;
+
+
+
+// ----- Functions -----
+
+USBKeyChangeState USBKeys_nkroUpdate( USBKeys *usbKeys, uint8_t key, uint8_t press )
+{
+	const USBKeysNKRO *entry = &USBKeys_NKROLookup[ key ];
+
+	// Modifiers use their own byte, unused USB Codes get an empty mask
+	uint8_t *byte = entry->changed == USBKeyChangeState_Modifiers
+		? &usbKeys->modifiers
+		: &usbKeys->keys[ entry->position >> 3 ];
+	uint8_t mask = entry->changed != USBKeyChangeState_None ? 1 << ( entry->position & 0x7 ) : 0;
+
+	// Set on press, clear on release
+	*byte = ( *byte & ~mask ) | ( mask & -press );
+	usbKeys->changed |= entry->changed;
+
+	return (USBKeyChangeState)entry->changed;
+}
+
+
+
+USBKeyChangeState USBKeys_reportDiff( USBKeys *usbKeys )
+{
+	USBKeys *ctrl = &USBKeys_LastSent.ctrl;
+	uint8_t changed = usbKeys->changed;
+
+	// System Control report
+	if ( changed & USBKeyChangeState_System )
+	{
+		if ( !( ctrl->changed & USBKeyChangeState_System ) && ctrl->sys_ctrl == usbKeys->sys_ctrl )
+		{
+			changed &= ~USBKeyChangeState_System;
+			USBKeys_ReportsSuppressed++;
+		}
+		else
+		{
+			ctrl->sys_ctrl = usbKeys->sys_ctrl;
+			ctrl->changed &= ~USBKeyChangeState_System;
+		}
+	}
+
+	// Consumer Control report
+	if ( changed & USBKeyChangeState_Consumer )
+	{
+		if ( !( ctrl->changed & USBKeyChangeState_Consumer ) && ctrl->cons_ctrl == usbKeys->cons_ctrl )
+		{
+			changed &= ~USBKeyChangeState_Consumer;
+			USBKeys_ReportsSuppressed++;
+		}
+		else
+		{
+			ctrl->cons_ctrl = usbKeys->cons_ctrl;
+			ctrl->changed &= ~USBKeyChangeState_Consumer;
+		}
+	}
+
+	// Keyboard report, all sections are sent together
+	if ( changed & USBKeys_KeyboardSections )
+	{
+		USBKeys *keyboard = USBKeys_Protocol == 0 ? &USBKeys_LastSent.boot : &USBKeys_LastSent.nkro;
+		uint8_t size = USBKeys_Protocol == 0 ? USB_BOOT_MAX_KEYS : USB_NKRO_BITFIELD_SIZE_KEYS;
+
+		if ( !keyboard->changed
+			&& keyboard->modifiers == usbKeys->modifiers
+			&& memcmp( keyboard->keys, usbKeys->keys, size ) == 0
+		)
+		{
+			changed &= ~USBKeys_KeyboardSections;
+			USBKeys_ReportsSuppressed++;
+		}
+		else
+		{
+			keyboard->modifiers = usbKeys->modifiers;
+			memcpy( keyboard->keys, usbKeys->keys, size );
+			keyboard->changed = USBKeyChangeState_None;
+		}
+	}
+
+	usbKeys->changed = (USBKeyChangeState)changed;
+	return usbKeys->changed;
+}
+
+
+void USBKeys_reportInvalidate()
+{
+	USBKeys_LastSent.boot.changed = USBKeyChangeState_All;
+	USBKeys_LastSent.nkro.changed = USBKeyChangeState_All;
+	USBKeys_LastSent.ctrl.changed = USBKeyChangeState_All;
+}
+
+
+uint8_t USBKeys_ringPush( USBKeys *usbKeys )
+{
+	// Same contents as the newest report, sending it again would not change anything
+	if ( USBKeys_RingCount > 0 )
+	{
+		USBKeys *newest = &USBKeys_Ring[ ( USBKeys_RingHead + USBKeys_RingCount - 1 ) % USBReportRing_define ];
+
+		if ( newest->modifiers == usbKeys->modifiers
+			&& newest->sys_ctrl == usbKeys->sys_ctrl
+			&& newest->cons_ctrl == usbKeys->cons_ctrl
+			&& memcmp( newest->keys, usbKeys->keys, sizeof( newest->keys ) ) == 0
+		)
+		{
+			newest->changed |= usbKeys->changed;
+			USBKeys_RingCollapsed++;
+			return 1;
+		}
+	}
+
+	// Full, the report is kept by the caller until there is room
+	if ( USBKeys_RingCount >= USBReportRing_define )
+		return 0;
+
+	memcpy( &USBKeys_Ring[ ( USBKeys_RingHead + USBKeys_RingCount ) % USBReportRing_define ], usbKeys, sizeof( USBKeys ) );
+	USBKeys_RingCount++;
+	return 1;
+}
+
+
+uint8_t USBKeys_ringFull()
+{
+	return USBKeys_RingCount >= USBReportRing_define;
+}
+
+
+USBKeys *USBKeys_ringFront()
+{
+	if ( USBKeys_RingCount == 0 )
+		return 0;
+
+	return &USBKeys_Ring[ USBKeys_RingHead ];
+}
+
+
+void USBKeys_ringPop()
+{
+	if ( USBKeys_RingCount == 0 )
+		return;
+
+	USBKeys_RingHead = ( USBKeys_RingHead + 1 ) % USBReportRing_define;
+	USBKeys_RingCount--;
+}
+
+
+// Sets/Unsets a modifier bit
+void USBKeys_modifier( uint8_t key, uint8_t keyPress )
+{
+	if ( keyPress )
+	{
+		USBKeys_primary.modifiers |= 1 << (key ^ 0xE0); // Left shift 1 by key XOR 0xE0
+	}
+	else // Release
+	{
+		USBKeys_primary.modifiers &= ~(1 << (key ^ 0xE0)); // Left shift 1 by key XOR 0xE0
+	}
+
+	USBKeys_primary.changed |= USBKeyChangeState_Modifiers;
+}
+
+
+// Boot mode - Maximum of 6 byte codes
+// Applies all the queued changes in a single pass over the key array
+void USBKeys_applyBoot( USBKeyChange *changes, uint8_t count )
+{
+	// Final state of each changed USB Code, the last change wins
+	uint8_t pressed[ 32 ] = { 0 };
+	uint8_t released[ 32 ] = { 0 };
+
+	for ( uint8_t change = 0; change < count; change++ )
+	{
+		uint8_t key = changes[ change ].key;
+
+		// Set the modifier bit if this key is a modifier
+		if ( (key & 0xE0) == 0xE0 ) // AND with 0xE0 (Left Ctrl, first modifier)
+		{
+			USBKeys_modifier( key, changes[ change ].press );
+			continue;
+		}
+
+		if ( changes[ change ].press )
+		{
+			pressed[ key >> 3 ] |= 1 << (key & 0x7);
+			released[ key >> 3 ] &= ~(1 << (key & 0x7));
+		}
+		else
+		{
+			released[ key >> 3 ] |= 1 << (key & 0x7);
+			pressed[ key >> 3 ] &= ~(1 << (key & 0x7));
+		}
+	}
+
+	// Remove released keys, shifting the remaining keys down
+	// Keys that are already present are not re-added
+	uint8_t newkey = 0;
+	for ( uint8_t curkey = 0; curkey < USBKeys_Sent; curkey++ )
+	{
+		uint8_t key = USBKeys_primary.keys[curkey];
+
+		if ( released[ key >> 3 ] & (1 << (key & 0x7)) )
+		{
+			USBKeys_primary.changed |= USBKeyChangeState_MainKeys;
+			continue;
+		}
+
+		pressed[ key >> 3 ] &= ~(1 << (key & 0x7));
+		USBKeys_primary.keys[newkey++] = key;
+	}
+	USBKeys_Sent = newkey;
+
+	// Add pressed keys, in the order they were pressed
+	for ( uint8_t change = 0; change < count; change++ )
+	{
+		uint8_t key = changes[ change ].key;
+
+		if ( !( pressed[ key >> 3 ] & (1 << (key & 0x7)) ) )
+			continue;
+		pressed[ key >> 3 ] &= ~(1 << (key & 0x7));
+
+		// USB Key limit reached
+		if ( USBKeys_Sent >= USB_BOOT_MAX_KEYS )
+		{
+			warn_print("USB Key limit reached");
+			break;
+		}
+
+		USBKeys_primary.keys[USBKeys_Sent++] = key;
+		USBKeys_primary.changed |= USBKeyChangeState_MainKeys;
+	}
+}
+
+
+// NKRO mode - Each USB Code has a bit, see USBKeys_NKROLookup
+void USBKeys_applyNKRO( uint8_t key, uint8_t keyPress )
+{
+	// Received 0x00
+	// This is a special USB Code that internally indicates a "break"
+	// It is used to send "nothing" in order to break up sequences of USB Codes
+	if ( key == 0x00 )
+	{
+		USBKeys_primary.changed |= USBKeyChangeState_MainKeys;
+
+		// Also flush out buffers just in case
+		Output_flushBuffers();
+		return;
+	}
+
+	switch ( USBKeys_nkroUpdate( &USBKeys_primary, key, keyPress ) )
+	{
+	// Invalid key
+	case USBKeyChangeState_None:
+		warn_msg("USB Code not within 4-49 (0x4-0x31), 51-155 (0x33-0x9B), 157-164 (0x9D-0xA4), 176-221 (0xB0-0xDD) or 224-231 (0xE0-0xE7) NKRO Mode: ");
+		printHex( key );
+		print( NL );
+		break;
+
+	// Modifiers are not counted
+	case USBKeyChangeState_Modifiers:
+		break;
+
+	default:
+		if ( keyPress )
+		{
+			USBKeys_Sent--;
+		}
+		else // Release
+		{
+			USBKeys_Sent++;
+		}
+		break;
+	}
+}
+
+
+// Applies queued USB Code changes using the current keyboard protocol
+void USBKeys_applyChanges( USBKeyChange *changes, uint8_t count )
+{
+	switch ( USBKeys_Protocol )
+	{
+	case 0: // Boot Mode
+		USBKeys_applyBoot( changes, count );
+		break;
+
+	case 1: // NKRO Mode
+		for ( uint8_t change = 0; change < count; change++ )
+		{
+			USBKeys_applyNKRO( changes[ change ].key, changes[ change ].press );
+		}
+		break;
+	}
+}
+
+
+uint8_t USBKeys_apply()
+{
+	uint8_t count = USBKeys_PendingCount;
+	if ( count == 0 )
+		return 1;
+
+	// Keyboard changes applied by an earlier pass go in their own report, so they are not merged with these
+	if ( USBKeys_primary.changed & USBKeys_KeyboardSections )
+	{
+		if ( USBKeys_ringFull() )
+			return 0;
+
+		USBKeys_reportQueue();
+	}
+
+	// Output_flushBuffers may be called while applying, which also clears the queue
+	USBKeys_PendingCount = 0;
+
+	// A USB Code changing again (e.g. press then release) ends the report before it
+	// Otherwise only the final state would be sent
+	uint8_t touched[ 32 ] = { 0 };
+	uint8_t start = 0;
+	for ( uint8_t change = 0; change < count; change++ )
+	{
+		uint8_t key = USBKeys_Pending[ change ].key;
+
+		if ( touched[ key >> 3 ] & (1 << (key & 0x7)) )
+		{
+			// No room to queue the report, the changes from here on are kept until there is
+			if ( USBKeys_ringFull() )
+			{
+				memmove( USBKeys_Pending, &USBKeys_Pending[ start ], ( count - start ) * sizeof( USBKeyChange ) );
+				USBKeys_PendingCount = count - start;
+				return 0;
+			}
+
+			USBKeys_applyChanges( &USBKeys_Pending[ start ], change - start );
+			USBKeys_reportQueue();
+
+			memset( touched, 0, sizeof( touched ) );
+			start = change;
+		}
+
+		touched[ key >> 3 ] |= 1 << (key & 0x7);
+	}
+
+	USBKeys_applyChanges( &USBKeys_Pending[ start ], count - start );
+	return 1;
+}
+
+
+void USBKeys_queue( uint8_t key, uint8_t press )
+{
+	// Queue is full, apply the changes so far
+	if ( USBKeys_PendingCount >= USB_PENDING_MAX_KEYS )
+		USBKeys_apply();
+
+	// Still full, there is no room to queue the reports of the changes so far
+	if ( USBKeys_PendingCount >= USB_PENDING_MAX_KEYS )
+	{
+		warn_print("USB Code queue full, change dropped");
+		return;
+	}
+
+	USBKeys_Pending[ USBKeys_PendingCount ].key = key;
+	USBKeys_Pending[ USBKeys_PendingCount ].press = press;
+	USBKeys_PendingCount++;
+}
+
+
+uint8_t USBKeys_reportQueue()
+{
+	if ( USBKeys_primary.changed == USBKeyChangeState_None )
+		return 0;
+
+	// Boot Mode Only, unset stale keys
+	if ( USBKeys_Protocol == 0 )
+	{
+		for ( uint8_t c = USBKeys_Sent; c < USB_BOOT_MAX_KEYS; c++ )
+		{
+			USBKeys_primary.keys[c] = 0;
+		}
+	}
+
+	// No room, USBKeys_primary keeps its changes
+	if ( !USBKeys_ringPush( &USBKeys_primary ) )
+		return 0;
+
+	USBKeys_primary.changed = USBKeyChangeState_None;
+	return 1;
+}
+
+
+uint8_t USBKeys_reportCommit()
+{
+	// Nothing to commit, or no room left to keep the report
+	if ( USBKeys_PendingCount == 0 || USBKeys_ringFull() || !USBKeys_apply() )
+		return 0;
+
+	return USBKeys_reportQueue();
+}
+
+
+void USBKeys_reportDiscard()
+{
+	USBKeys_primary.changed = USBKeyChangeState_None;
+
+	while ( USBKeys_RingCount > 0 )
+		USBKeys_ringPop();
+}
+
+
+void USBKeys_setup()
+{
+	memset( &USBKeys_LastSent, 0, sizeof( USBKeysSent ) );
+	USBKeys_reportInvalidate();
+
+	USBKeys_ReportsSent = 0;
+	USBKeys_ReportsSuppressed = 0;
+
+	USBKeys_RingHead = 0;
+	USBKeys_RingCount = 0;
+	USBKeys_RingCollapsed = 0;
+}
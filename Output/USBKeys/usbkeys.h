@@ -0,0 +1,148 @@
+/* Copyright (C) 2017 by Jacob Alexander
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <stdint.h>
+
+// Project Includes
+#include <Lib/mcu_compat.h>
+#include <kll_defs.h>
+#include <output_com.h>
+
+
+
+// ----- Defines -----
+
+#if !defined(USBReportRing_define)
+#define USBReportRing_define 16
+#endif
+
+// Max number of queued USB Code changes, see USBKeys_apply
+#define USB_PENDING_MAX_KEYS 32
+
+// Sections sent in the keyboard report (Boot or NKRO endpoint)
+#define USBKeys_KeyboardSections ( \
+	USBKeyChangeState_Modifiers | \
+	USBKeyChangeState_MainKeys | \
+	USBKeyChangeState_SecondaryKeys | \
+	USBKeyChangeState_TertiaryKeys | \
+	USBKeyChangeState_QuartiaryKeys \
+)
+
+
+
+// ----- Structs -----
+
+// NKRO location of a USB Code
+//  * Bitfield USB Codes - bit of USBKeys.keys, changed is the section
+//  * Modifier USB Codes - bit of USBKeys.modifiers, changed is USBKeyChangeState_Modifiers
+//  * Any other USB Code - changed is USBKeyChangeState_None
+typedef struct USBKeysNKRO {
+	uint8_t position; // byte << 3 | bit
+	uint8_t changed;  // USBKeyChangeState
+} USBKeysNKRO;
+
+// Queued USB Code change
+typedef struct USBKeyChange {
+	uint8_t key;
+	uint8_t press; // 1 - Press, 0 - Release
+} USBKeyChange;
+
+// Last report sent, per endpoint
+// Only the fields of each endpoint's sections are used
+// changed lists the sections that must be sent regardless of contents (e.g. after a flush or dropped packet)
+typedef struct USBKeysSent {
+	USBKeys boot; // Boot keyboard endpoint - modifiers, keys (first USB_BOOT_MAX_KEYS bytes)
+	USBKeys nkro; // NKRO keyboard endpoint - modifiers, keys
+	USBKeys ctrl; // System control endpoint - sys_ctrl, cons_ctrl
+} USBKeysSent;
+
+
+
+// ----- Variables -----
+
+// Indexed by USB Code
+extern const USBKeysNKRO USBKeys_NKROLookup[ 256 ];
+
+extern Instance USBKeysSent USBKeys_LastSent;
+
+// Report counters, suppressed by USBKeys_reportDiff, sent once per packet queued by the Output module
+extern Instance uint32_t USBKeys_ReportsSent;
+extern Instance uint32_t USBKeys_ReportsSuppressed;
+
+// Queued keyboard reports, oldest first, see USBKeys_ringPush
+extern Instance USBKeys  USBKeys_Ring[ USBReportRing_define ];
+extern Instance uint8_t  USBKeys_RingHead;
+extern Instance uint8_t  USBKeys_RingCount;
+extern Instance uint32_t USBKeys_RingCollapsed;
+
+// USB Code changes queued by Output_usbCodeSend_capability, see USBKeys_queue
+extern Instance USBKeyChange USBKeys_Pending[ USB_PENDING_MAX_KEYS ];
+extern Instance uint8_t      USBKeys_PendingCount;
+
+
+
+// ----- Functions -----
+
+// Sets (press) or clears (release) the NKRO bit of a USB Code, and flags its section as changed
+// Returns the changed section, USBKeyChangeState_None if the USB Code has no NKRO bit (USBKeys is untouched)
+USBKeyChangeState USBKeys_nkroUpdate( USBKeys *usbKeys, uint8_t key, uint8_t press );
+
+// Drops the changed sections of usbKeys that match the last report sent on their endpoint
+// The remaining sections are recorded as sent, returns the sections left to send
+USBKeyChangeState USBKeys_reportDiff( USBKeys *usbKeys );
+
+// Forces the next report on every endpoint to be sent
+void USBKeys_reportInvalidate();
+
+// Queues a copy of usbKeys behind the reports already queued
+// A report matching the newest queued report is merged into it (its changed sections are kept)
+// Returns 0 if the ring is full, usbKeys is not queued
+uint8_t USBKeys_ringPush( USBKeys *usbKeys );
+
+// Returns 1 if there is no room left to queue a report
+uint8_t USBKeys_ringFull();
+
+// Oldest queued report, 0 if the ring is empty
+USBKeys *USBKeys_ringFront();
+void USBKeys_ringPop();
+
+// Queues a USB Code change, applied along with the other changes of the processing loop by USBKeys_apply
+// If the queue is full, the changes so far are applied first, the change is dropped if they cannot be
+void USBKeys_queue( uint8_t key, uint8_t press );
+
+// Applies the queued USB Code changes to USBKeys_primary, using the current keyboard protocol
+// A USB Code changing again (e.g. press then release) queues the report before it, see USBKeys_reportQueue
+// Returns 0 if the ring filled up, the changes not applied are left in USBKeys_Pending
+uint8_t USBKeys_apply();
+
+// Queues USBKeys_primary, so later changes during this processing loop do not replace it
+// Returns 0 if nothing has changed, or the ring is full (USBKeys_primary keeps its changes)
+uint8_t USBKeys_reportQueue();
+
+// Applies the queued USB Code changes (USBKeys_apply), and queues the resulting report
+// Returns 0 if no changes were queued, or there is no room left to queue the report
+uint8_t USBKeys_reportCommit();
+
+// Drops USBKeys_primary changes and the queued reports
+void USBKeys_reportDiscard();
+
+void USBKeys_setup();
+
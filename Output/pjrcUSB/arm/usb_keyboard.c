@@ -40,6 +40,7 @@
 // Project Includes
 #include <Lib/OutputLib.h>
 #include <print.h>
+#include <usbkeys.h>
 
 // Local Includes
 #include "usb_dev.h"
@@ -101,6 +102,20 @@ void usb_keyboard_idle_update()
 }
 
 
+// Returns 1 if a keyboard report can be sent without waiting for the endpoints
+uint8_t usb_keyboard_ready()
+{
+	// Not configured, usb_keyboard_send drops the report right away
+	if ( !usb_configuration )
+		return 1;
+
+	uint32_t endpoint = USBKeys_Protocol == 0 ? KEYBOARD_ENDPOINT : NKRO_KEYBOARD_ENDPOINT;
+
+	return usb_tx_packet_count( endpoint ) < TX_PACKET_LIMIT
+		&& usb_tx_packet_count( SYS_CTRL_ENDPOINT ) < TX_PACKET_LIMIT;
+}
+
+
 // Send the contents of keyboard_keys and keyboard_modifier_keys
 void usb_keyboard_send( USBKeys *buffer )
 {
@@ -119,8 +134,9 @@ void usb_keyboard_send( USBKeys *buffer )
 		// Try to wake up the host if it's asleep
 		if ( usb_resume() )
 		{
-			// Drop packet
+			// Drop packet, host may not have the last report
 			buffer->changed = USBKeyChangeState_None;
+			USBKeys_reportInvalidate();
 			return;
 		}
 
@@ -159,6 +175,7 @@ void usb_keyboard_send( USBKeys *buffer )
 		{
 			transmit_previous_timeout = 1;
 			buffer->changed = USBKeyChangeState_None; // Indicate packet lost
+			USBKeys_reportInvalidate();
 			#if enableDeviceRestartOnUSBTimeout == 1
 			warn_print("USB Transmit Timeout...restarting device");
 			usb_device_software_reset();
@@ -196,6 +213,7 @@ void usb_keyboard_send( USBKeys *buffer )
 
 		// Send USB Packet
 		usb_tx( SYS_CTRL_ENDPOINT, tx_packet );
+		USBKeys_ReportsSent++;
 		buffer->changed &= ~USBKeyChangeState_System; // Mark sent
 		return;
 	}
@@ -220,6 +238,7 @@ void usb_keyboard_send( USBKeys *buffer )
 
 		// Send USB Packet
 		usb_tx( SYS_CTRL_ENDPOINT, tx_packet );
+		USBKeys_ReportsSent++;
 		buffer->changed &= ~USBKeyChangeState_Consumer; // Mark sent
 		return;
 	}
@@ -256,6 +275,7 @@ void usb_keyboard_send( USBKeys *buffer )
 
 		// Send USB Packet
 		usb_tx( KEYBOARD_ENDPOINT, tx_packet );
+		USBKeys_ReportsSent++;
 		buffer->changed = USBKeyChangeState_None;
 		break;
 
@@ -319,6 +339,7 @@ void usb_keyboard_send( USBKeys *buffer )
 
 			// Send USB Packet
 			usb_tx( NKRO_KEYBOARD_ENDPOINT, tx_packet );
+			USBKeys_ReportsSent++;
 			buffer->changed = USBKeyChangeState_None; // Mark sent
 		}
 
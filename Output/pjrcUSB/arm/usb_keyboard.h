@@ -44,5 +44,6 @@
 // ----- Functions -----
 
 void usb_keyboard_idle_update();
+uint8_t usb_keyboard_ready();
 void usb_keyboard_send();
 
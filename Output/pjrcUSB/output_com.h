@@ -134,6 +134,19 @@ void Output_periodic();
 
 void Output_flushBuffers();
 
+// Applies the USB Code changes queued during this processing loop to USBKeys_primary
+void Output_usbCodeApply();
+
+// Applies the queued USB Code changes, and queues the resulting keyboard report
+// Returns 0 if no changes were queued, or there is no room left to queue the report
+uint8_t Output_usbCodeCommit();
+
+// Returns 0 while there is no room left to queue keyboard reports, see USBKeys_ringPush
+uint8_t Output_usbReportReady();
+
+// Drops the current and queued keyboard reports
+void Output_usbReportDiscard();
+
 void Output_firmwareReload();
 void Output_softReset();
 
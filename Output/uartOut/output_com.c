@@ -111,6 +111,26 @@ void Output_flashMode_capability( TriggerMacro *trigger, uint8_t state, uint8_t
 
 // ----- Functions -----
 
+// No USB Code changes are queued
+void Output_usbCodeApply()
+{
+}
+
+uint8_t Output_usbCodeCommit()
+{
+	return 0;
+}
+
+uint8_t Output_usbReportReady()
+{
+	return 1;
+}
+
+void Output_usbReportDiscard()
+{
+}
+
+
 // UART Module Setup
 inline void Output_setup()
 {
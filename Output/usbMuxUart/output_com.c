@@ -31,6 +31,7 @@
 #include <led.h>
 #include <print.h>
 #include <scan_loop.h>
+#include <usbkeys.h>
 
 // USB Includes
 #if defined(_avr_at_)
@@ -52,21 +53,6 @@
 
 
 
-// ----- Macros -----
-
-// Used to build a bitmap lookup table from a byte addressable array
-#define byteLookup( byte ) \
-	case (( byte ) * ( 8 )):         bytePosition = byte; byteShift = 0; break; \
-	case (( byte ) * ( 8 ) + ( 1 )): bytePosition = byte; byteShift = 1; break; \
-	case (( byte ) * ( 8 ) + ( 2 )): bytePosition = byte; byteShift = 2; break; \
-	case (( byte ) * ( 8 ) + ( 3 )): bytePosition = byte; byteShift = 3; break; \
-	case (( byte ) * ( 8 ) + ( 4 )): bytePosition = byte; byteShift = 4; break; \
-	case (( byte ) * ( 8 ) + ( 5 )): bytePosition = byte; byteShift = 5; break; \
-	case (( byte ) * ( 8 ) + ( 6 )): bytePosition = byte; byteShift = 6; break; \
-	case (( byte ) * ( 8 ) + ( 7 )): bytePosition = byte; byteShift = 7; break
-
-
-
 // ----- Function Declarations -----
 
 void cliFunc_kbdProtocol( char* args );
@@ -75,6 +61,7 @@ void cliFunc_readLEDs   ( char* args );
 void cliFunc_readUART   ( char* args );
 void cliFunc_sendUART   ( char* args );
 void cliFunc_usbInitTime( char* args );
+void cliFunc_usbReports ( char* args );
 
 
 
@@ -87,6 +74,7 @@ CLIDict_Entry( readLEDs,    "Read LED byte:" NL "\t\t1 NumLck, 2 CapsLck, 4 Scrl
 CLIDict_Entry( readUART,    "Read UART buffer until empty." );
 CLIDict_Entry( sendUART,    "Send characters over UART0." );
 CLIDict_Entry( usbInitTime, "Displays the time in ms from usb_init() till the last setup call." );
+CLIDict_Entry( usbReports,  "Show USB reports sent and suppressed (matching the last report sent)." NL "\t\tAny argument resets the counters." );
 
 CLIDict_Def( outputCLIDict, "USB Module Commands" ) = {
 	CLIDict_Item( kbdProtocol ),
@@ -95,6 +83,7 @@ CLIDict_Def( outputCLIDict, "USB Module Commands" ) = {
 	CLIDict_Item( readUART ),
 	CLIDict_Item( sendUART ),
 	CLIDict_Item( usbInitTime ),
+	CLIDict_Item( usbReports ),
 	{ 0, 0, 0 } // Null entry for dictionary end
 };
 
@@ -106,6 +95,7 @@ USBKeys USBKeys_idle;    // Idle timeout send buffer
 // The number of keys sent to the usb in the array
 uint8_t  USBKeys_Sent    = 0;
 
+
 // 1=num lock, 2=caps lock, 4=scroll lock, 8=compose, 16=kana
 volatile uint8_t  USBKeys_LEDs = 0;
 volatile uint8_t  USBKeys_LEDs_Changed;
@@ -325,6 +315,7 @@ void Output_sysCtrlSend_capability( TriggerMacro *trigger, uint8_t state, uint8_
 
 
 // Adds a single USB Code to the USB Output buffer
+// The change is queued, and applied along with the other changes of the processing loop by Output_usbCodeApply
 // Argument #1: USB Code
 void Output_usbCodeSend_capability( TriggerMacro *trigger, uint8_t state, uint8_t stateType, uint8_t *args )
 {
@@ -348,204 +339,42 @@ void Output_usbCodeSend_capability( TriggerMacro *trigger, uint8_t state, uint8_
 		keyPress = 1;
 
 	// Get the keycode from arguments
-	uint8_t key = args[0];
-
-	// Depending on which mode the keyboard is in, USBKeys_Keys array is used differently
-	// Boot mode - Maximum of 6 byte codes
-	// NKRO mode - Each bit of the 26 byte corresponds to a key
-	//  Bits   0 -  45 (bytes  0 -  5) correspond to USB Codes   4 -  49 (Main)
-	//  Bits  48 - 161 (bytes  6 - 20) correspond to USB Codes  51 - 164 (Secondary)
-	//  Bits 168 - 213 (bytes 21 - 26) correspond to USB Codes 176 - 221 (Tertiary)
-	//  Bits 214 - 216                 unused
-	uint8_t bytePosition = 0;
-	uint8_t byteShift = 0;
-
-	switch ( USBKeys_Protocol )
-	{
-	case 0: // Boot Mode
-		// Set the modifier bit if this key is a modifier
-		if ( (key & 0xE0) == 0xE0 ) // AND with 0xE0 (Left Ctrl, first modifier)
-		{
-			if ( keyPress )
-			{
-				USBKeys_primary.modifiers |= 1 << (key ^ 0xE0); // Left shift 1 by key XOR 0xE0
-			}
-			else // Release
-			{
-				USBKeys_primary.modifiers &= ~(1 << (key ^ 0xE0)); // Left shift 1 by key XOR 0xE0
-			}
-
-			USBKeys_primary.changed |= USBKeyChangeState_Modifiers;
-		}
-		// Normal USB Code
-		else
-		{
-			// Determine if key was set
-			uint8_t keyFound = 0;
-			uint8_t old_sent = USBKeys_Sent;
-
-			for ( uint8_t curkey = 0, newkey = 0; curkey < old_sent; curkey++, newkey++ )
-			{
-				// On press, key already present, don't re-add
-				if ( keyPress && USBKeys_primary.keys[newkey] == key )
-				{
-					keyFound = 1;
-					break;
-				}
-
-				// On release, remove if found
-				if ( !keyPress && USBKeys_primary.keys[newkey] == key )
-				{
-					// Shift next key onto this one
-					// (Doesn't matter if it overflows, buffer is large enough, and size is used)
-					USBKeys_primary.keys[newkey--] = USBKeys_primary.keys[++curkey];
-					USBKeys_Sent--;
-					keyFound = 1;
-					USBKeys_primary.changed = USBKeyChangeState_MainKeys;
-					break;
-				}
-			}
-
-			// USB Key limit reached
-			if ( USBKeys_Sent >= USB_BOOT_MAX_KEYS )
-			{
-				warn_print("USB Key limit reached");
-				break;
-			}
-
-			// Add key if not already found in the buffer
-			if ( keyPress && !keyFound )
-			{
-				USBKeys_primary.keys[USBKeys_Sent++] = key;
-				USBKeys_primary.changed = USBKeyChangeState_MainKeys;
-			}
-		}
-		break;
-
-	case 1: // NKRO Mode
-		// Set the modifier bit if this key is a modifier
-		if ( (key & 0xE0) == 0xE0 ) // AND with 0xE0 (Left Ctrl, first modifier)
-		{
-			if ( keyPress )
-			{
-				USBKeys_primary.modifiers |= 1 << (key ^ 0xE0); // Left shift 1 by key XOR 0xE0
-			}
-			else // Release
-			{
-				USBKeys_primary.modifiers &= ~(1 << (key ^ 0xE0)); // Left shift 1 by key XOR 0xE0
-			}
+	USBKeys_queue( args[0], keyPress );
+#endif
+}
 
-			USBKeys_primary.changed |= USBKeyChangeState_Modifiers;
-			break;
-		}
-		// First 6 bytes
-		else if ( key >= 4 && key <= 49 )
-		{
-			// Lookup (otherwise division or multiple checks are needed to do alignment)
-			// Starting at 0th position, each byte has 8 bits, starting at 4th bit
-			uint8_t keyPos = key + (0 * 8 - 4); // Starting position in array, Ignoring 4 keys
-			switch ( keyPos )
-			{
-				byteLookup( 0 );
-				byteLookup( 1 );
-				byteLookup( 2 );
-				byteLookup( 3 );
-				byteLookup( 4 );
-				byteLookup( 5 );
-			}
 
-			USBKeys_primary.changed |= USBKeyChangeState_MainKeys;
-		}
-		// Next 14 bytes
-		else if ( key >= 51 && key <= 155 )
-		{
-			// Lookup (otherwise division or multiple checks are needed to do alignment)
-			// Starting at 6th byte position, each byte has 8 bits, starting at 51st bit
-			uint8_t keyPos = key + (6 * 8 - 51); // Starting position in array
-			switch ( keyPos )
-			{
-				byteLookup( 6 );
-				byteLookup( 7 );
-				byteLookup( 8 );
-				byteLookup( 9 );
-				byteLookup( 10 );
-				byteLookup( 11 );
-				byteLookup( 12 );
-				byteLookup( 13 );
-				byteLookup( 14 );
-				byteLookup( 15 );
-				byteLookup( 16 );
-				byteLookup( 17 );
-				byteLookup( 18 );
-				byteLookup( 19 );
-			}
+void Output_usbCodeApply()
+{
+#if enableKeyboard_define == 1
+	USBKeys_apply();
+#endif
+}
 
-			USBKeys_primary.changed |= USBKeyChangeState_SecondaryKeys;
-		}
-		// Next byte
-		else if ( key >= 157 && key <= 164 )
-		{
-			// Lookup (otherwise division or multiple checks are needed to do alignment)
-			uint8_t keyPos = key + (20 * 8 - 157); // Starting position in array, Ignoring 6 keys
-			switch ( keyPos )
-			{
-				byteLookup( 20 );
-			}
 
-			USBKeys_primary.changed |= USBKeyChangeState_TertiaryKeys;
-		}
-		// Last 6 bytes
-		else if ( key >= 176 && key <= 221 )
-		{
-			// Lookup (otherwise division or multiple checks are needed to do alignment)
-			uint8_t keyPos = key + (21 * 8 - 176); // Starting position in array
-			switch ( keyPos )
-			{
-				byteLookup( 21 );
-				byteLookup( 22 );
-				byteLookup( 23 );
-				byteLookup( 24 );
-				byteLookup( 25 );
-				byteLookup( 26 );
-			}
+uint8_t Output_usbCodeCommit()
+{
+#if enableKeyboard_define == 1
+	return USBKeys_reportCommit();
+#else
+	return 0;
+#endif
+}
 
-			USBKeys_primary.changed |= USBKeyChangeState_QuartiaryKeys;
-		}
-		// Received 0x00
-		// This is a special USB Code that internally indicates a "break"
-		// It is used to send "nothing" in order to break up sequences of USB Codes
-		else if ( key == 0x00 )
-		{
-			USBKeys_primary.changed |= USBKeyChangeState_MainKeys;
 
-			// Also flush out buffers just in case
-			Output_flushBuffers();
-			break;
-		}
-		// Invalid key
-		else
-		{
-			warn_msg("USB Code not within 4-49 (0x4-0x31), 51-155 (0x33-0x9B), 157-164 (0x9D-0xA4), 176-221 (0xB0-0xDD) or 224-231 (0xE0-0xE7) NKRO Mode: ");
-			printHex( key );
-			print( NL );
-			break;
-		}
+uint8_t Output_usbReportReady()
+{
+#if enableKeyboard_define == 1
+	return !USBKeys_ringFull();
+#else
+	return 1;
+#endif
+}
 
-		// Set/Unset
-		if ( keyPress )
-		{
-			USBKeys_primary.keys[bytePosition] |= (1 << byteShift);
-			USBKeys_Sent--;
-		}
-		else // Release
-		{
-			USBKeys_primary.keys[bytePosition] &= ~(1 << byteShift);
-			USBKeys_Sent++;
-		}
 
-		break;
-	}
-#endif
+void Output_usbReportDiscard()
+{
+	USBKeys_reportDiscard();
 }
 
 void Output_flashMode_capability( TriggerMacro *trigger, uint8_t state, uint8_t stateType, uint8_t *args )
@@ -634,6 +463,12 @@ void Output_flushBuffers()
 	// Reset USBKeys_Keys size
 	USBKeys_Sent = 0;
 
+	// Drop any queued USB Code changes
+	USBKeys_PendingCount = 0;
+
+	// Send the next reports even if they match the last ones sent
+	USBKeys_reportInvalidate();
+
 	// Set USBKeys_LEDs_Changed to indicate that we should update LED status
 	USBKeys_LEDs_Changed = 1;
 }
@@ -654,6 +489,9 @@ inline void Output_setup()
 	// Register USB Output CLI dictionary
 	CLI_registerDictionary( outputCLIDict, outputCLIDictName );
 
+	// Setup report tracking
+	USBKeys_setup();
+
 	// Flush key buffers
 	Output_flushBuffers();
 
@@ -712,18 +550,52 @@ inline void Output_periodic()
 #endif
 
 #if enableKeyboard_define == 1
-	// Boot Mode Only, unset stale keys
-	if ( USBKeys_Protocol == 0 )
+	// Apply USB Code changes queued outside of macro processing (e.g. from the CLI)
+	Output_usbCodeApply();
+
+	// Reports are still waiting for the endpoints, the current report goes behind them
+	// If the ring is full, USBKeys_primary keeps its changes (and no new ones are applied) until there is room
+	if ( USBKeys_RingCount > 0 )
+	{
+		USBKeys_reportQueue();
+	}
+
+	// Send the queued reports in order, as many as the endpoints currently have room for
+	while ( USBKeys_RingCount > 0 && usb_keyboard_ready() )
 	{
-		for ( uint8_t c = USBKeys_Sent; c < USB_BOOT_MAX_KEYS; c++ )
+		USBKeys *report = USBKeys_ringFront();
+
+		// Drop reports matching the last ones sent, the remaining sections are sent together per report
+		USBKeys_reportDiff( report );
+		while ( report->changed )
+			usb_keyboard_send( report );
+
+		USBKeys_ringPop();
+	}
+
+	// Reports are still waiting, the current report must not be sent ahead of them
+	if ( USBKeys_RingCount > 0 )
+	{
+		USBKeys_reportQueue();
+	}
+	else
+	{
+		// Boot Mode Only, unset stale keys
+		if ( USBKeys_Protocol == 0 )
 		{
-			USBKeys_primary.keys[c] = 0;
+			for ( uint8_t c = USBKeys_Sent; c < USB_BOOT_MAX_KEYS; c++ )
+			{
+				USBKeys_primary.keys[c] = 0;
+			}
 		}
-	}
 
-	// Send keypresses while there are pending changes
-	while ( USBKeys_Changed )
-		usb_keyboard_send( &USBKeys_primary );
+		// Drop reports matching the last ones sent, the remaining sections are sent together per report
+		USBKeys_reportDiff( &USBKeys_primary );
+
+		// Send keypresses while there are pending changes
+		while ( USBKeys_primary.changed )
+			usb_keyboard_send( &USBKeys_primary );
+	}
 
 	// Signal Scan Module we are finished
 	switch ( USBKeys_Protocol )
@@ -962,3 +834,27 @@ void cliFunc_usbInitTime( char* args )
 	print(" ticks");
 }
 
+
+void cliFunc_usbReports( char* args )
+{
+	// Parse number from argument
+	//  NOTE: Only first argument is used
+	char* arg1Ptr;
+	char* arg2Ptr;
+	CLI_argumentIsolation( args, &arg1Ptr, &arg2Ptr );
+
+	// Reset counters if an argument is given
+	if ( arg1Ptr[0] != '\0' )
+	{
+		USBKeys_ReportsSent = 0;
+		USBKeys_ReportsSuppressed = 0;
+	}
+
+	print( NL );
+	info_msg("Reports Sent: ");
+	printInt32( USBKeys_ReportsSent );
+	print( NL );
+	info_msg("Reports Suppressed: ");
+	printInt32( USBKeys_ReportsSuppressed );
+}
+
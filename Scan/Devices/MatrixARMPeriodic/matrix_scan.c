@@ -23,6 +23,9 @@
 
 // Compiler Includes
 #include <Lib/ScanLib.h>
+#if defined(_host_)
+#include <Lib/kinetis.h> // GPIO registers, see the host GPIO model in Lib/host.c
+#endif
 
 // Project Includes
 #include <cli.h>
@@ -48,6 +51,15 @@
 #define STROBE_DELAY StrobeDelay_define
 #endif
 
+// Diode-less matrix, either from KLL or matrix.h
+#if GhostingMatrix_define == 1 && !defined( GHOSTING_MATRIX )
+#define GHOSTING_MATRIX
+#endif
+
+#if defined( GHOSTING_MATRIX ) && DebounceMode_define == DebounceMode_Vertical
+#error "GhostingMatrix requires the continuous debounce (DebounceMode 0)"
+#endif
+
 
 
 // ----- Function Declarations -----
@@ -73,8 +85,31 @@ CLIDict_Def( matrixCLIDict, "Matrix Module Commands" ) = {
 	{ 0, 0, 0 } // Null entry for dictionary end
 };
 
+#if DebounceMode_define == DebounceMode_Vertical
+// Debounce Array, per strobe
+static volatile StrobeState Matrix_strobeArray[ Matrix_colsNum ];
+
+// Time of the last state change, per key
+static volatile uint32_t Matrix_changeTime[ Matrix_colsNum * Matrix_rowsNum ];
+#else
 // Debounce Array
 static volatile KeyState Matrix_scanArray[ Matrix_colsNum * Matrix_rowsNum ];
+#endif
+
+#ifdef GHOSTING_MATRIX
+// Ghost cancelation, see Matrix_ghostScan
+static KeyGhost Matrix_ghostArray[ Matrix_colsNum * Matrix_rowsNum ];
+
+static uint8_t col_use[Matrix_colsNum], row_use[Matrix_rowsNum];  // used count, updated on key transitions
+static uint8_t col_ghost[Matrix_colsNum], row_ghost[Matrix_rowsNum];  // marked as having ghost if 1
+static uint8_t col_ghost_old[Matrix_colsNum], row_ghost_old[Matrix_rowsNum];  // old ghost state
+static uint8_t col_ghosted[Matrix_colsNum], row_ghosted[Matrix_rowsNum];  // ghost or old ghost, as of the last scan
+static uint8_t col_check[Matrix_colsNum], row_check[Matrix_rowsNum];  // ghost mark must be recomputed if 1
+
+// Keys that turned on or off since the last ghost check
+static uint16_t ghost_changed[Matrix_colsNum * Matrix_rowsNum];
+static uint16_t ghost_changedNum;
+#endif
 
 
 // Matrix debug flag - If set to 1, for each keypress the scan code is displayed in hex
@@ -88,8 +123,9 @@ static volatile uint16_t matrixDebugStateCounter;
 // Matrix Current Strobe
 static volatile uint8_t matrixCurrentStrobe;
 
-// System Timer used for delaying debounce decisions
-extern volatile uint32_t systick_millis_count;
+// Sense lines grouped by GPIO port, see Matrix_senseSetup
+static SenseRun Matrix_senseRuns[ Matrix_rowsNum ];
+static uint8_t  Matrix_senseRunsNum;
 
 // Latency tracking
 static volatile uint8_t matrixLatencyResource;
@@ -98,37 +134,64 @@ static volatile uint8_t matrixLatencyResource;
 
 // ----- Functions -----
 
+// Read the input register of a whole GPIO port
+static inline uint32_t Matrix_portInput( Port port )
+{
+#if defined(_host_)
+	// Host GPIO model, see Lib/host.c
+	return Host_gpioInput( port );
+#else
+	// Assumes 0x40 between GPIO Port registers
+	return *( (volatile unsigned int*)(&GPIOA_PDIR) + port * 0x40 / sizeof(unsigned int) );
+#endif
+}
+
 // Pin action (Strobe, Sense, Strobe Setup, Sense Setup)
 // NOTE: This function is highly dependent upon the organization of the register map
 //       Only guaranteed to work with Freescale Kinetis MCUs
 uint8_t Matrix_pin( GPIO_Pin gpio, Type type )
 {
-	// Register width is defined as size of a pointer
-	unsigned int gpio_offset = gpio.port * 0x40   / sizeof(unsigned int*);
-	unsigned int port_offset = gpio.port * 0x1000 / sizeof(unsigned int*) + gpio.pin;
+	// Offsets are in registers
+	unsigned int gpio_offset = gpio.port * 0x40   / sizeof(unsigned int);
+	unsigned int port_offset = gpio.port * 0x1000 / sizeof(unsigned int) + gpio.pin;
 
 	// Assumes 0x40 between GPIO Port registers and 0x1000 between PORT pin registers
 	// See Lib/kinetis.h
 	volatile unsigned int *GPIO_PDDR = (unsigned int*)(&GPIOA_PDDR) + gpio_offset;
+#ifndef GHOSTING_MATRIX
 	volatile unsigned int *GPIO_PSOR = (unsigned int*)(&GPIOA_PSOR) + gpio_offset;
+#endif
 	volatile unsigned int *GPIO_PCOR = (unsigned int*)(&GPIOA_PCOR) + gpio_offset;
-	volatile unsigned int *GPIO_PDIR = (unsigned int*)(&GPIOA_PDIR) + gpio_offset;
 	volatile unsigned int *PORT_PCR  = (unsigned int*)(&PORTA_PCR0) + port_offset;
 
 	// Operation depends on Type
 	switch ( type )
 	{
 	case Type_StrobeOn:
+#ifdef GHOSTING_MATRIX
+		*GPIO_PCOR |= (1 << gpio.pin);
+		*GPIO_PDDR |= (1 << gpio.pin);  // output, low
+#else
 		*GPIO_PSOR |= (1 << gpio.pin);
+#endif
 		break;
 
 	case Type_StrobeOff:
+#ifdef GHOSTING_MATRIX
+		// Ghosting matrix needs to put not used (off) strobes in high impedance state
+		*GPIO_PDDR &= ~(1 << gpio.pin);  // input, high Z state
+#endif
 		*GPIO_PCOR |= (1 << gpio.pin);
 		break;
 
 	case Type_StrobeSetup:
+#ifdef GHOSTING_MATRIX
+		*GPIO_PDDR &= ~(1 << gpio.pin);  // input, high Z state
+		*GPIO_PCOR |= (1 << gpio.pin);
+#else
 		// Set as output pin
 		*GPIO_PDDR |= (1 << gpio.pin);
+#endif
 
 		// Configure pin with slow slew, high drive strength and GPIO mux
 		*PORT_PCR = PORT_PCR_SRE | PORT_PCR_DSE | PORT_PCR_MUX(1);
@@ -147,7 +210,11 @@ uint8_t Matrix_pin( GPIO_Pin gpio, Type type )
 		break;
 
 	case Type_Sense:
-		return *GPIO_PDIR & (1 << gpio.pin) ? 1 : 0;
+#ifdef GHOSTING_MATRIX // inverted
+		return Matrix_portInput( gpio.port ) & (1 << gpio.pin) ? 0 : 1;
+#else
+		return Matrix_portInput( gpio.port ) & (1 << gpio.pin) ? 1 : 0;
+#endif
 
 	case Type_SenseSetup:
 		// Set as input pin
@@ -178,6 +245,72 @@ uint8_t Matrix_pin( GPIO_Pin gpio, Type type )
 }
 
 
+// Group the sense lines by GPIO port
+// Sense lines sharing a port are gathered from a single read of the port, one shift and mask per run
+void Matrix_senseSetup()
+{
+	Matrix_senseRunsNum = 0;
+
+	for ( uint8_t port = Port_A; port <= Port_E; port++ )
+	{
+		uint8_t first = Matrix_senseRunsNum;
+
+		for ( uint8_t sense = 0; sense < Matrix_rowsNum; sense++ )
+		{
+			if ( Matrix_rows[ sense ].port != port )
+			{
+				continue;
+			}
+
+			// Add to the run of this port with the same offset, if there is one
+			int8_t shift = Matrix_rows[ sense ].pin - sense;
+			uint8_t run = first;
+			while ( run < Matrix_senseRunsNum && Matrix_senseRuns[ run ].shift != shift )
+			{
+				run++;
+			}
+
+			// New run
+			if ( run == Matrix_senseRunsNum )
+			{
+				Matrix_senseRuns[ run ].port  = port;
+				Matrix_senseRuns[ run ].read  = run == first;
+				Matrix_senseRuns[ run ].shift = shift;
+				Matrix_senseRuns[ run ].mask  = 0;
+				Matrix_senseRunsNum++;
+			}
+
+			Matrix_senseRuns[ run ].mask |= (SenseMask)1 << sense;
+		}
+	}
+}
+
+// Read every sense line of the current strobe, one bit per sense line
+// One register read per GPIO port
+SenseMask Matrix_senseRead()
+{
+	SenseMask sample = 0;
+	uint32_t input = 0;
+
+	for ( uint8_t item = 0; item < Matrix_senseRunsNum; item++ )
+	{
+		SenseRun *run = &Matrix_senseRuns[ item ];
+
+		if ( run->read )
+		{
+			input = Matrix_portInput( run->port );
+#ifdef GHOSTING_MATRIX // inverted
+			input = ~input;
+#endif
+		}
+
+		sample |= ( run->shift >= 0 ? input >> run->shift : input << -run->shift ) & run->mask;
+	}
+
+	return sample;
+}
+
+
 // Setup GPIO pins for matrix scanning
 void Matrix_setup()
 {
@@ -195,8 +328,34 @@ void Matrix_setup()
 	{
 		Matrix_pin( Matrix_rows[ pin ], Type_SenseSetup );
 	}
+	Matrix_senseSetup();
 
 	// Clear out Debounce Array
+#if DebounceMode_define == DebounceMode_Vertical
+	for ( uint8_t strobe = 0; strobe < Matrix_colsNum; strobe++ )
+	{
+		Matrix_strobeArray[ strobe ].state = 0;
+		for ( uint8_t plane = 0; plane < DebouncePlanes; plane++ )
+		{
+			Matrix_strobeArray[ strobe ].count[ plane ] = 0;
+		}
+
+		// Only scan sense lines with a ScanCode
+		Matrix_strobeArray[ strobe ].valid = 0;
+		for ( uint8_t sense = 0; sense < Matrix_rowsNum; sense++ )
+		{
+			if ( Matrix_colsNum * sense + strobe + 1 <= MaxScanCode_KLL )
+			{
+				Matrix_strobeArray[ strobe ].valid |= (SenseMask)1 << sense;
+			}
+		}
+	}
+
+	for ( uint16_t item = 0; item < Matrix_maxKeys; item++ )
+	{
+		Matrix_changeTime[ item ] = 0;
+	}
+#else
 	for ( uint8_t item = 0; item < Matrix_maxKeys; item++ )
 	{
 		Matrix_scanArray[ item ].prevState        = KeyState_Off;
@@ -205,6 +364,32 @@ void Matrix_setup()
 		Matrix_scanArray[ item ].inactiveCount    = DebounceDivThreshold; // Start at 'off' steady state
 		Matrix_scanArray[ item ].prevDecisionTime = 0;
 	}
+#endif
+
+#ifdef GHOSTING_MATRIX
+	for ( uint8_t col = 0; col < Matrix_colsNum; col++ )
+	{
+		col_use[col] = 0;
+		col_ghost[col] = 0;
+		col_ghost_old[col] = 0;
+		col_ghosted[col] = 0;
+		col_check[col] = 0;
+	}
+	for ( uint8_t row = 0; row < Matrix_rowsNum; row++ )
+	{
+		row_use[row] = 0;
+		row_ghost[row] = 0;
+		row_ghost_old[row] = 0;
+		row_ghosted[row] = 0;
+		row_check[row] = 0;
+	}
+	for ( uint16_t item = 0; item < Matrix_maxKeys; item++ )
+	{
+		Matrix_ghostArray[ item ].cur   = 0;
+		Matrix_ghostArray[ item ].saved = 0;
+	}
+	ghost_changedNum = 0;
+#endif
 
 	// Reset strobe position
 	matrixCurrentStrobe = 0;
@@ -256,6 +441,276 @@ inline uint8_t Matrix_totalColumns()
 	return Matrix_colsNum;
 }
 
+// Number of sense rows
+inline uint8_t Matrix_totalRows()
+{
+	return Matrix_rowsNum;
+}
+
+
+#ifdef GHOSTING_MATRIX
+// Updates the row and column use counts after a key turned on or off
+// The ghost marks of the key's row and column, and of every row and column sharing a pressed key
+// with them, may change
+void Matrix_ghostTransition( uint8_t col, uint8_t row, uint8_t on )
+{
+	col_use[col] += on ? 1 : -1;
+	row_use[row] += on ? 1 : -1;
+
+	col_check[col] = 1;
+	row_check[row] = 1;
+	for ( uint8_t y = 0; y < Matrix_rowsNum; y++ )
+	{
+		if ( keyOn(Matrix_scanArray[ Matrix_colsNum * y + col ].curState) )
+			row_check[y] = 1;
+	}
+	for ( uint8_t x = 0; x < Matrix_colsNum; x++ )
+	{
+		if ( keyOn(Matrix_scanArray[ Matrix_colsNum * row + x ].curState) )
+			col_check[x] = 1;
+	}
+
+	ghost_changed[ ghost_changedNum++ ] = Matrix_colsNum * row + col;
+}
+
+
+// Column has ghost if a pressed key in it also has another key pressed in its row and column
+uint8_t Matrix_ghostCol( uint8_t col )
+{
+	if ( col_use[col] < 2 )
+		return 0;
+
+	for ( uint8_t row = 0; row < Matrix_rowsNum; row++ )
+	{
+		if ( keyOn(Matrix_scanArray[ Matrix_colsNum * row + col ].curState) && row_use[row] >= 2 )
+			return 1;
+	}
+	return 0;
+}
+
+
+// Row has ghost if a pressed key in it also has another key pressed in its row and column
+uint8_t Matrix_ghostRow( uint8_t row )
+{
+	if ( row_use[row] < 2 )
+		return 0;
+
+	for ( uint8_t col = 0; col < Matrix_colsNum; col++ )
+	{
+		if ( keyOn(Matrix_scanArray[ Matrix_colsNum * row + col ].curState) && col_use[col] >= 2 )
+			return 1;
+	}
+	return 0;
+}
+
+
+// Sends the key to the macro module if its state, after ghost cancelation, has changed
+void Matrix_ghostSend( uint8_t col, uint8_t row )
+{
+	uint16_t key = Matrix_colsNum * row + col;
+	uint16_t key_disp = key + 1;
+	KeyGhost *st = &Matrix_ghostArray[ key ];
+	uint8_t on = keyOn(Matrix_scanArray[ key ].curState);
+
+	// Check bounds
+	if ( key_disp > MaxScanCode_KLL )
+		return;
+
+	// col or row is ghosting (crossed)
+	uint8_t ghost = col_ghosted[col] || row_ghosted[row];
+
+	// save state if no ghost or outside ghosted area
+	if ( !ghost )
+		st->saved = on;
+
+	// use saved state if ghosting, or current if not
+	on = ghost ? st->saved : on;
+	if ( on == st->cur )
+		return;
+	st->cur = on;
+
+	// Send keystate to macro module, only Press and Release (Hold is synthesized by the macro module)
+	Macro_keyState( key_disp, on ? KeyState_Press : KeyState_Release );
+}
+
+
+// Matrix ghosting check and elimination, once the whole matrix has been scanned
+// Use counts are kept up to date on key transitions (see Matrix_ghostTransition)
+// Only the ghost marks of rows and columns affected by those transitions are recomputed
+void Matrix_ghostScan()
+{
+	// strobe = column, sense = row
+
+	// Keep the previous ghost marks
+	for ( uint8_t col = 0; col < Matrix_colsNum; col++ )
+		col_ghost_old[col] = col_ghost[col];
+	for ( uint8_t row = 0; row < Matrix_rowsNum; row++ )
+		row_ghost_old[row] = row_ghost[row];
+
+	// Check if matrix has ghost
+	// Happens when key is pressed and some other key is pressed in same row and another in same column
+	for ( uint8_t col = 0; col < Matrix_colsNum; col++ )
+	{
+		if ( col_check[col] )
+		{
+			col_ghost[col] = Matrix_ghostCol( col );
+			col_check[col] = 0;
+		}
+	}
+	for ( uint8_t row = 0; row < Matrix_rowsNum; row++ )
+	{
+		if ( row_check[row] )
+		{
+			row_ghost[row] = Matrix_ghostRow( row );
+			row_check[row] = 0;
+		}
+	}
+
+	// Ghosting rows and columns (including the previous scan), note those that stopped
+	uint8_t col_cleared[Matrix_colsNum];
+	uint8_t row_cleared[Matrix_rowsNum];
+	for ( uint8_t col = 0; col < Matrix_colsNum; col++ )
+	{
+		uint8_t ghost = col_ghost[col] || col_ghost_old[col];
+		col_cleared[col] = col_ghosted[col] && !ghost;
+		col_ghosted[col] = ghost;
+	}
+	for ( uint8_t row = 0; row < Matrix_rowsNum; row++ )
+	{
+		uint8_t ghost = row_ghost[row] || row_ghost_old[row];
+		row_cleared[row] = row_ghosted[row] && !ghost;
+		row_ghosted[row] = ghost;
+	}
+
+	// Send keys
+	// Keys that changed state, and keys of rows and columns that stopped ghosting
+	for ( uint16_t change = 0; change < ghost_changedNum; change++ )
+	{
+		uint16_t key = ghost_changed[change];
+		Matrix_ghostSend( key % Matrix_colsNum, key / Matrix_colsNum );
+	}
+	ghost_changedNum = 0;
+
+	for ( uint8_t col = 0; col < Matrix_colsNum; col++ )
+	{
+		if ( !col_cleared[col] )
+			continue;
+
+		for ( uint8_t row = 0; row < Matrix_rowsNum; row++ )
+			Matrix_ghostSend( col, row );
+	}
+	for ( uint8_t row = 0; row < Matrix_rowsNum; row++ )
+	{
+		if ( !row_cleared[row] )
+			continue;
+
+		for ( uint8_t col = 0; col < Matrix_colsNum; col++ )
+			Matrix_ghostSend( col, row );
+	}
+}
+#endif
+
+
+#if DebounceMode_define == DebounceMode_Vertical
+// Debounce every sense line of the strobe at once
+// Each sense line has a vertical counter (one bit per plane), counting scans that differ from the debounced state
+// The counter is cleared whenever the sense line matches the debounced state
+// After DebounceSamples differing scans in a row, the debounced state changes
+// (if MinDebounceTime has passed since the last change of the key)
+void Matrix_strobeDebounce( uint8_t strobe, uint32_t currentTime )
+{
+	volatile StrobeState *strobeState = &Matrix_strobeArray[ strobe ];
+
+	// Read the sense lines
+	SenseMask sample = Matrix_senseRead() & strobeState->valid;
+
+	// Sense lines differing from the debounced state
+	SenseMask state = strobeState->state;
+	SenseMask delta = sample ^ state;
+
+	// Sense lines that have already differed DebounceSamples - 1 times
+	SenseMask full = delta;
+	for ( uint8_t plane = 0; plane < DebouncePlanes; plane++ )
+	{
+		SenseMask count = strobeState->count[ plane ];
+		full &= ( DebounceSamples_define - 1 ) >> plane & 1 ? count : ~count;
+	}
+
+	// Hold back changes until MinDebounceTime has passed since the last change of the key
+	SenseMask changed = full;
+	for ( SenseMask pending = full; pending; pending &= pending - 1 )
+	{
+		uint8_t sense = __builtin_ctz( pending );
+		uint16_t key = Matrix_colsNum * sense + strobe;
+
+		if ( currentTime - Matrix_changeTime[ key ] < MinDebounceTime_define )
+		{
+			changed &= ~( (SenseMask)1 << sense );
+			continue;
+		}
+
+		Matrix_changeTime[ key ] = currentTime;
+	}
+
+	// Increment the counters of the differing sense lines, held back changes keep their count
+	// Everything else, including the changed sense lines, is cleared
+	SenseMask increment = delta & ~full;
+	SenseMask keep = full & ~changed;
+	SenseMask carry = increment;
+	for ( uint8_t plane = 0; plane < DebouncePlanes; plane++ )
+	{
+		SenseMask count = strobeState->count[ plane ];
+		strobeState->count[ plane ] = ( ( count ^ carry ) & increment ) | ( count & keep );
+		carry &= count;
+	}
+
+	state ^= changed;
+	strobeState->state = state;
+
+	// Send changed and held keys to the macro module, keys that stay off are skipped
+	// Only changed keys are sent when edge reporting
+#if EdgeReporting_define == 1
+	for ( SenseMask active = changed; active; active &= active - 1 )
+#else
+	for ( SenseMask active = state | changed; active; active &= active - 1 )
+#endif
+	{
+		uint8_t sense = __builtin_ctz( active );
+		SenseMask bit = (SenseMask)1 << sense;
+		uint16_t key_disp = Matrix_colsNum * sense + strobe + 1; // 1-indexed for reporting purposes
+
+		KeyPosition keyState = KeyState_Hold;
+		if ( changed & bit )
+		{
+			keyState = state & bit ? KeyState_Press : KeyState_Release;
+		}
+
+		// Send keystate to macro module
+		Macro_keyState( key_disp, keyState );
+
+		// Matrix Debug, only if there is a state change
+		if ( matrixDebugMode && keyState != KeyState_Hold )
+		{
+			// Basic debug output
+			if ( matrixDebugMode == 1 && keyState == KeyState_Press )
+			{
+				printInt16( key_disp );
+				print(":");
+				printHex( key_disp );
+				print(" ");
+			}
+			// State transition debug output
+			else if ( matrixDebugMode >= 2 )
+			{
+				printInt16( key_disp );
+				Matrix_keyPositionDebug( keyState );
+				print(" ");
+			}
+		}
+	}
+}
+#endif
+
 
 // Single strobe matrix scan
 // Only goes through a single strobe
@@ -278,11 +733,18 @@ uint8_t Matrix_single_scan()
 
 	// Used to allow the strobe signal to propagate, generally not required
 	#ifdef STROBE_DELAY
-	start = micros();
+	uint32_t start = micros();
 	while ((micros() - start) < STROBE_DELAY);
 	#endif
 
 
+#if DebounceMode_define == DebounceMode_Vertical
+	// Debounce the whole strobe
+	Matrix_strobeDebounce( strobe, currentTime );
+#else
+	// Read the sense lines
+	SenseMask sample = Matrix_senseRead();
+
 	// Scan each of the sense pins
 	for ( uint8_t sense = 0; sense < Matrix_rowsNum; sense++ )
 	{
@@ -304,7 +766,7 @@ uint8_t Matrix_single_scan()
 		// Somewhat longer with switch bounciness
 		// The advantage of this is that the count is ongoing and never needs to be reset
 		// State still needs to be kept track of to deal with what to send to the Macro module
-		if ( Matrix_pin( Matrix_rows[ sense ], Type_Sense ) )
+		if ( sample & ( (SenseMask)1 << sense ) )
 		{
 			// Only update if not going to wrap around
 			if ( state->activeCount < DebounceDivThreshold ) state->activeCount += 1;
@@ -389,8 +851,21 @@ uint8_t Matrix_single_scan()
 		// Update decision time
 		state->prevDecisionTime = currentTime;
 
+#ifdef GHOSTING_MATRIX
+		// Update the row and column use on key transitions
+		// Keys are sent once the whole matrix has been scanned, see Matrix_ghostScan
+		if ( keyOn( state->curState ) != keyOn( state->prevState ) )
+		{
+			Matrix_ghostTransition( strobe, sense, keyOn( state->curState ) );
+		}
+#else
 		// Send keystate to macro module
+#if EdgeReporting_define == 1
+		// Only Press and Release, the macro module keeps track of held keys
+		if ( state->curState == KeyState_Press || state->curState == KeyState_Release )
+#endif
 		Macro_keyState( key_disp, state->curState );
+#endif
 
 		// Matrix Debug, only if there is a state change
 		if ( matrixDebugMode && state->curState != state->prevState )
@@ -429,6 +904,7 @@ uint8_t Matrix_single_scan()
 
 		}
 	}
+#endif
 
 	// Unstrobe Pin
 	Matrix_pin( Matrix_cols[ strobe ], Type_StrobeOff );
@@ -444,6 +920,33 @@ uint8_t Matrix_single_scan()
 		matrixDebugStateCounter--;
 
 		// Display the state info for each key
+#if DebounceMode_define == DebounceMode_Vertical
+		print("<key>:<current state> <vertical count>");
+		for ( uint8_t key = 0; key < Matrix_maxKeys; key++ )
+		{
+			// Every 5 keys, put a newline
+			if ( key % 5 == 0 )
+				print( NL );
+
+			volatile StrobeState *strobeState = &Matrix_strobeArray[ key % Matrix_colsNum ];
+			uint8_t sense = key / Matrix_colsNum;
+
+			print("\033[1m");
+			printInt16( key + 1 );
+			print("\033[0m");
+			print(":");
+			uint8_t count = 0;
+			for ( uint8_t plane = 0; plane < DebouncePlanes; plane++ )
+			{
+				count |= ( strobeState->count[ plane ] >> sense & 1 ) << plane;
+			}
+
+			Matrix_keyPositionDebug( strobeState->state >> sense & 1 ? KeyState_Hold : KeyState_Off );
+			print(" ");
+			printInt8( count );
+			print(" ");
+		}
+#else
 		print("<key>:<previous state><current state> <active count> <inactive count>");
 		for ( uint8_t key = 0; key < Matrix_maxKeys; key++ )
 		{
@@ -463,6 +966,7 @@ uint8_t Matrix_single_scan()
 			printHex_op( Matrix_scanArray[ key ].inactiveCount, 2 );
 			print(" ");
 		}
+#endif
 
 		print( NL );
 	}
@@ -472,6 +976,9 @@ uint8_t Matrix_single_scan()
 	if ( ++matrixCurrentStrobe >= Matrix_colsNum )
 	{
 		matrixCurrentStrobe = 0;
+#ifdef GHOSTING_MATRIX
+		Matrix_ghostScan();
+#endif
 		return 1;
 	}
 
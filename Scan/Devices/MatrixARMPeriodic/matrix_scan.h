@@ -33,6 +33,27 @@
 #define DebounceCounter uint8_t
 #define DebounceDivThreshold 0xFF
 
+// Debounce algorithms, see capabilities.kll
+#define DebounceMode_Continuous 0
+#define DebounceMode_Vertical   1
+
+// Vertical counter bit planes, enough to count DebounceSamples
+#if DebounceMode_define == DebounceMode_Vertical
+#if   ( DebounceSamples_define < 1 )
+#error "DebounceSamples is a minimum of 1"
+#elif ( DebounceSamples_define <= 2 )
+#define DebouncePlanes 1
+#elif ( DebounceSamples_define <= 4 )
+#define DebouncePlanes 2
+#elif ( DebounceSamples_define <= 8 )
+#define DebouncePlanes 3
+#elif ( DebounceSamples_define <= 16 )
+#define DebouncePlanes 4
+#else
+#error "DebounceSamples is a maximum of 16"
+#endif
+#endif
+
 #if   ( MinDebounceTime_define > 0xFF )
 #error "MinDebounceTime is a maximum of 255 ms"
 #elif ( MinDebounceTime_define < 0x00 )
@@ -132,15 +153,49 @@ typedef struct KeyState {
 	uint32_t        prevDecisionTime;
 } KeyState;
 
+// Sense lines of a single strobe, one bit per sense (row)
+typedef uint32_t SenseMask;
+
+// Sense lines gathered from a single GPIO port read, see Matrix_senseSetup
+// Every sense line with the same pin to sense offset shares a run (a single shift and mask)
+typedef struct SenseRun {
+	Port      port;
+	uint8_t   read;  // Set if the port is read before this run (first run of each port)
+	int8_t    shift; // Pin minus sense line, shifts the port input right (left if negative)
+	SenseMask mask;  // Sense lines of the run
+} SenseRun;
+
+// Ghost Element, after ghost detection/cancelation (GhostingMatrix)
+typedef struct KeyGhost {
+	uint8_t cur;   // Key on, as sent to the macro module
+	uint8_t saved; // Key on, before ghosting
+} __attribute__((packed)) KeyGhost;
+
+#if DebounceMode_define == DebounceMode_Vertical
+// Vertical counter debounce element, one per strobe
+typedef struct StrobeState {
+	SenseMask state;                   // Debounced state, set if pressed
+	SenseMask valid;                   // Sense lines with a defined ScanCode
+	SenseMask count[ DebouncePlanes ]; // Vertical counter, bit planes (least significant first)
+} StrobeState;
+#endif
+
 
 
 // ----- Functions -----
 
+// Pressed or held
+static inline uint8_t keyOn( KeyPosition st )
+{
+	return st == KeyState_Press || st == KeyState_Hold;
+}
+
 void Matrix_setup();
 void Matrix_start();
 
 uint8_t Matrix_single_scan();
 uint8_t Matrix_totalColumns();
+uint8_t Matrix_totalRows();
 
 void Matrix_currentChange( unsigned int current );
 
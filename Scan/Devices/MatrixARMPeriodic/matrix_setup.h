@@ -25,7 +25,7 @@
 
 // Convenience Macros
 #define gpio( port, pin ) { Port_##port, Pin_##pin }
-#define Matrix_colsNum sizeof( Matrix_cols ) / sizeof( GPIO_Pin )
-#define Matrix_rowsNum sizeof( Matrix_rows ) / sizeof( GPIO_Pin )
-#define Matrix_maxKeys sizeof( Matrix_scanArray ) / sizeof( KeyState )
+#define Matrix_colsNum ( sizeof( Matrix_cols ) / sizeof( GPIO_Pin ) )
+#define Matrix_rowsNum ( sizeof( Matrix_rows ) / sizeof( GPIO_Pin ) )
+#define Matrix_maxKeys ( Matrix_colsNum * Matrix_rowsNum )
 
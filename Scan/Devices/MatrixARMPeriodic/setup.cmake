@@ -35,5 +35,6 @@ set_property (
 #
 set ( ModuleCompatibility
 	arm
+	host
 )
 
@@ -550,17 +550,18 @@ void LCD_layerStack_capability( TriggerMacro *trigger, uint8_t state, uint8_t st
 	}
 
 	// Parse the layer stack, top to bottom
-	extern uint16_t macroLayerIndexStack[];
+	// macroLayerIndexStackPrev[ 0 ] is the top of the stack, 0 terminates the stack
+	extern uint16_t macroLayerIndexStackPrev[];
 	extern uint16_t macroLayerIndexStackSize;
 
 	// Ignore if the stack size hasn't changed and the top of the stack is the same
 	if ( macroLayerIndexStackSize == LCD_layerStack_prevSize
-		&& macroLayerIndexStack[macroLayerIndexStackSize - 1] == LCD_layerStack_prevTop )
+		&& macroLayerIndexStackPrev[0] == LCD_layerStack_prevTop )
 	{
 		return;
 	}
 	LCD_layerStack_prevSize = macroLayerIndexStackSize;
-	LCD_layerStack_prevTop  = macroLayerIndexStack[macroLayerIndexStackSize - 1];
+	LCD_layerStack_prevTop  = macroLayerIndexStackPrev[0];
 
 	LCD_layerStackExact_args stack_args;
 	memset( stack_args.layers, 0, sizeof( stack_args.layers ) );
@@ -568,9 +569,10 @@ void LCD_layerStack_capability( TriggerMacro *trigger, uint8_t state, uint8_t st
 	// Use the LCD_layerStackExact_capability to set the LCD using the determined stack
 	// Construct argument set for capability
 	stack_args.numArgs = macroLayerIndexStackSize;
-	for ( uint16_t layer = 1; layer <= macroLayerIndexStackSize; layer++ )
+	uint16_t pos = 0;
+	for ( uint16_t layer = macroLayerIndexStackPrev[0]; layer != 0; layer = macroLayerIndexStackPrev[ layer ] )
 	{
-		stack_args.layers[ layer - 1 ] = macroLayerIndexStack[ macroLayerIndexStackSize - layer ];
+		stack_args.layers[ pos++ ] = layer;
 	}
 
 	// Only deal with the interconnect if it has been compiled in
@@ -339,7 +339,11 @@ void Connect_send_ScanCode( uint8_t id, TriggerEvent *scanCodeStateList, uint8_t
 	Connect_addBytes( header, sizeof( header ), UART_Master );
 
 	// Send each of the scan codes
-	Connect_addBytes( (uint8_t*)scanCodeStateList, numScanCodes * TriggerGuideSize, UART_Master );
+	// Only the TriggerGuide fields (type, state, index) are sent, timestamps are local to each node
+	for ( uint8_t scanCode = 0; scanCode < numScanCodes; scanCode++ )
+	{
+		Connect_addBytes( (uint8_t*)&scanCodeStateList[ scanCode ], TriggerGuideSize, UART_Master );
+	}
 
 	// Unlock Tx
 	uart_unlockTx( UART_Master );
@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+'''
+Chord window test case for Host-side KLL
+Uses a simulated clock to check when held back chord keys are decided
+'''
+
+# Copyright (C) 2017 by Jacob Alexander
+#
+# This file is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This file is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+### Imports ###
+
+from ctypes import (c_uint16)
+
+import interface as i
+
+from common import (ERROR, WARNING, check, result, advance, process_loop, press, release, codes)
+
+
+
+### Variables ###
+
+# See scancode_map.kll
+#  S0x61 : U"J";
+#  S0x62 : U"K";
+#  S0x61 + S0x62 : U"Esc";
+#  S0x04 : U"F3";
+j_scan_code = 0x61
+k_scan_code = 0x62
+other_scan_code = 0x04
+
+j_code = 0x0D # J
+k_code = 0x0E # K
+chord_code = 0x29 # Esc
+other_code = 0x3C # F3
+
+window = 30 # ms
+
+
+
+### Functions ###
+
+kiibohd = i.control.kiibohd
+
+chord_window = c_uint16.in_dll( kiibohd, 'macroChordWindow' )
+
+def idle():
+	'''
+	Checks nothing is left pressed or pending
+	'''
+	process_loop()
+	process_loop()
+	check( len( codes() ) == 0 )
+	check( len( data.pending_trigger_list() ) == 0 )
+
+
+
+### Test ###
+
+# Reference to callback datastructure
+data = i.control.data
+
+advance( 0 )
+chord_window.value = window
+
+print("-- Chord, pressed over separate loops within the window --")
+press( j_scan_code )
+process_loop()
+check( j_code not in codes() )
+
+advance( 10 )
+press( k_scan_code )
+process_loop()
+check( chord_code in codes() and j_code not in codes() and k_code not in codes() )
+
+release( j_scan_code )
+release( k_scan_code )
+process_loop()
+check( chord_code not in codes() )
+idle()
+
+print("-- Tap, released within the window --")
+press( j_scan_code )
+process_loop()
+check( j_code not in codes() )
+
+advance( 10 )
+release( j_scan_code )
+process_loop()
+check( j_code in codes() )
+
+# Release is sent on the following loop
+process_loop()
+check( j_code not in codes() )
+idle()
+
+print("-- Hold, window expires --")
+press( j_scan_code )
+process_loop()
+advance( window - 1 )
+process_loop()
+check( j_code not in codes() )
+
+# Decided on the loop the window expires
+advance( 1 )
+process_loop()
+check( j_code in codes() and chord_code not in codes() )
+
+release( j_scan_code )
+process_loop()
+check( j_code not in codes() )
+idle()
+
+print("-- Interrupted by another key press --")
+press( j_scan_code )
+process_loop()
+advance( 10 )
+press( other_scan_code )
+process_loop()
+check( j_code in codes() and other_code in codes() )
+
+release( other_scan_code )
+release( j_scan_code )
+process_loop()
+check( j_code not in codes() and other_code not in codes() )
+idle()
+
+print("-- Window disabled --")
+chord_window.value = 0
+press( j_scan_code )
+process_loop()
+check( j_code in codes() )
+
+release( j_scan_code )
+process_loop()
+check( j_code not in codes() )
+idle()
+
+result()
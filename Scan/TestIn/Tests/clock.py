@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+'''
+Host clock test case for Host-side KLL
+Checks the virtual (fast-forward) and monotonic clock sources
+'''
+
+# Copyright (C) 2017 by Jacob Alexander
+#
+# This file is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This file is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+### Imports ###
+
+import time
+
+import interface as i
+
+from common import (ERROR, WARNING, check, result, codes, now)
+
+
+
+### Variables ###
+
+# See scancode_map.kll
+#  S0x60 : tapHold( 0x29, 0xE0, 200 );
+tap_hold_scan_code = 0x60
+
+tap_code = 0x29 # Esc
+hold_code = 0xE0 # LCtrl
+timeout = 200 # ms
+
+# Clock sources, see Lib/host.h HostClock
+manual = 0
+virtual = 1
+monotonic = 2
+
+ms = 1000000 # ns
+
+
+
+### Functions ###
+
+kiibohd = i.control.kiibohd
+
+
+
+### Test ###
+
+# Reference to callback datastructure
+data = i.control.data
+
+print("-- Virtual clock, stepped after each Host_process --")
+kiibohd.Host_set_systick( 1000 )
+i.control.set_clock( virtual, 1 * ms )
+check( now() == 1000 )
+
+i.control.loop( 3 )
+check( now() == 1003 )
+
+# Sub-step remainders are kept
+check( i.control.advance_time( 10 * ms + ms // 2 ) == 1 )
+check( now() == 1013 )
+check( i.control.advance_time( ms // 2 ) == 1 )
+check( now() == 1014 )
+
+print("-- Fast-forward through a tap-hold timeout --")
+i.control.cmd('addScanCode')( tap_hold_scan_code )
+i.control.advance_time( ( timeout - 10 ) * ms )
+check( hold_code not in codes() and tap_code not in codes() )
+
+i.control.advance_time( 20 * ms )
+check( hold_code in codes() and tap_code not in codes() )
+
+i.control.cmd('removeScanCode')( tap_hold_scan_code )
+i.control.advance_time( 10 * ms )
+check( hold_code not in codes() and tap_code not in codes() )
+
+print("-- Monotonic clock --")
+i.control.set_clock( monotonic )
+start = now()
+check( start >= 1234 )
+time.sleep( 0.01 )
+check( now() >= start + 10 )
+
+# Cannot be set or advanced
+kiibohd.Host_set_systick( 0 )
+check( now() >= start + 10 )
+check( i.control.advance_time( ms ) == 0 )
+
+print("-- Manual clock --")
+i.control.set_clock( manual )
+kiibohd.Host_set_systick( 5000 )
+i.control.loop( 3 )
+check( now() == 5000 )
+check( i.control.advance_time( 2 * ms ) == 1 )
+check( now() == 5002 )
+
+check( len( data.pending_trigger_list() ) == 0 )
+
+result()
+
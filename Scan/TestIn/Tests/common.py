@@ -22,6 +22,8 @@ Common functions for Host-side KLL tests
 
 import sys
 
+from ctypes import (Structure, c_uint32)
+
 
 
 ### Decorators ###
@@ -68,3 +70,77 @@ def result():
 	else:
 		sys.exit( 1 )
 
+
+
+### Host Helpers ###
+
+# interface is imported on first use, as it loads the kiibohd library
+
+class Time( Structure ):
+	'''
+	Time struct
+	See Lib/time.h
+	'''
+	_fields_ = [
+		( 'ms',    c_uint32 ),
+		( 'ticks', c_uint32 ),
+	]
+
+
+def now():
+	'''
+	Current libkiibohd time (ms)
+	'''
+	import interface as i
+	i.control.kiibohd.Time_now.restype = Time
+	return i.control.kiibohd.Time_now().ms
+
+# Simulated clock (ms), see advance()
+systick = 1000
+
+def advance( ms ):
+	'''
+	Advances the simulated clock
+	'''
+	import interface as i
+	global systick
+	systick += ms
+	i.control.kiibohd.Host_set_systick( systick )
+
+
+def process_loop():
+	'''
+	Runs a full processing loop (Scan, Macro and Output periodic stages)
+	'''
+	import interface as i
+	i.control.loop( 3 )
+
+
+def advance_loop( ms=1 ):
+	'''
+	Advances the simulated clock, then runs a full processing loop
+	'''
+	advance( ms )
+	process_loop()
+
+
+def press( scan_code ):
+	import interface as i
+	i.control.cmd('addScanCode')( scan_code )
+
+
+def release( scan_code ):
+	import interface as i
+	i.control.cmd('removeScanCode')( scan_code )
+
+
+def codes():
+	'''
+	USB codes in the last keyboard report sent
+	'''
+	import interface as i
+	data = i.control.data
+	if data.usb_keyboard_data is None:
+		return []
+	return data.usb_keyboard_data.codes()
+
@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+'''
+Event injection test case for Host-side KLL
+Checks that TriggerEvents injected with Host_inject_events are processed like scan module events
+'''
+
+# Copyright (C) 2017 by Jacob Alexander
+#
+# This file is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This file is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+### Imports ###
+
+from ctypes import (c_uint8, c_uint16)
+
+import interface as i
+
+from common import (ERROR, WARNING, check, result, codes)
+
+
+
+### Variables ###
+
+# See scancode_map.kll
+#  S0x02 : U"F1";
+#  S0x03 : U"F2";
+first_scan_code = 0x02
+second_scan_code = 0x03
+
+first_code = 0x3A # F1
+second_code = 0x3B # F2
+
+# TriggerType_Switch1, ScheduleType_P / ScheduleType_R
+switch = 0x00
+press = 0x01
+release = 0x03
+
+# Number of press/release pairs to inject at once
+burst_pairs = 500
+
+
+
+### Functions ###
+
+kiibohd = i.control.kiibohd
+
+protocol = c_uint8.in_dll( kiibohd, 'USBKeys_Protocol' )
+cache_size = c_uint8.in_dll( kiibohd, 'macroInterconnectCacheSize' )
+
+def cache():
+	'''
+	Events in the Interconnect Cache (see Macro_pressReleaseAdd)
+	'''
+	events = ( i.lib.TriggerEvent * cache_size.value ).in_dll( kiibohd, 'macroInterconnectCache' )
+	return [ ( event.index, event.state, event.time ) for event in events ]
+
+
+
+### Test ###
+
+# Reference to callback datastructure
+data = i.control.data
+
+# NKRO Mode
+protocol.value = 1
+i.control.step()
+
+print("-- Injected events keep their timestamps --")
+i.control.inject_events( [
+	( switch, press, first_scan_code, 100 ),
+	( switch, press, second_scan_code, 101 ),
+], 102 )
+check( cache() == [ ( first_scan_code, press, 100 ), ( second_scan_code, press, 101 ) ] )
+
+i.control.step()
+check( first_code in codes() and second_code in codes() )
+
+print("-- Held until released --")
+i.control.step( 4 )
+check( first_code in codes() and second_code in codes() )
+
+i.control.inject_events( [
+	( switch, release, first_scan_code, 120 ),
+	( switch, release, second_scan_code, 120 ),
+], 120 )
+i.control.step()
+check( len( codes() ) == 0 )
+
+print("-- Out of range events are skipped --")
+max_scan_code = c_uint16.in_dll( kiibohd, 'Macro_MaxScanCode_Host' ).value
+if max_scan_code < 0xFF:
+	i.control.inject_events( [ ( switch, press, 0xFF, 130 ) ], 130 )
+	check( len( cache() ) == 0 )
+
+print("-- Burst of events --")
+events = []
+for pair in range( burst_pairs ):
+	scan_code = pair % 2 and second_scan_code or first_scan_code
+	events.append( ( switch, press, scan_code, 200 + pair * 2 ) )
+	events.append( ( switch, release, scan_code, 201 + pair * 2 ) )
+del data.usb_keyboard_reports[:]
+i.control.inject_events( events, 200 )
+i.control.step( 2 )
+check( len( codes() ) == 0 )
+
+# A key changing again waits for the next processing loop, so every press is sent
+sent = [ report.codes() for report in data.usb_keyboard_reports ]
+check( sum( first_code in report or second_code in report for report in sent ) == burst_pairs )
+
+# Nothing left to process
+i.control.step()
+check( len( cache() ) == 0 )
+check( len( data.pending_trigger_list() ) == 0 )
+
+result()
+
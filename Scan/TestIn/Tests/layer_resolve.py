@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+'''
+Layer resolution test case for Host-side KLL
+Compares the resolved layer lookup against a full search of the layer stack
+'''
+
+# Copyright (C) 2017 by Jacob Alexander
+#
+# This file is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This file is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+### Imports ###
+
+import random
+
+from ctypes import (POINTER, cast, c_uint8, c_uint16, c_void_p)
+
+import interface as i
+
+from common import (ERROR, WARNING, check, result)
+
+
+
+### Variables ###
+
+# Layer state bits (Shift, Latch, Lock)
+layer_state_bits = [ 0x01, 0x02, 0x04 ]
+
+# Number of random layer state toggles
+random_toggles = 500
+
+
+
+### Functions ###
+
+kiibohd = i.control.kiibohd
+
+kiibohd.Macro_layerState.argtypes = [ c_void_p, c_uint8, c_uint8, c_uint16, c_uint8 ]
+kiibohd.Macro_layerLookupStack.argtypes = [ c_uint8, c_uint8 ]
+kiibohd.Macro_layerLookupStack.restype = c_void_p
+
+layer_num = cast( kiibohd.Macro_LayerNum_Host, POINTER( c_uint16 ) )[0]
+max_scan_code = cast( kiibohd.Macro_MaxScanCode_Host, POINTER( c_uint16 ) )[0]
+
+def layer_state( layer, state ):
+	'''
+	Toggles the given layer state bit
+	'''
+	kiibohd.Macro_layerState( None, 0, 0, layer, state )
+
+def compare():
+	'''
+	Compares every ScanCode in the resolved layer lookup against the layer stack search
+	Returns the number of mismatched ScanCodes
+	'''
+	resolved = cast( kiibohd.macroLayerResolvedTriggerList, POINTER( c_void_p * ( max_scan_code + 1 ) ) )[0]
+	mismatches = 0
+	for scan_code in range( 0, max_scan_code + 1 ):
+		if resolved[ scan_code ] != kiibohd.Macro_layerLookupStack( scan_code, 0 ):
+			print( "{0} ScanCode 0x{1:02X} resolved differently".format( ERROR, scan_code ) )
+			mismatches += 1
+	return mismatches
+
+
+
+### Test ###
+
+print("-- Default layer --")
+check( compare() == 0 )
+
+print("-- Single layer states --")
+for layer in range( 1, layer_num ):
+	for state in layer_state_bits:
+		layer_state( layer, state )
+		check( compare() == 0 )
+		layer_state( layer, state )
+		check( compare() == 0 )
+
+print("-- Random layer states --")
+random.seed( 0 )
+for toggle in range( 0, random_toggles if layer_num > 1 else 0 ):
+	layer_state( random.randrange( 1, layer_num ), random.choice( layer_state_bits ) )
+	check( compare() == 0 )
+
+# Clear all layer states
+layer_states = cast( kiibohd.macroLayerState, POINTER( c_uint8 * layer_num ) )[0]
+for layer in range( 1, layer_num ):
+	for state in layer_state_bits:
+		if layer_states[ layer ] & state:
+			layer_state( layer, state )
+
+check( cast( kiibohd.macroLayerIndexStackSize, POINTER( c_uint16 ) )[0] == 0 )
+check( compare() == 0 )
+
+result()
@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+'''
+Long TriggerMacro test case for Host-side KLL
+Compares the prefix trie cursors against the previous per TriggerMacro matcher on random event streams
+'''
+
+# Copyright (C) 2017 by Jacob Alexander
+#
+# This file is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This file is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+### Imports ###
+
+import random
+
+from ctypes import (c_uint8, c_uint16)
+
+import interface as i
+
+from common import (ERROR, WARNING, check, result, process_loop, press, release, codes)
+
+
+
+### Variables ###
+
+# See scancode_map.kll
+#  S0x01 : U"Esc";
+#  S0x64, S0x65 : U"1";
+#  S0x64, S0x65, S0x66 : U"2";
+#  S0x64, S0x66 : U"3";
+#  S0x64 + S0x65, S0x66 : U"4";
+#  S0x65, S0x64 : U"5";
+#  S0x65, S0x66 : U"6", U"7";
+#  S0x66, S0x66 : U"8";
+short_scan_code = 0x01
+scan_codes = [ 0x64, 0x65, 0x66, short_scan_code ]
+
+esc_code = 0x29 # Esc
+one_code = 0x1E # 1
+two_code = 0x1F # 2
+
+# Random event streams, and the processing loops in each
+streams = 40
+stream_loops = 60
+
+
+
+### Functions ###
+
+kiibohd = i.control.kiibohd
+
+protocol = c_uint8.in_dll( kiibohd, 'USBKeys_Protocol' )
+long_trie = c_uint8.in_dll( kiibohd, 'macroTriggerLongTrie' )
+cursors = c_uint16.in_dll( kiibohd, 'macroTriggerCursorListSize' )
+
+def reports():
+	'''
+	USB codes of each keyboard report sent since the last call, order-insensitive
+	'''
+	sent = [ sorted( report.codes() ) for report in data.usb_keyboard_reports ]
+	del data.usb_keyboard_reports[:]
+	return sent
+
+def codes_sent():
+	'''
+	USB codes set at the end of the processing loop, None if no report was sent
+	ResultMacros may be queued in a different order (see Trigger_process), which only changes the reports in between
+	'''
+	sent = reports()
+	return sent[-1] if sent else None
+
+def reset( trie ):
+	'''
+	Selects the matcher, starting from nothing pending and no USB codes set
+	Long TriggerMacros stay pending until they fail, and long triggers with a single ResultMacro send no release
+	'''
+	process_loop()
+	kiibohd.Trigger_setup()
+	kiibohd.Result_setup()
+	kiibohd.Output_flushBuffers()
+	long_trie.value = trie
+	process_loop()
+	reports()
+
+def run_stream( seed ):
+	'''
+	Sends a random event stream, then releases every key
+	Returns the USB codes set after each processing loop
+	'''
+	rng = random.Random( seed )
+	held = set()
+	sent = []
+	for loop in range( stream_loops ):
+		# Zero to two events per processing loop
+		for event in range( rng.choice( [ 0, 1, 1, 2 ] ) ):
+			scan_code = rng.choice( scan_codes )
+			if scan_code in held:
+				release( scan_code )
+				held.remove( scan_code )
+			else:
+				press( scan_code )
+				held.add( scan_code )
+		process_loop()
+		sent.append( codes_sent() )
+
+	for scan_code in held:
+		release( scan_code )
+	for loop in range( 3 ):
+		process_loop()
+		sent.append( codes_sent() )
+	return sent
+
+
+
+### Test ###
+
+# Reference to callback datastructure
+data = i.control.data
+
+# NKRO Mode
+protocol.value = 1
+process_loop()
+reports()
+
+print("-- Random event streams, trie cursors against the previous matcher --")
+mismatches = 0
+for seed in range( streams ):
+	reset( 0 )
+	previous = run_stream( seed )
+
+	reset( 1 )
+	trie = run_stream( seed )
+
+	if previous != trie:
+		mismatches += 1
+		print( "{0} Stream {1} differs".format( ERROR, seed ) )
+check( mismatches == 0 )
+
+print("-- Shared prefix, followed by one cursor --")
+reset( 1 )
+press( 0x64 )
+process_loop()
+check( cursors.value == 1 )
+release( 0x64 )
+process_loop()
+press( 0x65 )
+process_loop()
+check( one_code in codes() )
+release( 0x65 )
+process_loop()
+press( 0x66 )
+process_loop()
+check( two_code in codes() )
+release( 0x66 )
+process_loop()
+
+print("-- Result order, short ResultMacros before long ones --")
+# Boot Mode, the report keeps the order the USB codes were added in
+protocol.value = 0
+
+# S0x64, S0x65 and S0x01 finish during the same processing loop
+for trie in ( 1, 0 ):
+	reset( trie )
+	press( 0x64 )
+	process_loop()
+	release( 0x64 )
+	process_loop()
+	press( 0x65 )
+	press( short_scan_code )
+	process_loop()
+
+	# The previous matcher queued them in pending list order, the sequence first
+	order = [ esc_code, one_code ] if trie else [ one_code, esc_code ]
+	check( codes()[ : 2 ] == order )
+
+	release( 0x65 )
+	release( short_scan_code )
+	process_loop()
+
+reset( 1 )
+
+result()
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+'''
+USB report building benchmark for Host-side KLL
+Times processing loops where many keys change at once (e.g. a full layout layer switch)
+'''
+
+# Copyright (C) 2017 by Jacob Alexander
+#
+# This file is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This file is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+### Imports ###
+
+import time
+
+from ctypes import (c_uint8)
+
+import interface as i
+
+from common import (ERROR, WARNING, check, result)
+
+
+
+### Variables ###
+
+# Number of press/release bursts to time per measurement
+bursts = 200
+
+# Number of keys changing at once, per keyboard protocol
+# Boot mode is limited to 6 keys
+changed_keys = {
+	0 : [ 1, 6 ],
+	1 : [ 1, 6, 16, 32, 64, 95 ],
+}
+
+# First scan code to press
+first_scan_code = 0x01
+
+
+
+### Functions ###
+
+kiibohd = i.control.kiibohd
+
+protocol = c_uint8.in_dll( kiibohd, 'USBKeys_Protocol' )
+
+def process_loop( count ):
+	'''
+	Runs count full processing loops (Scan, Macro and Output periodic stages)
+	Host_process is called directly to avoid the per-call debug output of control.loop()
+	'''
+	for loop in range( count ):
+		kiibohd.Host_process()
+		kiibohd.Host_process()
+		kiibohd.Host_process()
+
+def burst( scan_codes, command ):
+	'''
+	Presses or releases all the given keys during a single processing loop
+	'''
+	for scan_code in scan_codes:
+		i.control.cmd( command )( scan_code )
+	i.control.refresh_callback()
+	process_loop( 1 )
+
+
+
+### Test ###
+
+# Reference to callback datastructure
+data = i.control.data
+
+print("-USB Report Building Benchmark-")
+print("protocol,keys,us_per_loop")
+
+for mode, counts in sorted( changed_keys.items() ):
+	protocol.value = mode
+
+	for count in counts:
+		scan_codes = range( first_scan_code, first_scan_code + count )
+
+		# Timed press/release bursts
+		start = time.perf_counter()
+		for loop in range( bursts ):
+			burst( scan_codes, 'addScanCode' )
+			burst( scan_codes, 'removeScanCode' )
+		elapsed = time.perf_counter() - start
+
+		print("{0},{1},{2:.3f}".format( mode, count, elapsed / ( bursts * 2 ) * 1000000 ) )
+
+		# Process until idle
+		process_loop( 2 )
+		check( len( data.pending_trigger_list() ) == 0 )
+
+result()
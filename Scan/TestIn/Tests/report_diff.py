@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+'''
+USB report diffing test case for Host-side KLL
+Checks that reports matching the last report sent are suppressed
+'''
+
+# Copyright (C) 2017 by Jacob Alexander
+#
+# This file is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This file is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+### Imports ###
+
+from ctypes import (c_uint8, c_uint32)
+
+import interface as i
+
+from common import (ERROR, WARNING, check, result, process_loop, press, release, codes)
+
+
+
+### Variables ###
+
+# See scancode_map.kll
+#  S0x3D : U"J";
+#  S0x61 : U"J";
+#  S0x02 : U"F1";
+#  S0x03 : U"F2";
+j_scan_code = 0x3D
+j_alt_scan_code = 0x61
+first_scan_code = 0x02
+second_scan_code = 0x03
+
+j_code = 0x0D # J
+first_code = 0x3A # F1
+second_code = 0x3B # F2
+
+# Number of loops to hold keys for
+hold_loops = 4
+
+
+
+### Functions ###
+
+kiibohd = i.control.kiibohd
+
+protocol = c_uint8.in_dll( kiibohd, 'USBKeys_Protocol' )
+sent = c_uint32.in_dll( kiibohd, 'USBKeys_ReportsSent' )
+suppressed = c_uint32.in_dll( kiibohd, 'USBKeys_ReportsSuppressed' )
+
+def counters():
+	'''
+	Reports (sent, suppressed) since the start of the test
+	'''
+	return sent.value - start[0], suppressed.value - start[1]
+
+
+
+### Test ###
+
+# Reference to callback datastructure
+data = i.control.data
+
+# NKRO Mode
+protocol.value = 1
+
+# Settle, the first report after setup is always sent
+press( first_scan_code )
+process_loop()
+release( first_scan_code )
+process_loop()
+process_loop()
+start = ( sent.value, suppressed.value )
+
+print("-- Press and release send a single report each --")
+press( first_scan_code )
+press( second_scan_code )
+process_loop()
+check( first_code in codes() and second_code in codes() )
+check( counters() == ( 1, 0 ) )
+
+for loop in range( hold_loops ):
+	process_loop()
+check( counters() == ( 1, 0 ) )
+
+release( first_scan_code )
+release( second_scan_code )
+process_loop()
+check( len( codes() ) == 0 )
+check( counters() == ( 2, 0 ) )
+
+print("-- Same USB Code from two keys, matching report is suppressed --")
+press( j_scan_code )
+process_loop()
+check( j_code in codes() )
+check( counters() == ( 3, 0 ) )
+
+press( j_alt_scan_code )
+process_loop()
+check( j_code in codes() )
+check( counters() == ( 3, 0 ) )
+
+# First release clears the USB Code
+release( j_alt_scan_code )
+process_loop()
+check( j_code not in codes() )
+check( counters() == ( 4, 0 ) )
+
+# Second release leaves the report unchanged
+release( j_scan_code )
+process_loop()
+check( j_code not in codes() )
+check( counters() == ( 4, 1 ) )
+
+# Nothing left to send
+for loop in range( hold_loops ):
+	process_loop()
+check( counters() == ( 4, 1 ) )
+check( len( data.pending_trigger_list() ) == 0 )
+
+result()
+
@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+'''
+USB report queue test case for Host-side KLL
+Checks that every intermediate keyboard report of a processing loop is sent, in order
+'''
+
+# Copyright (C) 2017 by Jacob Alexander
+#
+# This file is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This file is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+### Imports ###
+
+from ctypes import (c_uint8, c_uint32)
+
+import interface as i
+
+from common import (ERROR, WARNING, check, result, process_loop, press, release)
+
+
+
+### Variables ###
+
+# See scancode_map.kll
+#  S0x63 : U"H", U"I";
+sequence_scan_code = 0x63
+
+a_code = 0x04 # A
+h_code = 0x0B # H
+i_code = 0x0C # I
+
+# Press/release pairs sent during a single processing loop
+# More reports than the report ring holds (USBReportRing), but fewer changes than USBKeys_Pending holds once the ring is full
+burst_pairs = 20
+
+
+
+### Functions ###
+
+kiibohd = i.control.kiibohd
+
+protocol = c_uint8.in_dll( kiibohd, 'USBKeys_Protocol' )
+collapsed = c_uint32.in_dll( kiibohd, 'USBKeys_RingCollapsed' )
+
+def usb_code( code, state ):
+	'''
+	Calls the usbKeyOut capability directly (state 0x01 - Press, 0x03 - Release)
+	'''
+	kiibohd.Output_usbCodeSend_capability( None, state, 0x00, ( c_uint8 * 1 )( code ) )
+
+def reports():
+	'''
+	USB codes of each keyboard report sent since the last call
+	'''
+	sent = [ report.codes() for report in data.usb_keyboard_reports ]
+	del data.usb_keyboard_reports[:]
+	return sent
+
+
+
+### Test ###
+
+# Reference to callback datastructure
+data = i.control.data
+
+# NKRO Mode
+protocol.value = 1
+process_loop()
+reports()
+
+print("-- Press and release during the same processing loop --")
+usb_code( a_code, 0x01 )
+usb_code( a_code, 0x03 )
+process_loop()
+check( reports() == [ [ a_code ], [] ] )
+
+print("-- Sequence is sent in a single processing loop --")
+press( sequence_scan_code )
+process_loop()
+check( reports() == [ [ h_code ], [ h_code, i_code ] ] )
+
+release( sequence_scan_code )
+process_loop()
+check( reports() == [ [ i_code ], [] ] )
+
+process_loop()
+check( reports() == [] )
+
+print("-- Matching reports are merged --")
+start = collapsed.value
+for press_count in range( 3 ):
+	usb_code( a_code, 0x01 )
+process_loop()
+check( reports() == [ [ a_code ] ] )
+check( collapsed.value > start )
+
+usb_code( a_code, 0x03 )
+process_loop()
+check( reports() == [ [] ] )
+
+print("-- More reports than the queue holds wait for room --")
+start = collapsed.value
+for pair in range( burst_pairs ):
+	usb_code( a_code, 0x01 )
+	usb_code( a_code, 0x03 )
+process_loop()
+check( reports() == [ [ a_code ], [] ] * burst_pairs )
+check( collapsed.value == start )
+
+# Nothing left to send
+process_loop()
+check( reports() == [] )
+check( len( data.pending_trigger_list() ) == 0 )
+
+result()
+
@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+'''
+USB report ring test case for Host-side KLL
+Checks that keyboard reports written to the host report ring match the keyboard_send callback
+'''
+
+# Copyright (C) 2017 by Jacob Alexander
+#
+# This file is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This file is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+### Imports ###
+
+from ctypes import (c_uint8)
+
+import interface as i
+
+from common import (ERROR, WARNING, check, result, advance_loop, now)
+
+
+
+### Variables ###
+
+# See scancode_map.kll
+#  S0x02 : U"F1"; ... S0x0D : U"F12";
+scan_codes = range( 0x02, 0x0E )
+
+# Smaller than the number of reports sent, so the ring has to be drained by the keyboard_drain callback
+ring_size = 4
+
+# Number of times to run the key pattern
+rounds = 4
+
+
+
+### Functions ###
+
+kiibohd = i.control.kiibohd
+
+protocol = c_uint8.in_dll( kiibohd, 'USBKeys_Protocol' )
+
+def pattern():
+	'''
+	Rolls over the keys, pressing the next key before releasing the previous one
+	'''
+	previous = None
+	for scan_code in scan_codes:
+		i.control.cmd('addScanCode')( scan_code )
+		advance_loop()
+		if previous is not None:
+			i.control.cmd('removeScanCode')( previous )
+			advance_loop()
+		previous = scan_code
+	i.control.cmd('removeScanCode')( previous )
+	advance_loop()
+	advance_loop()
+
+
+
+### Test ###
+
+# Reference to callback datastructure
+data = i.control.data
+
+for mode in [ 0, 1 ]:
+	print("-- Protocol {0} --".format( mode ) )
+	protocol.value = mode
+	advance_loop()
+
+	# Reference, using the keyboard_send callback
+	del data.usb_keyboard_reports[:]
+	for loop in range( rounds ):
+		pattern()
+	expected = [ report.codes() for report in data.usb_keyboard_reports ]
+	check( len( expected ) > ring_size )
+
+	# Same keys, using the report ring
+	i.control.report_ring_setup( ring_size )
+	del data.usb_keyboard_reports[:]
+	del data.usb_keyboard_records[:]
+	start = now()
+	for loop in range( rounds ):
+		pattern()
+	i.control.report_ring_drain()
+
+	records = data.usb_keyboard_records
+	check( len( data.usb_keyboard_reports ) == 0 )
+	check( [ data.usb_keyboard_record( record ).codes() for record in records ] == expected )
+	check( i.control.report_ring.dropped == 0 )
+
+	# Timestamps follow systick
+	times = [ record.ms for record in records ]
+	check( times == sorted( times ) )
+	check( times[0] > start and times[-1] <= now() )
+
+	# Nothing left in the ring
+	check( i.control.report_ring_drain() == 0 )
+
+	# Back to the keyboard_send callback
+	i.control.report_ring_setup( 0 )
+	pattern()
+	check( [ report.codes() for report in data.usb_keyboard_reports ] == expected[ : len( data.usb_keyboard_reports ) ] )
+
+check( len( data.pending_trigger_list() ) == 0 )
+
+result()
+
@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+'''
+ResultMacro op test case for Host-side KLL
+Compares the decoded ResultMacro ops against the guide interpreter on random event streams
+'''
+
+# Copyright (C) 2017 by Jacob Alexander
+#
+# This file is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This file is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+### Imports ###
+
+import random
+
+from ctypes import (c_uint8, c_uint16)
+
+import interface as i
+
+from common import (ERROR, WARNING, check, result, advance, process_loop, press, release, codes)
+
+
+
+### Variables ###
+
+# See scancode_map.kll
+#  S0x37 : U"A";
+#  S0x45 : U"LShift";
+#  S0x55 : U"LCtrl";
+#  S0x60 : tapHold( 0x29, 0xE0, 200 );
+#  S0x61 + S0x62 : U"Esc";
+#  S0x63 : U"H", U"I";
+#  S0x65, S0x66 : U"6", U"7";
+#  S0x67 : U"LShift" + U"A", U"B" + U"C";
+scan_codes = [ 0x37, 0x45, 0x55, 0x60, 0x61, 0x62, 0x63, 0x65, 0x66, 0x67 ]
+
+sequence_scan_code = 0x63
+h_code = 0x0B # H
+i_code = 0x0C # I
+
+# Random event streams, and the processing loops in each
+streams = 40
+stream_loops = 60
+
+
+
+### Functions ###
+
+kiibohd = i.control.kiibohd
+
+protocol = c_uint8.in_dll( kiibohd, 'USBKeys_Protocol' )
+decode = c_uint8.in_dll( kiibohd, 'macroResultOpDecode' )
+op_count = c_uint16.in_dll( kiibohd, 'macroResultOpListSize' )
+overflow = c_uint16.in_dll( kiibohd, 'macroResultOpOverflow' )
+
+def reports():
+	'''
+	USB codes of each keyboard report sent since the last call, in report order
+	'''
+	sent = [ report.codes() for report in data.usb_keyboard_reports ]
+	del data.usb_keyboard_reports[:]
+	return sent
+
+def reset( ops ):
+	'''
+	Selects decoded ops or the guide interpreter, starting from nothing pending and no USB codes set
+	'''
+	for loop in range( 3 ):
+		advance( 500 )
+		process_loop()
+	kiibohd.Trigger_setup()
+	decode.value = ops
+	kiibohd.Result_setup()
+	kiibohd.Output_flushBuffers()
+	process_loop()
+	reports()
+
+def run_stream( seed ):
+	'''
+	Sends a random event stream, then releases every key
+	Returns every keyboard report sent, per processing loop
+	'''
+	rng = random.Random( seed )
+	held = set()
+	sent = []
+	for loop in range( stream_loops ):
+		# Zero to two events per processing loop
+		for event in range( rng.choice( [ 0, 1, 1, 2 ] ) ):
+			scan_code = rng.choice( scan_codes )
+			if scan_code in held:
+				release( scan_code )
+				held.remove( scan_code )
+			else:
+				press( scan_code )
+				held.add( scan_code )
+
+		# Some loops pass the tapHold timeout
+		advance( rng.choice( [ 1, 10, 250 ] ) )
+		process_loop()
+		sent.append( reports() )
+
+	for scan_code in held:
+		release( scan_code )
+	for loop in range( 3 ):
+		advance( 250 )
+		process_loop()
+		sent.append( reports() )
+	return sent
+
+
+
+### Test ###
+
+# Reference to callback datastructure
+data = i.control.data
+
+# Boot Mode, the report keeps the order the USB codes were added in
+protocol.value = 0
+process_loop()
+reports()
+
+print("-- Every ResultMacro fits the decoded op storage --")
+reset( 1 )
+check( op_count.value > 0 and overflow.value == 0 )
+
+reset( 0 )
+check( op_count.value == 0 and overflow.value == 0 )
+
+print("-- Sequence of combos, sent in a single processing loop --")
+sent = []
+for ops in ( 1, 0 ):
+	reset( ops )
+	press( sequence_scan_code )
+	process_loop()
+	pressed = reports()
+	release( sequence_scan_code )
+	process_loop()
+	process_loop()
+	sent.append( pressed + reports() )
+check( sent[0][ : 2 ] == [ [ h_code ], [ h_code, i_code ] ] )
+check( sent[0] == sent[1] )
+
+print("-- Random event streams, decoded ops against the guide interpreter --")
+for mode in ( 0, 1 ): # Boot, NKRO
+	protocol.value = mode
+	mismatches = 0
+	for seed in range( streams ):
+		reset( 0 )
+		guide = run_stream( seed )
+
+		reset( 1 )
+		ops = run_stream( seed )
+
+		if guide != ops:
+			mismatches += 1
+			print( "{0} Stream {1} differs (protocol {2})".format( ERROR, seed, mode ) )
+	check( mismatches == 0 )
+
+reset( 1 )
+
+result()
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+'''
+Tap/Hold capability test case for Host-side KLL
+Uses a simulated clock to check when tap/hold keys are resolved
+'''
+
+# Copyright (C) 2017 by Jacob Alexander
+#
+# This file is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This file is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+### Imports ###
+
+import interface as i
+
+from common import (ERROR, WARNING, check, result, advance, process_loop, press, release, codes)
+
+
+
+### Variables ###
+
+# See scancode_map.kll
+#  S0x60 : tapHold( 0x29, 0xE0, 200 );
+#  S0x02 : U"F1";
+tap_hold_scan_code = 0x60
+other_scan_code = 0x02
+
+tap_code = 0x29 # Esc
+hold_code = 0xE0 # LCtrl
+other_code = 0x3A # F1
+timeout = 200 # ms
+
+
+
+### Test ###
+
+# Reference to callback datastructure
+data = i.control.data
+
+advance( 0 )
+
+print("-- Tap, released before the timeout --")
+press( tap_hold_scan_code )
+process_loop()
+check( tap_code not in codes() and hold_code not in codes() )
+
+advance( timeout - 1 )
+release( tap_hold_scan_code )
+process_loop()
+check( tap_code in codes() and hold_code not in codes() )
+
+# Tap code is released on the following loop
+process_loop()
+check( tap_code not in codes() and hold_code not in codes() )
+
+print("-- Hold, timeout expires --")
+press( tap_hold_scan_code )
+process_loop()
+advance( timeout - 1 )
+process_loop()
+check( hold_code not in codes() )
+
+# Resolved on the loop the timeout expires
+advance( 1 )
+process_loop()
+check( hold_code in codes() and tap_code not in codes() )
+
+advance( timeout )
+release( tap_hold_scan_code )
+process_loop()
+check( hold_code not in codes() and tap_code not in codes() )
+
+print("-- Hold, interrupted by another key press --")
+press( tap_hold_scan_code )
+process_loop()
+advance( 10 )
+press( other_scan_code )
+process_loop()
+
+# Hold code is part of the same report as the interrupting key
+check( hold_code in codes() and other_code in codes() and tap_code not in codes() )
+
+release( other_scan_code )
+release( tap_hold_scan_code )
+process_loop()
+check( hold_code not in codes() and other_code not in codes() )
+
+# Nothing left pending
+process_loop()
+check( len( data.pending_trigger_list() ) == 0 )
+
+result()
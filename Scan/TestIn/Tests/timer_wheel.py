@@ -0,0 +1,252 @@
+#!/usr/bin/env python3
+'''
+TriggerMacro deadline timer wheel test case for Host-side KLL
+Checks expiry order, cascading across wheel levels and cancellation against a reference model
+'''
+
+# Copyright (C) 2017 by Jacob Alexander
+#
+# This file is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This file is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+### Imports ###
+
+import random
+
+from ctypes import (c_uint8, c_uint16, c_uint32)
+
+import interface as i
+
+from common import (ERROR, WARNING, check, result, Time)
+
+
+
+### Variables ###
+
+# See Macro/PartialMap/timer.c
+slots = 32 # Level 0 slots (ms), each level 1 slot is a full level 0 revolution
+level1_span = slots * slots
+
+# TriggerMacro indices used for the deadlines, only the timer state is used
+# Matches TimerPoolSize in scancode_map.kll
+timers = 16
+
+# Clock source, see Lib/host.h HostClock
+manual = 0
+
+# Random operations for the reference model comparison
+random_steps = 2000
+
+
+
+### Functions ###
+
+kiibohd = i.control.kiibohd
+kiibohd.Time_now.restype = Time
+kiibohd.Host_set_systick.argtypes = [ c_uint32 ]
+kiibohd.Timer_set.argtypes = [ c_uint16, Time ]
+kiibohd.Timer_cancel.argtypes = [ c_uint16 ]
+kiibohd.Timer_armed.argtypes = [ c_uint16 ]
+kiibohd.Timer_armed.restype = c_uint8
+kiibohd.Timer_count.restype = c_uint16
+
+pending_size = c_uint16.in_dll( kiibohd, 'macroTriggerMacroPendingListSize' )
+# One more TriggerMacro index than the pool holds is used
+pending_list = ( c_uint16 * ( timers + 1 ) ).in_dll( kiibohd, 'macroTriggerMacroPendingList' )
+pending_bits = ( c_uint8 * ( timers // 8 + 1 ) ).in_dll( kiibohd, 'macroTriggerMacroPendingListBits' )
+
+def reset( ms ):
+	'''
+	Disarms all deadlines and sets the clock
+	'''
+	kiibohd.Host_set_systick( ms )
+	kiibohd.Trigger_setup()
+
+def set_timer( index, ms, ticks=0 ):
+	kiibohd.Timer_set( index, Time( ms & 0xFFFFFFFF, ticks ) )
+
+def step( ms=1 ):
+	'''
+	Advances the clock and fires expired deadlines
+	Returns the TriggerMacro indices fired, in order
+	'''
+	kiibohd.Host_set_systick( ( kiibohd.Time_now().ms + ms ) & 0xFFFFFFFF )
+	kiibohd.Timer_process( kiibohd.Time_now() )
+
+	# Fired deadlines are added to the pending list by Trigger_deadline
+	fired = list( pending_list[ : pending_size.value ] )
+	pending_size.value = 0
+	for index in range( len( pending_bits ) ):
+		pending_bits[ index ] = 0
+	return fired
+
+def run_until( ms ):
+	'''
+	Steps 1 ms at a time until ms
+	Returns a dict of TriggerMacro index to the ms it fired on
+	'''
+	fired = {}
+	while kiibohd.Time_now().ms != ( ms & 0xFFFFFFFF ):
+		for index in step():
+			fired[ index ] = kiibohd.Time_now().ms
+	return fired
+
+
+
+### Test ###
+
+# Reference to callback datastructure
+data = i.control.data
+
+i.control.set_clock( manual )
+
+print("-- Level 0, expiry order --")
+start = 1000
+reset( start )
+offsets = list( range( 1, timers + 1 ) )
+random.shuffle( offsets )
+for index, offset in enumerate( offsets ):
+	set_timer( index, start + offset )
+check( kiibohd.Timer_count() == timers )
+
+order = []
+for ms in range( timers ):
+	order += step()
+check( order == sorted( range( timers ), key=lambda index: offsets[ index ] ) )
+check( kiibohd.Timer_count() == 0 )
+
+print("-- Cascade across wheel levels --")
+# Starting just before a level 0 revolution, deadlines on either side of each level boundary
+start = 5 * level1_span - 3
+reset( start )
+offsets = [ 1, 2, 3, 4, slots - 1, slots, slots + 1, 2 * slots + 5, level1_span - 1, level1_span, level1_span + 1, 3 * level1_span + 7 ]
+for index, offset in enumerate( offsets ):
+	set_timer( index, start + offset )
+
+fired = run_until( start + max( offsets ) + 1 )
+check( fired == { index: start + offset for index, offset in enumerate( offsets ) } )
+check( kiibohd.Timer_count() == 0 )
+
+print("-- Single large step --")
+reset( start )
+for index, offset in enumerate( offsets ):
+	set_timer( index, start + offset )
+
+# Every expired deadline fires, in deadline order
+order = step( 4 * level1_span )
+check( order == sorted( range( len( offsets ) ), key=lambda index: offsets[ index ] ) )
+
+print("-- Cancellation and re-arm --")
+reset( start )
+for index, offset in enumerate( offsets ):
+	set_timer( index, start + offset )
+
+# Cancel an entry on each level, re-arm others to a different level
+kiibohd.Timer_cancel( 0 )
+kiibohd.Timer_cancel( 7 )
+kiibohd.Timer_cancel( 11 )
+kiibohd.Timer_cancel( 11 ) # Already cancelled, ignored
+set_timer( 1, start + level1_span + 2 )
+set_timer( 9, start + 2 )
+check( kiibohd.Timer_armed( 0 ) == 0 and kiibohd.Timer_armed( 1 ) == 1 )
+check( kiibohd.Timer_count() == len( offsets ) - 3 )
+
+expected = { index: start + offset for index, offset in enumerate( offsets ) if index not in ( 0, 7, 11 ) }
+expected[ 1 ] = start + level1_span + 2
+expected[ 9 ] = start + 2
+fired = run_until( start + max( offsets ) + 1 )
+check( fired == expected )
+
+print("-- Deadline rounding --")
+reset( start )
+
+# Ticks are ignored, the deadline fires on its ms
+set_timer( 0, start + 5, 999999 )
+
+# Deadlines already due fire on the next ms
+set_timer( 1, start )
+set_timer( 2, start - 10 )
+fired = run_until( start + 10 )
+check( fired == { 0: start + 5, 1: start + 1, 2: start + 1 } )
+
+print("-- ms rollover --")
+start = 0xFFFFFFFF - level1_span - 10
+reset( start )
+for index, offset in enumerate( offsets ):
+	set_timer( index, start + offset )
+fired = run_until( start + max( offsets ) + 1 )
+check( fired == { index: ( start + offset ) & 0xFFFFFFFF for index, offset in enumerate( offsets ) } )
+
+print("-- Pool full --")
+reset( start )
+for index in range( timers ):
+	set_timer( index, start + 10 )
+
+# No free entry, not armed
+set_timer( timers, start + 5 )
+check( kiibohd.Timer_armed( timers ) == 0 )
+check( kiibohd.Timer_count() == timers )
+
+# Re-arming keeps the entry, and a cancelled entry is reused
+set_timer( 3, start + 2 )
+kiibohd.Timer_cancel( 0 )
+set_timer( timers, start + 5 )
+check( kiibohd.Timer_armed( timers ) == 1 )
+fired = run_until( start + 11 )
+check( fired == dict( [ ( 3, start + 2 ), ( timers, start + 5 ) ] + [ ( index, start + 10 ) for index in range( 1, timers ) if index != 3 ] ) )
+
+print("-- Random operations against a reference model --")
+random.seed( 6 )
+start = 20000
+reset( start )
+now = start
+armed = {}
+mismatches = 0
+for operation in range( random_steps ):
+	index = random.randrange( timers )
+	choice = random.random()
+
+	# Arm or re-arm, mostly short deadlines with some past the level 1 span
+	if choice < 0.5:
+		offset = random.choice( [ random.randrange( 0, slots * 2 ), random.randrange( 0, level1_span * 2 ) ] )
+		set_timer( index, now + offset )
+		armed[ index ] = now + max( offset, 1 )
+
+	# Cancel
+	elif choice < 0.65:
+		kiibohd.Timer_cancel( index )
+		armed.pop( index, None )
+
+	# Advance the clock, sometimes by more than a wheel revolution
+	else:
+		ms = random.choice( [ 1, random.randrange( 1, slots * 2 ), random.randrange( 1, level1_span * 2 ) ] )
+		fired = step( ms )
+		now += ms
+		expected = [ index for index, deadline in armed.items() if deadline <= now ]
+		deadlines = [ armed[ index ] for index in fired if index in armed ]
+		if sorted( fired ) != sorted( expected ) or deadlines != sorted( deadlines ):
+			mismatches += 1
+		for index in expected:
+			del armed[ index ]
+
+	if kiibohd.Timer_count() != len( armed ):
+		mismatches += 1
+
+check( mismatches == 0 )
+
+# Leave nothing armed or pending
+reset( start )
+check( kiibohd.Timer_count() == 0 )
+check( len( data.pending_trigger_list() ) == 0 )
+
+result()
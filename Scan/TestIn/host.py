@@ -49,11 +49,7 @@ class TriggerMacro( Structure ):
 	C-Struct for TriggerMacro
 	See Macro/PartialMap/kll.h
 	'''
-	# TODO result is var_uint_t (dynamically sized)
-	_fields_ = [
-		( "guide",  POINTER( c_uint8 ) ),
-		( "result", c_uint8 ),
-	]
+	# Fields are set once libkiibohd is loaded, result is an index_uint_t (see library_setup)
 
 
 class AnimationStackElement( Structure ):
@@ -87,6 +83,20 @@ class PixelBuf( Structure ):
 
 
 
+### Functions ###
+
+def library_setup():
+	'''
+	Completes the structures sized by the libkiibohd build
+	Called by Control once libkiibohd is loaded
+	'''
+	TriggerMacro._fields_ = [
+		( "guide",  POINTER( c_uint8 ) ),
+		( "result", control.index_uint ),
+	]
+
+
+
 ### Classes ###
 
 class Commands:
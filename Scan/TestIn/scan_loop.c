@@ -55,7 +55,7 @@ CLIDict_Def( scanCLIDict, "Scan Module Commands" ) = {
 };
 
 // Number of scans since the last USB send
-uint16_t Scan_scanCount = 0;
+Instance uint16_t Scan_scanCount = 0;
 
 // TODO Better name, dynamically size
 typedef struct LED_Buffer {
@@ -63,6 +63,8 @@ typedef struct LED_Buffer {
 	uint16_t reg_addr;
 	uint16_t buffer[144];
 } LED_Buffer;
+
+// Referenced by the kll generated Pixel_Buffers, so it cannot be per instance (see Pixel_setupBuffers)
 volatile LED_Buffer LED_pageBuffer[4];
 
 
@@ -44,4 +44,16 @@ configure_file ( Scan/TestIn/Tests/common.py     Tests/common.py     COPYONLY )
 configure_file ( Scan/TestIn/Tests/test.py       Tests/test.py       COPYONLY )
 configure_file ( Scan/TestIn/Tests/animation.py  Tests/animation.py  COPYONLY )
 configure_file ( Scan/TestIn/Tests/animation2.py Tests/animation2.py COPYONLY )
+configure_file ( Scan/TestIn/Tests/report_bench.py Tests/report_bench.py COPYONLY )
+configure_file ( Scan/TestIn/Tests/layer_resolve.py Tests/layer_resolve.py COPYONLY )
+configure_file ( Scan/TestIn/Tests/tap_hold.py Tests/tap_hold.py COPYONLY )
+configure_file ( Scan/TestIn/Tests/chord.py Tests/chord.py COPYONLY )
+configure_file ( Scan/TestIn/Tests/report_diff.py Tests/report_diff.py COPYONLY )
+configure_file ( Scan/TestIn/Tests/report_queue.py Tests/report_queue.py COPYONLY )
+configure_file ( Scan/TestIn/Tests/report_ring.py Tests/report_ring.py COPYONLY )
+configure_file ( Scan/TestIn/Tests/inject_events.py Tests/inject_events.py COPYONLY )
+configure_file ( Scan/TestIn/Tests/clock.py Tests/clock.py COPYONLY )
+configure_file ( Scan/TestIn/Tests/timer_wheel.py Tests/timer_wheel.py COPYONLY )
+configure_file ( Scan/TestIn/Tests/long_trigger.py Tests/long_trigger.py COPYONLY )
+configure_file ( Scan/TestIn/Tests/result_ops.py Tests/result_ops.py COPYONLY )
 
@@ -0,0 +1,234 @@
+#!/usr/bin/env python3
+'''
+Diode-less matrix test case for Host-side KLL
+Compares the ghost cancelation against the previous full matrix recount (MatrixARM) on random switch presses
+'''
+
+# Copyright (C) 2017 by Jacob Alexander
+#
+# This file is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This file is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+### Imports ###
+
+import random
+
+from ctypes import (c_uint8, c_uint16)
+
+import interface as i
+
+from common import (ERROR, WARNING, check, result, press, release)
+
+
+
+### Variables ###
+
+# See matrix.h, ScanCode = cols * row + col + 1
+cols = 6
+rows = 4
+
+# Clock sources, see Lib/host.h HostClock
+virtual = 1
+
+ms = 1000000 # ns
+us = 1000    # ns
+
+# Time between strobes
+strobe_step = 50 * us
+
+# Matrix passes until a change of position is debounced, see MatrixARMPeriodic MinDebounceTime
+settle_passes = 60
+
+# Random switch changes, and the most switches pressed at once
+random_changes = 300
+max_pressed = 4
+
+
+
+### Functions ###
+
+kiibohd = i.control.kiibohd
+
+max_scan_code = c_uint16.in_dll( kiibohd, 'Macro_MaxScanCode_Host' ).value
+held_bits = ( c_uint8 * ( ( max_scan_code + 8 ) // 8 ) ).in_dll( kiibohd, 'macroTriggerHeldBits' )
+
+def scan_code( col, row ):
+	return cols * row + col + 1
+
+def held():
+	'''
+	ScanCodes held by the macro module
+	'''
+	return frozenset(
+		code for code in range( 1, max_scan_code + 1 )
+		if held_bits[ code >> 3 ] & ( 1 << ( code & 0x7 ) )
+	)
+
+def connected( pressed ):
+	'''
+	ScanCodes read as pressed by the matrix, without diodes
+	A sense line reads the driven strobe through any path of pressed switches
+	'''
+	# Strobes are nodes 0 .. cols - 1, sense lines follow
+	group = list( range( cols + rows ) )
+	def find( node ):
+		while group[ node ] != node:
+			node = group[ node ]
+		return node
+
+	for code in pressed:
+		col = ( code - 1 ) % cols
+		row = ( code - 1 ) // cols
+		group[ find( col ) ] = find( cols + row )
+
+	return frozenset(
+		scan_code( col, row )
+		for col in range( cols ) for row in range( rows )
+		if find( col ) == find( cols + row )
+	)
+
+def matrix_pass():
+	'''
+	Scans every strobe, then runs the Macro and Output stages
+	Returns the ScanCodes held afterwards
+	'''
+	i.control.step( cols )
+	return held()
+
+def collapse( sequence ):
+	'''
+	Removes repeats, only the changes of a sequence are compared
+	'''
+	changes = []
+	for item in sequence:
+		if not changes or changes[-1] != item:
+			changes.append( item )
+	return changes
+
+
+class Reference:
+	'''
+	Previous ghost cancelation (MatrixARM), the whole matrix is recounted each scan
+	The previous code saved the raw key state, so a Release read as pressed for one more scan
+	Here keys are only on while Press or Hold, as in MatrixARMPeriodic
+	'''
+	def __init__( self ):
+		self.col_ghost = [ 0 ] * cols
+		self.row_ghost = [ 0 ] * rows
+		self.saved = {}
+
+	def scan( self, on ):
+		'''
+		Returns the ScanCodes sent as held, given the debounced ScanCodes
+		'''
+		col_use = [ sum( scan_code( col, row ) in on for row in range( rows ) ) for col in range( cols ) ]
+		row_use = [ sum( scan_code( col, row ) in on for col in range( cols ) ) for row in range( rows ) ]
+
+		col_ghost_old = self.col_ghost
+		row_ghost_old = self.row_ghost
+		self.col_ghost = [ 0 ] * cols
+		self.row_ghost = [ 0 ] * rows
+		for col in range( cols ):
+			for row in range( rows ):
+				if scan_code( col, row ) in on and col_use[ col ] >= 2 and row_use[ row ] >= 2:
+					self.col_ghost[ col ] = 1
+					self.row_ghost[ row ] = 1
+
+		sent = set()
+		for col in range( cols ):
+			for row in range( rows ):
+				code = scan_code( col, row )
+				ghost = self.col_ghost[ col ] or self.row_ghost[ row ] or col_ghost_old[ col ] or row_ghost_old[ row ]
+				if not ghost:
+					self.saved[ code ] = code in on
+				if self.saved.get( code, False ) if ghost else code in on:
+					sent.add( code )
+		return frozenset( sent )
+
+
+
+### Test ###
+
+# Reference to callback datastructure
+data = i.control.data
+
+# NKRO Mode, one strobe per processing stage
+c_uint8.in_dll( kiibohd, 'USBKeys_Protocol' ).value = 1
+i.control.set_clock( virtual, strobe_step )
+for settle in range( settle_passes ):
+	matrix_pass()
+
+print("-- Phantom key --")
+# A + B + G, the phantom key H reads pressed
+a = scan_code( 0, 0 )
+b = scan_code( 1, 0 )
+g = scan_code( 0, 1 )
+h = scan_code( 1, 1 )
+check( connected( { a, b, g } ) == { a, b, g, h } )
+
+press( a )
+press( b )
+sent = set()
+for settle in range( settle_passes ):
+	sent |= matrix_pass()
+check( held() == { a, b } )
+
+# G and H are held back while the ghost lasts
+press( g )
+for settle in range( settle_passes ):
+	sent |= matrix_pass()
+check( h not in sent and held() == { a, b } )
+
+# G is sent once the ghost is gone
+release( b )
+for settle in range( settle_passes ):
+	sent |= matrix_pass()
+check( h not in sent and held() == { a, g } )
+
+release( a )
+release( g )
+for settle in range( settle_passes ):
+	matrix_pass()
+check( held() == set() )
+
+print("-- Random presses, against the previous ghost cancelation --")
+random.seed( 25 )
+reference = Reference()
+pressed = set()
+ghosts = 0
+sent = [ held() ]
+expected = [ reference.scan( frozenset() ) ]
+for change in range( random_changes ):
+	# Press or release a random switch, keeping a few pressed
+	code = random.randrange( 1, cols * rows + 1 )
+	if code in pressed:
+		release( code )
+		pressed.remove( code )
+	elif len( pressed ) < max_pressed:
+		press( code )
+		pressed.add( code )
+
+	# Every ScanCode changing on the sense lines is debounced during the same pass
+	on = connected( pressed )
+	if on != pressed:
+		ghosts += 1
+	for settle in range( settle_passes ):
+		sent.append( matrix_pass() )
+		expected.append( reference.scan( on ) )
+
+check( collapse( sent ) == collapse( expected ) )
+
+# Phantom keys were read during the stream
+check( ghosts > 0 )
+
+result()
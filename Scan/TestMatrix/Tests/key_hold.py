@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+'''
+Held key test case for Host-side KLL
+Checks a key stays held between its Press and Release, and that a lost Release does not leave it held forever
+'''
+
+# Copyright (C) 2017 by Jacob Alexander
+#
+# This file is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This file is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+### Imports ###
+
+from ctypes import (c_uint8, c_uint16)
+
+import interface as i
+
+from common import (ERROR, WARNING, check, result, press, release, codes)
+
+
+
+### Variables ###
+
+# See scancode_map.kll
+#  S0x01 : U"A";
+#  S0x02 : U"B";
+scan_code = 0x01
+other_scan_code = 0x02
+
+code = 0x04 # A
+other_code = 0x05 # B
+
+# Clock sources, see Lib/host.h HostClock
+virtual = 1
+
+ms = 1000000 # ns
+us = 1000    # ns
+
+# Time between strobes
+strobe_step = 50 * us
+
+# Debounced, see MatrixARMPeriodic MinDebounceTime
+settle = 20 * ms
+
+# Release state, see ScheduleType_R
+state_release = 0x03
+
+
+
+### Functions ###
+
+kiibohd = i.control.kiibohd
+
+max_scan_code = c_uint16.in_dll( kiibohd, 'Macro_MaxScanCode_Host' ).value
+event_size = c_uint8.in_dll( kiibohd, 'macroTriggerEventBufferSize' )
+events = ( i.lib.TriggerEvent * max_scan_code ).in_dll( kiibohd, 'macroTriggerEventBuffer' )
+held_size = c_uint8.in_dll( kiibohd, 'macroTriggerHeldSize' )
+
+def held_for( duration, step=100 * ms ):
+	'''
+	Advances the clock, checking the key is reported the whole time
+	'''
+	held = True
+	for elapsed in range( 0, duration, step ):
+		i.control.advance_time( step )
+		held = held and code in codes() and held_size.value == 1
+		held = held and len( data.pending_trigger_list() ) <= 1
+	return held
+
+def drop_release():
+	'''
+	Runs the matrix until the Release is sent to the macro module, then discards it
+	Returns False if no Release was sent
+	'''
+	# One stage at a time, the Release must be discarded before the Macro stage
+	for stage in range( settle // strobe_step ):
+		kiibohd.Host_process()
+		for event in events[ : event_size.value ]:
+			if event.index == scan_code and event.state == state_release:
+				event_size.value = 0
+				return True
+	return False
+
+
+
+### Test ###
+
+# Reference to callback datastructure
+data = i.control.data
+
+# NKRO Mode, one strobe per processing loop step
+c_uint8.in_dll( kiibohd, 'USBKeys_Protocol' ).value = 1
+i.control.set_clock( virtual, strobe_step )
+i.control.advance_time( 10 * ms )
+
+print("-- Press, long hold, release --")
+press( scan_code )
+i.control.advance_time( settle )
+check( code in codes() and held_size.value == 1 )
+
+check( held_for( 2000 * ms ) )
+
+release( scan_code )
+i.control.advance_time( settle )
+check( code not in codes() and held_size.value == 0 )
+check( len( data.pending_trigger_list() ) == 0 )
+
+print("-- Other key pressed and released during a long hold --")
+press( scan_code )
+i.control.advance_time( settle )
+press( other_scan_code )
+i.control.advance_time( settle )
+check( code in codes() and other_code in codes() )
+
+release( other_scan_code )
+i.control.advance_time( settle )
+check( code in codes() and other_code not in codes() and held_size.value == 1 )
+
+check( held_for( 500 * ms ) )
+
+release( scan_code )
+i.control.advance_time( settle )
+check( code not in codes() and held_size.value == 0 )
+
+print("-- Dropped release --")
+press( scan_code )
+i.control.advance_time( settle )
+check( code in codes() )
+
+release( scan_code )
+check( drop_release() )
+i.control.advance_time( settle )
+
+# Without its Release the key is still held
+check( code in codes() and held_size.value == 1 )
+
+# Releases every held key
+kiibohd.Macro_clearPending()
+i.control.advance_time( settle )
+check( code not in codes() and held_size.value == 0 )
+check( len( data.pending_trigger_list() ) == 0 )
+
+# The key works normally afterwards
+press( scan_code )
+i.control.advance_time( settle )
+check( code in codes() and held_size.value == 1 )
+release( scan_code )
+i.control.advance_time( settle )
+check( code not in codes() and held_size.value == 0 )
+
+result()
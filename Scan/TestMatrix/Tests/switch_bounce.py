@@ -0,0 +1,180 @@
+#!/usr/bin/env python3
+'''
+Simulated matrix test case for Host-side KLL
+Runs the matrix scan module against bouncing, chattering and stuck switches
+'''
+
+# Copyright (C) 2017 by Jacob Alexander
+#
+# This file is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This file is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+### Imports ###
+
+from ctypes import c_uint8
+
+import interface as i
+
+from common import (ERROR, WARNING, check, result)
+
+
+
+### Variables ###
+
+# See scancode_map.kll
+#  S0x01 : U"A"; ... S0x18 : U"X";
+scan_codes = range( 0x01, 0x19 )
+
+def usb_code( scan_code ):
+	return 0x04 + scan_code - 0x01
+
+# Clock sources, see Lib/host.h HostClock
+virtual = 1
+
+ms = 1000000 # ns
+us = 1000    # ns
+
+# Time between strobes
+strobe_step = 50 * us
+
+# Switch failures, see switch_model.h SwitchStuck
+stuck_none = 0
+stuck_open = 1
+stuck_closed = 2
+
+
+
+### Functions ###
+
+def codes():
+	'''
+	USB codes in the last keyboard report
+	'''
+	if data.usb_keyboard_data is None:
+		return []
+	return data.usb_keyboard_data.codes()
+
+def tap( scan_code, hold=20 * ms, wait=20 * ms ):
+	'''
+	Presses and releases a switch
+	Returns whether the key was reported while held, and not reported after release
+	'''
+	i.control.cmd('addScanCode')( scan_code )
+	i.control.advance_time( hold )
+	pressed = usb_code( scan_code ) in codes()
+
+	i.control.cmd('removeScanCode')( scan_code )
+	i.control.advance_time( wait )
+	released = usb_code( scan_code ) not in codes()
+
+	return pressed and released
+
+def percentile( latencies, fraction ):
+	return latencies[ min( len( latencies ) - 1, int( len( latencies ) * fraction ) ) ]
+
+def latency_summary( name, latencies ):
+	'''
+	Prints a latency distribution (us)
+	'''
+	if len( latencies ) == 0:
+		print( "{0}: no events".format( name ) )
+		return
+	print( "{0}: {1} events, min {2} us, p50 {3} us, p99 {4} us, max {5} us".format(
+		name,
+		len( latencies ),
+		latencies[0],
+		percentile( latencies, 0.50 ),
+		percentile( latencies, 0.99 ),
+		latencies[-1],
+	) )
+
+
+
+### Test ###
+
+# Reference to callback datastructure
+data = i.control.data
+
+# NKRO Mode, one strobe per processing loop step
+c_uint8.in_dll( i.control.kiibohd, 'USBKeys_Protocol' ).value = 1
+i.control.set_clock( virtual, strobe_step )
+i.control.cmd('switchSeed')( 1 )
+i.control.advance_time( 10 * ms )
+
+print("-- Ideal switches --")
+i.control.cmd('switchStatsReset')()
+for scan_code in scan_codes:
+	check( tap( scan_code ) )
+
+stats = i.control.cmd('switchStats')()
+check( len( stats.latencies( stats.press ) ) == len( scan_codes ) )
+check( len( stats.latencies( stats.release ) ) == len( scan_codes ) )
+check( stats.spurious == 0 and stats.dropped == 0 )
+latency_summary( "Press", stats.latencies( stats.press ) )
+latency_summary( "Release", stats.latencies( stats.release ) )
+
+print("-- Contact bounce, shorter than MinDebounceTime --")
+i.control.cmd('switchConfig')( 0, bounce_us=3000 )
+i.control.cmd('switchStatsReset')()
+taps = 0
+for loop in range( 4 ):
+	for scan_code in scan_codes:
+		check( tap( scan_code ) )
+		taps += 1
+
+stats = i.control.cmd('switchStats')()
+check( len( stats.latencies( stats.press ) ) == taps )
+check( len( stats.latencies( stats.release ) ) == taps )
+check( stats.spurious == 0 and stats.dropped == 0 )
+latency_summary( "Press", stats.latencies( stats.press ) )
+latency_summary( "Release", stats.latencies( stats.release ) )
+
+print("-- Chatter while held --")
+i.control.cmd('switchConfig')( 0, chatter=1000 )
+i.control.cmd('switchStatsReset')()
+held = 0x05
+i.control.cmd('addScanCode')( held )
+for loop in range( 50 ):
+	i.control.advance_time( 10 * ms )
+	check( usb_code( held ) in codes() )
+i.control.cmd('removeScanCode')( held )
+i.control.advance_time( 20 * ms )
+check( usb_code( held ) not in codes() )
+
+stats = i.control.cmd('switchStats')()
+check( stats.spurious == 0 )
+
+print("-- Stuck switches --")
+i.control.cmd('switchConfig')( 0 )
+i.control.cmd('switchConfig')( 0x02, stuck=stuck_closed )
+i.control.cmd('switchConfig')( 0x03, stuck=stuck_open )
+i.control.cmd('switchStatsReset')()
+i.control.advance_time( 20 * ms )
+check( usb_code( 0x02 ) in codes() )
+
+# Never reported, the press is undone by the release
+check( not tap( 0x03 ) )
+check( usb_code( 0x03 ) not in codes() )
+
+stats = i.control.cmd('switchStats')()
+check( stats.dropped == 1 )
+
+# Reported as soon as the switch is fixed
+i.control.cmd('switchConfig')( 0x02 )
+i.control.advance_time( 20 * ms )
+check( usb_code( 0x02 ) not in codes() )
+
+check( len( data.pending_trigger_list() ) == 0 )
+
+result()
+
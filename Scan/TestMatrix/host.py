@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+'''
+Host-Side Python Commands for TestMatrix Scan Module
+'''
+
+# Copyright (C) 2017 by Jacob Alexander
+#
+# This file is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This file is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+### Imports ###
+
+import sys
+
+from ctypes import (Structure, c_uint32)
+
+
+
+### Decorators ###
+
+## Print Decorator Variables
+ERROR = '\033[5;1;31mERROR\033[0m:'
+WARNING = '\033[5;1;33mWARNING\033[0m:'
+
+
+
+### Variables ###
+
+data = None
+debug = False
+control = None
+
+# See switch_model.h
+SwitchStats_Buckets = 128
+SwitchStats_Bucket_us = 100
+
+
+
+### Structures ###
+
+class SwitchStats( Structure ):
+	'''
+	C-Struct for SwitchStats
+	See Scan/TestMatrix/switch_model.h
+	'''
+	_fields_ = [
+		( "press",    c_uint32 * SwitchStats_Buckets ),
+		( "release",  c_uint32 * SwitchStats_Buckets ),
+		( "spurious", c_uint32 ),
+		( "dropped",  c_uint32 ),
+	]
+
+	def latencies( self, histogram ):
+		'''
+		Expands a latency histogram into a sorted list of latencies (us, bucket start)
+		The last bucket also counts anything longer
+		'''
+		return [
+			bucket * SwitchStats_Bucket_us
+			for bucket, count in enumerate( histogram )
+			for event in range( count )
+		]
+
+
+
+### Classes ###
+
+class Commands:
+	'''
+	Container class of commands available to controll the host-side KLL implementation
+	'''
+
+	def addScanCode( self, scan_code ):
+		'''
+		Presses the simulated switch of a Scan Code
+		The matrix scan decides when the press is sent to the macro module
+
+		Returns 1
+		'''
+		return control.kiibohd.Scan_addScanCode( int( scan_code ) )
+
+	def removeScanCode( self, scan_code ):
+		'''
+		Releases the simulated switch of a Scan Code
+
+		Returns 1
+		'''
+		return control.kiibohd.Scan_removeScanCode( int( scan_code ) )
+
+	def switchConfig( self, scan_code=0, bounce_us=0, chatter=0, stuck=0 ):
+		'''
+		Configures the simulated switch of a Scan Code, or every switch if scan_code is 0
+
+		@param bounce_us: Contact bounces randomly for this long after each change of position
+		@param chatter:   Chance (out of 65536) of a closed contact reading open on each read
+		@param stuck:     0 - Follows the switch position, 1 - Stuck open, 2 - Stuck closed
+		'''
+		control.kiibohd.Switch_config( int( scan_code ), int( bounce_us ), int( chatter ), int( stuck ) )
+
+	def switchSeed( self, seed ):
+		'''
+		Seeds the pseudo-random bounce and chatter, for repeatable runs
+		'''
+		control.kiibohd.Switch_seed( c_uint32( seed ) )
+
+	def switchStats( self ):
+		'''
+		Matrix event statistics since the last switchStatsReset
+		See SwitchStats
+		'''
+		return SwitchStats.from_buffer_copy( SwitchStats.in_dll( control.kiibohd, "Switch_stats" ) )
+
+	def switchStatsReset( self ):
+		'''
+		Clears the matrix event statistics
+		'''
+		control.kiibohd.Switch_statsReset()
+
+
+class Callbacks:
+	'''
+	Container class of commands required byt the host-side KLL implementation
+	'''
+
+
+
+### Main Entry Point ###
+
+if __name__ == '__main__':
+	print( "{0} Do not call directly.".format( ERROR ) )
+	sys.exit( 1 )
+
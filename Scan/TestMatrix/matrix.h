@@ -0,0 +1,58 @@
+/* Copyright (C) 2017 by Jacob Alexander
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+// ----- Includes -----
+
+// Project Includes
+#include <matrix_setup.h>
+
+
+
+// ----- Matrix Definition -----
+
+// Simulated matrix, see switch_model.c
+//
+// Column (Strobe) - 6 Total
+//  PTB0..3
+//  PTC4,5
+//
+// Rows (Sense) - 4 Total
+//  PTD0,1,4
+//  PTC2
+//
+// Sense lines are spread over two ports, with two different pin offsets on PTD
+//
+// Every switch has a diode, unless GhostingMatrix is set (see ghosting_matrix.kll)
+
+// Define Rows (Sense) and Columns (Strobes)
+GPIO_Pin Matrix_cols[] = { gpio(B,0), gpio(B,1), gpio(B,2), gpio(B,3), gpio(C,4), gpio(C,5) };
+GPIO_Pin Matrix_rows[] = { gpio(D,0), gpio(D,1), gpio(D,4), gpio(C,2) };
+
+// Define type of scan matrix
+// Diode-less matrices drive the strobes low, and pull up the sense lines
+#if GhostingMatrix_define == 1
+Config Matrix_type = Config_Pullup;
+#else
+Config Matrix_type = Config_Pulldown;
+#endif
+
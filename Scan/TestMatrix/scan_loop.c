@@ -0,0 +1,137 @@
+/* Copyright (C) 2017 by Jacob Alexander
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <Lib/ScanLib.h>
+
+// Project Includes
+#include <kll.h>
+#include <macro.h>
+#include <matrix_scan.h>
+
+// Local Includes
+#include "scan_loop.h"
+#include "switch_model.h"
+
+
+
+// ----- Variables -----
+
+// See Macro/PartialMap/macro.c
+extern Instance TriggerEvent macroTriggerEventBuffer[];
+extern Instance var_uint_t   macroTriggerEventBufferSize;
+
+
+
+// ----- Functions -----
+
+// Setup
+inline void Scan_setup()
+{
+	// Setup simulated switches, before the matrix pins are read
+	Switch_setup();
+
+	// Setup GPIO pins for matrix scanning
+	Matrix_setup();
+
+	// Start Matrix Scanner
+	Matrix_start();
+}
+
+
+// Main Poll Loop
+// This is for operations that need to be run as often as possible
+// Usually reserved for LED update routines and other things that need quick update rates
+void Scan_poll()
+{
+}
+
+
+// Main Periodic Scan
+// This function is called periodically at a constant rate
+// Useful for matrix scanning and anything that requires consistent attention
+uint8_t Scan_periodic()
+{
+	var_uint_t first = macroTriggerEventBufferSize;
+
+	// Scan Matrix
+	uint8_t ready = Matrix_single_scan();
+
+	// Match the Press/Release events of this strobe to the simulated switches
+	for ( var_uint_t item = first; item < macroTriggerEventBufferSize; item++ )
+	{
+		TriggerEvent *event = &macroTriggerEventBuffer[ item ];
+		switch ( event->state )
+		{
+		case ScheduleType_P:
+		case ScheduleType_R:
+			Switch_event( ( event->type - TriggerType_Switch1 ) * 256 + event->index, event->state );
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	return ready;
+}
+
+
+// Signal from Macro Module that all keys have been processed (that it knows about)
+inline void Scan_finishedWithMacro( uint8_t sentKeys )
+{
+}
+
+
+// Signal from Output Module that all keys have been processed (that it knows about)
+inline void Scan_finishedWithOutput( uint8_t sentKeys )
+{
+}
+
+
+// Presses a simulated switch
+// Returns 1
+int Scan_addScanCode( uint8_t scanCode )
+{
+	Switch_position( scanCode, 1 );
+	return 1;
+}
+
+
+// Releases a simulated switch
+// Returns 1
+int Scan_removeScanCode( uint8_t scanCode )
+{
+	Switch_position( scanCode, 0 );
+	return 1;
+}
+
+
+// Signal from the Output Module that the available current has changed
+// current - mA
+void Scan_currentChange( unsigned int current )
+{
+	// Indicate to all submodules current change
+	Matrix_currentChange( current );
+}
+
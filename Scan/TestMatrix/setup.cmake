@@ -0,0 +1,54 @@
+###| CMake Kiibohd Controller Scan Module |###
+#
+# Written by Jacob Alexander in 2017 for the Kiibohd Controller
+#
+# Released into the Public Domain
+#
+###
+
+
+###
+# Path to this module
+#
+set ( MatrixARM_Path ${CMAKE_CURRENT_LIST_DIR} )
+
+
+###
+# Required Sub-modules
+#
+AddModule ( Scan Devices/MatrixARMPeriodic )
+
+
+###
+# Module C files
+#
+set ( Module_SRCS
+	scan_loop.c
+	switch_model.c
+)
+
+
+###
+# Compiler Family Compatibility
+#
+set ( ModuleCompatibility
+	host
+)
+
+
+###
+# Configure host side Python scripts
+#
+configure_file ( Scan/TestIn/interface.py Tests/interface.py NEWLINE_STYLE UNIX )
+configure_file ( Scan/TestIn/gdb          Tests/gdb          COPYONLY )
+
+
+###
+# Test cases
+#
+configure_file ( Scan/TestIn/Tests/common.py Tests/common.py COPYONLY )
+
+configure_file ( Scan/TestMatrix/Tests/switch_bounce.py Tests/switch_bounce.py COPYONLY )
+configure_file ( Scan/TestMatrix/Tests/key_hold.py Tests/key_hold.py COPYONLY )
+configure_file ( Scan/TestMatrix/Tests/ghosting.py Tests/ghosting.py COPYONLY )
+
@@ -0,0 +1,297 @@
+/* Copyright (C) 2017 by Jacob Alexander
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <Lib/ScanLib.h>
+
+// Project Includes
+#include <kll.h>
+#include <matrix_scan.h>
+
+// Local Includes
+#include "switch_model.h"
+
+
+
+// ----- Variables -----
+
+// See matrix.h
+extern GPIO_Pin Matrix_cols[];
+extern GPIO_Pin Matrix_rows[];
+
+// Simulated switches, indexed by ScanCode - 1
+Instance SwitchModel Switch_keys[ MaxScanCode_KLL ];
+
+// Matrix event statistics
+Instance SwitchStats Switch_stats;
+
+// Pseudo-random state for bounce and chatter (xorshift32)
+static Instance uint32_t Switch_random;
+
+
+
+// ----- Functions -----
+
+// Current time (us)
+static uint32_t Switch_now()
+{
+	return Host_clockNow_ns() / 1000;
+}
+
+static uint32_t Switch_rand()
+{
+	Switch_random ^= Switch_random << 13;
+	Switch_random ^= Switch_random >> 17;
+	Switch_random ^= Switch_random << 5;
+	return Switch_random;
+}
+
+// Contact state of a switch, for a single read
+static uint8_t Switch_contact( SwitchModel *key, uint32_t now )
+{
+	switch ( key->stuck )
+	{
+	case SwitchStuck_Open:
+		return 0;
+
+	case SwitchStuck_Closed:
+		return 1;
+	}
+
+	// Contact bounce, after any change of position
+	if ( now - key->change_us < key->bounce_us )
+	{
+		return Switch_rand() & 1;
+	}
+
+	// Chatter, closed contact momentarily reading open
+	if ( key->position && key->chatter && ( Switch_rand() & 0xFFFF ) < key->chatter )
+	{
+		return 0;
+	}
+
+	return key->position;
+}
+
+#if GhostingMatrix_define == 1
+// Host GPIO model (see Lib/host.c), closed switches connect a driven strobe to its sense line
+// Strobes are active low (Config_Pullup), no switch has a diode
+// A sense line also reads low when connected to a driven strobe through other closed switches (ghosting)
+static uint32_t Switch_gpioModel( uint8_t port )
+{
+	uint32_t input = Host_gpioIdle( port );
+	uint32_t now = Switch_now();
+	uint8_t cols = Matrix_totalColumns();
+	uint8_t rows = Matrix_totalRows();
+
+	// Read each switch once
+	uint8_t contact[ MaxScanCode_KLL ];
+	for ( uint16_t key = 0; key < MaxScanCode_KLL; key++ )
+	{
+		contact[ key ] = Switch_contact( &Switch_keys[ key ], now );
+	}
+
+	// Strobes being driven low
+	uint32_t strobes = 0;
+	uint32_t senses = 0;
+	for ( uint8_t strobe = 0; strobe < cols; strobe++ )
+	{
+		HostGPIO *gpio = &Host_gpio[ Matrix_cols[ strobe ].port ];
+		if ( gpio->PDDR & ~gpio->PDOR & ( (uint32_t)1 << Matrix_cols[ strobe ].pin ) )
+		{
+			strobes |= (uint32_t)1 << strobe;
+		}
+	}
+
+	// Strobes and sense lines connected to them, following closed switches until nothing is added
+	uint8_t added = strobes != 0;
+	while ( added )
+	{
+		added = 0;
+		for ( uint16_t key = 0; key < MaxScanCode_KLL; key++ )
+		{
+			uint32_t strobe = (uint32_t)1 << ( key % cols );
+			uint32_t sense = (uint32_t)1 << ( key / cols );
+			if ( !contact[ key ] || !( strobes & strobe ) == !( senses & sense ) )
+			{
+				continue;
+			}
+
+			strobes |= strobe;
+			senses |= sense;
+			added = 1;
+		}
+	}
+
+	for ( uint8_t sense = 0; sense < rows; sense++ )
+	{
+		if ( Matrix_rows[ sense ].port == port && senses & ( (uint32_t)1 << sense ) )
+		{
+			input &= ~( (uint32_t)1 << Matrix_rows[ sense ].pin );
+		}
+	}
+
+	return input;
+}
+#else
+// Host GPIO model (see Lib/host.c), closed switches connect a driven strobe to its sense line
+// Strobes are active high (Config_Pulldown), every switch has a diode (no ghosting)
+static uint32_t Switch_gpioModel( uint8_t port )
+{
+	uint32_t input = Host_gpioIdle( port );
+	uint32_t now = Switch_now();
+	uint8_t cols = Matrix_totalColumns();
+	uint8_t rows = Matrix_totalRows();
+
+	for ( uint8_t strobe = 0; strobe < cols; strobe++ )
+	{
+		// Only strobes being driven
+		HostGPIO *gpio = &Host_gpio[ Matrix_cols[ strobe ].port ];
+		if ( !( gpio->PDOR & gpio->PDDR & ( (uint32_t)1 << Matrix_cols[ strobe ].pin ) ) )
+		{
+			continue;
+		}
+
+		for ( uint8_t sense = 0; sense < rows; sense++ )
+		{
+			uint16_t key = cols * sense + strobe;
+			if ( Matrix_rows[ sense ].port != port || key >= MaxScanCode_KLL )
+			{
+				continue;
+			}
+
+			if ( Switch_contact( &Switch_keys[ key ], now ) )
+			{
+				input |= (uint32_t)1 << Matrix_rows[ sense ].pin;
+			}
+		}
+	}
+
+	return input;
+}
+#endif
+
+
+// Setup switch simulation, every switch released and ideal
+void Switch_setup()
+{
+	for ( uint16_t key = 0; key < MaxScanCode_KLL; key++ )
+	{
+		Switch_keys[ key ] = (SwitchModel){ 0 };
+	}
+	Switch_statsReset();
+	Switch_seed( 0 );
+
+	// Matrix reads go through the switches
+	Host_gpioModel = Switch_gpioModel;
+}
+
+// Seed the pseudo-random bounce and chatter, for repeatable runs
+void Switch_seed( uint32_t seed )
+{
+	Switch_random = seed ? seed : 1;
+}
+
+// Configure a switch, or every switch if scanCode is 0
+// bounce_us - Contact bounce after each change of position
+// chatter   - Chance (out of 65536) of a closed contact reading open on each read
+// stuck     - SwitchStuck
+void Switch_config( uint16_t scanCode, uint16_t bounce_us, uint16_t chatter, uint8_t stuck )
+{
+	for ( uint16_t key = 0; key < MaxScanCode_KLL; key++ )
+	{
+		if ( scanCode != 0 && scanCode != key + 1 )
+		{
+			continue;
+		}
+
+		Switch_keys[ key ].bounce_us = bounce_us;
+		Switch_keys[ key ].chatter   = chatter;
+		Switch_keys[ key ].stuck     = stuck;
+	}
+}
+
+// Press (1) or release (0) a switch
+void Switch_position( uint16_t scanCode, uint8_t position )
+{
+	if ( scanCode == 0 || scanCode > MaxScanCode_KLL )
+	{
+		return;
+	}
+
+	SwitchModel *key = &Switch_keys[ scanCode - 1 ];
+	if ( key->position == position )
+	{
+		return;
+	}
+
+	// Undoing a change that was never reported
+	if ( key->pending )
+	{
+		Switch_stats.dropped++;
+	}
+
+	key->pending   = !key->pending;
+	key->position  = position;
+	key->change_us = Switch_now();
+}
+
+// Press or Release event sent by the matrix, see Scan_periodic
+void Switch_event( uint16_t scanCode, uint8_t state )
+{
+	if ( scanCode == 0 || scanCode > MaxScanCode_KLL )
+	{
+		return;
+	}
+
+	// Only the first event after a change of position counts
+	SwitchModel *key = &Switch_keys[ scanCode - 1 ];
+	if ( !key->pending || key->position != ( state == ScheduleType_P ) )
+	{
+		Switch_stats.spurious++;
+		return;
+	}
+	key->pending = 0;
+
+	uint32_t bucket = ( Switch_now() - key->change_us ) / SwitchStats_Bucket_us;
+	if ( bucket >= SwitchStats_Buckets )
+	{
+		bucket = SwitchStats_Buckets - 1;
+	}
+
+	if ( key->position )
+	{
+		Switch_stats.press[ bucket ]++;
+	}
+	else
+	{
+		Switch_stats.release[ bucket ]++;
+	}
+}
+
+// Clear the matrix event statistics
+void Switch_statsReset()
+{
+	Switch_stats = (SwitchStats){ { 0 } };
+}
+
@@ -0,0 +1,94 @@
+/* Copyright (C) 2017 by Jacob Alexander
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <stdint.h>
+
+// KLL Generated Defines
+#include <kll_defs.h>
+
+// Project Includes
+#include <Lib/mcu_compat.h>
+
+
+
+// ----- Defines -----
+
+// Latency histogram, from a change of switch position to the matching matrix event
+// The last bucket also counts anything longer
+#define SwitchStats_Buckets   128
+#define SwitchStats_Bucket_us 100
+
+
+
+// ----- Enums -----
+
+// Switch failures
+typedef enum SwitchStuck {
+	SwitchStuck_None   = 0, // Follows the switch position
+	SwitchStuck_Open   = 1, // Never makes contact
+	SwitchStuck_Closed = 2, // Always makes contact
+} SwitchStuck;
+
+
+
+// ----- Structs -----
+
+// Simulated switch, one per ScanCode
+typedef struct SwitchModel {
+	uint8_t  position;  // Requested position, 1 if pressed
+	uint8_t  pending;   // Set if the change of position has not been reported by the matrix yet
+	uint8_t  stuck;     // SwitchStuck
+	uint16_t bounce_us; // Contact bounces randomly for this long after each change of position
+	uint16_t chatter;   // Chance (out of 65536) of a closed contact reading open on each read
+	uint32_t change_us; // Time of the last change of position
+} SwitchModel;
+
+// Matrix event statistics
+typedef struct SwitchStats {
+	uint32_t press[ SwitchStats_Buckets ];   // Press latency histogram
+	uint32_t release[ SwitchStats_Buckets ]; // Release latency histogram
+	uint32_t spurious; // Press/Release events without a matching change of position
+	uint32_t dropped;  // Changes of position undone before being reported
+} SwitchStats;
+
+
+
+// ----- Variables -----
+
+extern Instance SwitchModel Switch_keys[ MaxScanCode_KLL ];
+extern Instance SwitchStats Switch_stats;
+
+
+
+// ----- Functions -----
+
+void Switch_setup();
+void Switch_seed( uint32_t seed );
+void Switch_config( uint16_t scanCode, uint16_t bounce_us, uint16_t chatter, uint8_t stuck );
+void Switch_position( uint16_t scanCode, uint8_t position );
+void Switch_event( uint16_t scanCode, uint8_t state );
+void Switch_statsReset();
+
@@ -36,6 +36,10 @@
 
 #include <Lib/periodic.h>
 
+#if defined(_host_)
+#include <kll.h>
+#endif
+
 
 
 // ----- Enumerations -----
@@ -51,7 +55,7 @@ typedef enum PeriodicStage {
 // ----- Variables -----
 
 // Periodic Stage Tracker
-static volatile PeriodicStage stage_tracker;
+static Instance volatile PeriodicStage stage_tracker;
 
 
 
@@ -141,6 +145,8 @@ int main()
 
 int Host_init()
 {
+	Host_initFailed = 0;
+
 	// Enable CLI
 	CLI_init();
 
@@ -149,7 +155,8 @@ int Host_init()
 	Macro_setup();
 	Scan_setup();
 
-	return 1;
+	// Returns 0 if a module could not be set up
+	return !Host_initFailed;
 }
 
 int Host_cli_process()
@@ -193,6 +200,12 @@ int Host_process()
 	// Then a single poll loop
 	Host_poll();
 
+	// Step the virtual clock
+	if ( Host_clock == HostClock_Virtual )
+	{
+		Host_clockAdvance( Host_clockStep_ns );
+	}
+
 	return 1;
 }
 
@@ -203,22 +216,92 @@ int Host_register_callback( void* func )
 	return 1;
 }
 
+// Register a keyboard report ring (see output_com.h HostReportRing)
+// Reports are written to the ring instead of the keyboard_send callback, NULL to disable
+int Host_register_report_ring( void* ring )
+{
+	Output_Host_ReportRing = ring;
+	return 1;
+}
+
 // Change the value of systick (milliseconds)
-volatile uint32_t systick_millis_count;
+// Ignored with HostClock_Monotonic
 int Host_set_systick( uint32_t systick_ms )
 {
-	systick_millis_count = systick_ms;
+	Host_clockSet( systick_ms, Host_clockNow_ns() % Host_ticksPer_ms );
 	return 1;
 }
 
 // Change the nanosecs since last systick
-volatile uint32_t ns_since_systick_count;
+// Ignored with HostClock_Monotonic
 int Host_set_nanosecs_since_systick( uint32_t systick_ns )
 {
-	ns_since_systick_count = systick_ns;
+	Host_clockSet( systick_millis_count, systick_ns );
+	return 1;
+}
+
+// Select the clock source (see Lib/host.h HostClock)
+// step_ns - Time added after each Host_process with HostClock_Virtual
+int Host_set_clock( uint8_t clock, uint32_t step_ns )
+{
+	Host_clockSelect( clock, step_ns );
+	return 1;
+}
+
+// Advance the clock by ns
+// With HostClock_Virtual, Host_process is run for each step until ns has elapsed (fast-forward)
+// Returns 0 with HostClock_Monotonic
+int Host_advance_time( uint64_t ns )
+{
+	if ( Host_clock == HostClock_Monotonic )
+		return 0;
+
+	if ( Host_clock == HostClock_Virtual && Host_clockStep_ns > 0 )
+	{
+		for ( ; ns >= Host_clockStep_ns; ns -= Host_clockStep_ns )
+		{
+			Host_process();
+		}
+	}
+
+	// Remainder
+	Host_clockAdvance( ns );
+	return 1;
+}
+
+// Run n full processing loops (Scan, Macro and Output periodic stages)
+int Host_step( uint32_t loops )
+{
+	for ( uint32_t loop = 0; loop < loops; loop++ )
+	{
+		// Stays in the Scan stage if the scan module is not ready
+		do {
+			Host_process();
+		} while ( stage_tracker != PeriodicStage_Scan );
+	}
+
 	return 1;
 }
 
+// Add TriggerEvents directly to the macro module, bypassing the scan module and cli
+// Each event keeps its own timestamp (lower 16 bits of ms), systick is set to time (ms)
+// time is ignored with HostClock_Monotonic
+// Returns the number of events used (invalid events are skipped)
+// The rest must be injected after the next Host_step
+int Host_inject_events( const TriggerEvent* events, uint16_t count, uint32_t time )
+{
+	Host_clockSet( time, 0 );
+
+	for ( uint16_t event = 0; event < count; event++ )
+	{
+		// No room left
+		if ( Macro_eventAdd( (void*)&events[ event ] ) == 0 )
+			return event;
+	}
+
+	return count;
+}
+
 // Test function to validate library
 int Host_callback_test()
 {